@@ -16,21 +16,47 @@
 */
 
 #include "benchmark.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <sstream>
+#include <thread>
+#include <vector>
+#include "endgame.hpp"
+#include "evaluation.hpp"
+#include "nnue.hpp"
+#include "search.hpp"
+#include "search_listener.hpp"
+#include "search_parameters.hpp"
+#include "tt.hpp"
 #include "utils/stopwatch.hpp"
+#include "utils/threadpool.hpp"
 
-std::pair<uint64_t, uint64_t> Benchmark::runPerft(const Position& pos, int depth)
+#if (defined _WIN64 || defined __x86_64__)
+ #ifdef _MSC_VER
+ #include <intrin.h>
+ #else
+ #include <x86intrin.h>
+ #endif
+#endif
+
+std::pair<uint64_t, uint64_t> Benchmark::runPerft(const Position& pos, int depth, int threads, size_t hashSizeInMegaBytes)
 {
+    std::unique_ptr<PerftHashTable> hashTable(hashSizeInMegaBytes ? new PerftHashTable(hashSizeInMegaBytes) : nullptr);
     Stopwatch sw;
 
     sw.start();
-    const auto perftResult = perft(pos, depth, pos.inCheck());
+    const auto perftResult = parallelPerft(pos, depth, threads, hashTable.get());
     sw.stop();
 
     return std::make_pair(perftResult, sw.elapsed<std::chrono::milliseconds>());
 }
 
-std::pair<uint64_t, uint64_t> Benchmark::testPerft()
+std::pair<uint64_t, uint64_t> Benchmark::testPerft(int threads, size_t hashSizeInMegaBytes)
 {
     struct PerftTest
     {
@@ -49,6 +75,8 @@ std::pair<uint64_t, uint64_t> Benchmark::testPerft()
         { "rnbqkbnr/8/8/8/8/8/8/RNBQKBNR w KQkq - 0 1", 6, 8509434052 },
     } };
 
+    // The hash key includes the depth, so one table can be shared by all positions.
+    std::unique_ptr<PerftHashTable> hashTable(hashSizeInMegaBytes ? new PerftHashTable(hashSizeInMegaBytes) : nullptr);
     auto total = 0ULL;
     Stopwatch sw;
 
@@ -57,7 +85,7 @@ std::pair<uint64_t, uint64_t> Benchmark::testPerft()
     {
         auto& test = tests[i];
         Position pos(test.mFen);
-        const auto result = perft(pos, test.mDepth, pos.inCheck());
+        const auto result = parallelPerft(pos, test.mDepth, threads, hashTable.get());
         total += result;
         if (result != test.mResult)
         {
@@ -71,29 +99,730 @@ std::pair<uint64_t, uint64_t> Benchmark::testPerft()
     return std::make_pair(total, sw.elapsed<std::chrono::milliseconds>());
 }
 
-uint64_t Benchmark::perft(const Position& pos, int depth, bool inCheck)
+std::pair<uint64_t, uint64_t> Benchmark::runTranspositionTableBenchmark(int threads, size_t sizeInMegaBytes, uint64_t operationsPerThread)
 {
-    MoveList moveList;
-    auto nodes = 0ULL; 
+    TranspositionTable tt;
+    std::vector<std::thread> workers;
+    Stopwatch sw;
 
-    inCheck ? MoveGen::generateLegalEvasions(pos, moveList) : MoveGen::generatePseudoLegalMoves(pos, moveList);
-    for (auto i = 0; i < moveList.size(); ++i)
+    tt.setSize(sizeInMegaBytes);
+    sw.start();
+    for (auto t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&tt, t, operationsPerThread]()
+        {
+            // Random keys so that most accesses miss the cache, like in a real search.
+            auto rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+            auto hits = 0;
+            TranspositionTable::TranspositionTableEntry ttEntry;
+
+            for (auto i = 0ULL; i < operationsPerThread; i += 2)
+            {
+                rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27;
+                const auto hk = rng * 2685821657736338717ULL;
+                tt.prefetch(hk);
+                hits += tt.probe(hk, ttEntry);
+                tt.save(hk, Move(static_cast<uint16_t>(hk)), static_cast<int16_t>(hk >> 32), static_cast<int16_t>(hk >> 16), static_cast<int>(hk >> 48) & 0x3f, TranspositionTable::Flags::ExactScore);
+            }
+
+            // Make sure the probes are not optimized away.
+            volatile auto sink = hits;
+            (void)sink;
+        });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    sw.stop();
+
+    return std::make_pair(threads * operationsPerThread, sw.elapsed<std::chrono::milliseconds>());
+}
+
+std::pair<uint64_t, uint64_t> Benchmark::runSliderAttackBenchmark(uint64_t iterations)
+{
+    // Occupancies from nearly empty to nearly full boards, like in real games.
+    std::array<Bitboard, 1024> occupancies;
+    auto rng = 0x9E3779B97F4A7C15ULL;
+    for (auto& occupied : occupancies)
+    {
+        occupied = ~0ULL;
+        for (auto i = 0; i < 1 + (&occupied - occupancies.data()) % 3; ++i)
+        {
+            rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27;
+            occupied &= rng * 2685821657736338717ULL;
+        }
+    }
+
+    Bitboard sink = 0;
+    Stopwatch sw;
+
+    sw.start();
+    for (auto i = 0ULL; i < iterations; ++i)
+    {
+        // Chain the occupancies through the results so that the loads can't be hoisted or vectorized.
+        const auto occupied = occupancies[i & 1023] ^ (sink & 1);
+        for (Square sq = Square::A1; sq <= Square::H8; ++sq)
+        {
+            sink += Bitboards::bishopAttacks(sq, occupied) ^ Bitboards::rookAttacks(sq, occupied);
+        }
+    }
+    sw.stop();
+
+    // Make sure the lookups are not optimized away.
+    volatile auto result = sink;
+    (void)result;
+
+    return std::make_pair(iterations * 128, sw.elapsed<std::chrono::milliseconds>());
+}
+
+Benchmark::MaterialResult Benchmark::runMaterialBenchmark(int iterations)
+{
+    // Middlegames, endgames and some of the drawn endgames the endgame module knows about, two plies deep.
+    static const std::array<std::string, 6> fens = {
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "8/8/4kn2/8/3B4/2K5/8/8 w - - 0 1",
+        "8/5k2/3b4/8/2N5/3K4/8/8 w - - 0 1",
+        "6k1/5p2/6p1/8/7P/6P1/5PK1/3R4 w - - 0 1"
+    };
+    std::vector<Position> positions;
+    const EndgameModule endgameModule;
+    std::unique_ptr<Evaluation> evaluation(new Evaluation());
+    MaterialResult result;
+    int64_t sink = 0;
+    Stopwatch sw;
+
+    for (auto& fen : fens)
+    {
+        collectPositions(Position(fen), 2, positions);
+    }
+    result.mPositions = positions.size();
+    const auto operations = static_cast<uint64_t>(iterations) * positions.size() * 1000000000;
+
+    sw.start();
+    for (auto i = 0; i < iterations; ++i)
+    {
+        for (auto& pos : positions)
+        {
+            sink += endgameModule.drawnEndgame(pos.getMaterialHashKey());
+            sink += (pos.getPieceCount(Color::White, Piece::Bishop) == 2) - (pos.getPieceCount(Color::Black, Piece::Bishop) == 2);
+        }
+    }
+    sw.stop();
+    result.mUnorderedSetRate = operations / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+
+    sw.start();
+    for (auto i = 0; i < iterations; ++i)
     {
-        const auto move = moveList.getMove(i);
-        if (!pos.legal(move, inCheck))
+        for (auto& pos : positions)
+        {
+            sink += evaluation->probeMaterial(pos).mImbalance;
+        }
+    }
+    sw.stop();
+    result.mMaterialHashTableRate = operations / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+
+    sw.start();
+    for (auto i = 0; i < iterations; ++i)
+    {
+        for (auto& pos : positions)
+        {
+            sink += evaluation->evaluate(pos);
+        }
+    }
+    sw.stop();
+    result.mEvaluationRate = operations / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+
+    // Make sure the work is not optimized away.
+    volatile auto checksum = sink;
+    (void)checksum;
+
+    return result;
+}
+
+Benchmark::PawnResult Benchmark::runPawnBenchmark(int depth, int iterations)
+{
+    static const std::array<std::string, 3> fens = {
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -"
+    };
+    std::vector<Position> positions;
+    std::unique_ptr<Evaluation> evaluation(new Evaluation());
+    PawnResult result;
+    int64_t sink = 0;
+    Stopwatch sw;
+
+    // Depth-first order, so consecutive positions share pawn structures about as often as they do in a search.
+    for (auto& fen : fens)
+    {
+        collectPositions(Position(fen), depth, positions);
+    }
+    result.mPositions = positions.size();
+
+    evaluation->getPawnHashTable().resetStatistics();
+    sw.start();
+    for (auto& pos : positions)
+    {
+        sink += evaluation->evaluate(pos);
+    }
+    sw.stop();
+    result.mProbes = evaluation->getPawnHashTable().getProbes();
+    result.mHits = evaluation->getPawnHashTable().getHits();
+    result.mFirstPassTime = sw.elapsed<std::chrono::nanoseconds>() / std::max<uint64_t>(positions.size(), 1);
+
+    // Only use as many positions as fit into the table, otherwise some probes would still miss.
+    positions.erase(positions.begin() + std::min<size_t>(positions.size(), 4096), positions.end());
+    sw.start();
+    for (auto i = 0; i < iterations; ++i)
+    {
+        for (auto& pos : positions)
+        {
+            sink += evaluation->evaluate(pos);
+        }
+    }
+    sw.stop();
+    result.mHitTime = sw.elapsed<std::chrono::nanoseconds>() / std::max<uint64_t>(static_cast<uint64_t>(iterations) * positions.size(), 1);
+
+    volatile auto checksum = sink;
+    (void)checksum;
+
+    return result;
+}
+
+std::vector<Benchmark::EvaluationResult> Benchmark::runEvaluationBenchmark(int iterations)
+{
+    static const std::array<std::string, 6> fens = {
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "r1bqk2r/2p1bppp/p1np1n2/1p2p3/4P3/1BP2N2/PP1P1PPP/RNBQR1K1 b kq - 0 8",
+        "r4rk1/1q1bbppp/2np1n2/1p2p3/p2PP3/4BN1P/PPBN1PP1/2RQR1K1 w - - 0 18",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+        "6k1/5p2/6p1/8/7P/6P1/5PK1/3R4 w - - 0 1"
+    };
+    const auto readCounter = []()
+    {
+#if (defined _WIN64 || defined __x86_64__)
+        return static_cast<uint64_t>(__rdtsc());
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    };
+    std::vector<Position> positions;
+    std::unique_ptr<Evaluation> evaluation(new Evaluation());
+    std::vector<EvaluationResult> results;
+
+    for (auto& fen : fens)
+    {
+        collectPositions(Position(fen), 2, positions);
+    }
+
+    for (auto instructionSet : { Evaluation::InstructionSet::Generic, Evaluation::InstructionSet::Sse42, Evaluation::InstructionSet::Avx2 })
+    {
+        if (!Evaluation::instructionSetSupported(instructionSet))
         {
             continue;
         }
 
+        EvaluationResult result;
+        result.mInstructionSet = instructionSet;
+        result.mChecksum = 0;
+
+        // Warm up the material and pawn hash tables so that every instruction set is measured under the same conditions.
+        for (auto& pos : positions)
+        {
+            evaluation->evaluate(pos, instructionSet);
+        }
+
+        const auto start = readCounter();
+        for (auto i = 0; i < iterations; ++i)
+        {
+            for (auto& pos : positions)
+            {
+                result.mChecksum += evaluation->evaluate(pos, instructionSet);
+            }
+        }
+        result.mCyclesPerEvaluation = (readCounter() - start) / std::max<uint64_t>(static_cast<uint64_t>(iterations) * positions.size(), 1);
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+std::vector<Benchmark::NnueResult> Benchmark::runNnueBenchmark(int iterations)
+{
+    static const std::array<std::string, 4> fens = {
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+        "r4rk1/1q1bbppp/2np1n2/1p2p3/p2PP3/4BN1P/PPBN1PP1/2RQR1K1 w - - 0 18",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -"
+    };
+    std::vector<Position> positions;
+    std::vector<NnueResult> results;
+    Stopwatch sw;
+
+    if (!Nnue::isLoaded())
+    {
+        return results;
+    }
+
+    for (auto& fen : fens)
+    {
+        collectPositions(Position(fen), 2, positions);
+    }
+    std::vector<Nnue::Accumulator> accumulators(positions.size());
+
+    for (auto vectorized : { false, true })
+    {
+        if (vectorized && !Bitboards::avx2Supported())
+        {
+            break;
+        }
+
+        // Refreshing uses AVX2 whenever it is available, so the refresh time is the same for both.
+        NnueResult result;
+        result.mVectorized = vectorized;
+        result.mChecksum = 0;
+        sw.start();
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            Nnue::refreshAccumulator(positions[i], accumulators[i], Color::White);
+            Nnue::refreshAccumulator(positions[i], accumulators[i], Color::Black);
+        }
+        sw.stop();
+        result.mRefreshTime = sw.elapsed<std::chrono::nanoseconds>() / std::max<uint64_t>(positions.size(), 1);
+
+        sw.start();
+        for (auto j = 0; j < iterations; ++j)
+        {
+            for (size_t i = 0; i < positions.size(); ++i)
+            {
+                result.mChecksum += Nnue::evaluate(accumulators[i], positions[i].getSideToMove(), vectorized);
+            }
+        }
+        sw.stop();
+        result.mEvaluationsPerSecond = static_cast<uint64_t>(iterations) * positions.size() * 1000000000
+                                     / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+namespace
+{
+    // Middlegames, endgames and a few openings, none of them with the side to move mated or stalemated.
+    const std::array<std::string, 50> searchBenchmarkFens = { {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+        "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+        "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+        "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+        "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+        "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+        "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+        "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+        "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+        "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+        "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+        "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+        "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+        "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+        "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+        "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+        "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+        "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+        "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+        "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+        "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+        "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+        "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+        "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+        "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+        "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+        "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+        "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+        "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+        "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+        "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+        "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+        "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+        "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+        "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+        "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+        "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+        "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+        "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+        "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+        "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+        "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R w KQkq - 6 5",
+        "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6 0 2",
+        "2r3k1/pp3ppp/4p3/3pP3/3P4/P4N2/1P3PPP/2R3K1 w - - 0 25",
+    } };
+
+    // Discards everything the search sends except the final node count and search time.
+    class BenchmarkListener : public SearchListener
+    {
+    public:
+        BenchmarkListener() :
+        done(false), nodeCount(0), searchTime(0)
+        {
+        }
+
+        // Blocks until the current search has finished.
+        // Returns a pair of the amount of nodes searched and the time it took, in ms.
+        std::pair<uint64_t, uint64_t> waitForBestMove()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return done; });
+            done = false;
+            return std::make_pair(nodeCount, searchTime);
+        }
+
+        virtual void infoCurrMove(const Move&, int, int) {}
+        virtual void infoRegular(uint64_t, uint64_t, uint64_t) {}
+        virtual void infoPv(const std::vector<Move>&, uint64_t, uint64_t, uint64_t, int, int, int, int) {}
+        virtual void infoEvaluationCache(uint64_t, uint64_t) {}
+        virtual void infoSearchStatistics(const SearchStatistics&) {}
+
+        virtual void infoBestMove(const std::vector<Move>&, uint64_t time, uint64_t nodes, uint64_t)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            nodeCount = nodes;
+            searchTime = time;
+            done = true;
+            cv.notify_one();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done;
+        uint64_t nodeCount;
+        uint64_t searchTime;
+    };
+}
+
+Benchmark::SearchResult Benchmark::runSearchBenchmark(size_t hashSizeInMegaBytes, int threads, int depth)
+{
+    // The listener has to outlive the search, the search thread might still be returning from its last call to it.
+    BenchmarkListener listener;
+    Search search(listener);
+    SearchResult result = {};
+
+    search.setTranspositionTableSize(hashSizeInMegaBytes);
+    search.setThreads(threads);
+
+    for (auto& fen : searchBenchmarkFens)
+    {
+        // The search needs room for the hash keys of the positions it goes through, even though there is no game history.
+        SearchParameters sp;
+        sp.mDepth = depth;
+        sp.mHashKeys.assign(1024, 0);
+
+        search.clearSearch();
+        search.go(Position(fen), sp);
+        const auto searchResult = listener.waitForBestMove();
+        ++result.mPositions;
+        result.mNodes += searchResult.first;
+        result.mTime += searchResult.second;
+    }
+
+    return result;
+}
+
+std::vector<Position> Benchmark::getSearchBenchmarkPositions(int depth)
+{
+    std::vector<Position> positions;
+
+    for (auto& fen : searchBenchmarkFens)
+    {
+        const Position pos(fen);
+        positions.push_back(pos);
+        for (auto d = 1; d <= depth; ++d)
+        {
+            collectPositions(pos, d, positions);
+        }
+    }
+
+    return positions;
+}
+
+uint64_t Benchmark::runAcceleratorBenchmark(Accelerator& accelerator, int jobs, int batchSize)
+{
+    std::vector<TaskResult> batch(batchSize);
+    std::vector<int> coreIds(batchSize);
+    auto checksum = 0;
+    Stopwatch sw;
+
+    // The jobs are copies of a typical aspiration window update.
+    for (auto& job : batch)
+    {
+        job = TaskResult{ 1, 30, -10, 10, 16, nullptr, nullptr, false };
+    }
+
+    sw.start();
+    for (auto sent = 0; sent < jobs; sent += batchSize)
+    {
+        accelerator.submitBatch(batch.data(), batchSize, coreIds.data());
+        for (auto coreId : coreIds)
+        {
+            checksum += accelerator.join(coreId).beta;
+        }
+    }
+    sw.stop();
+
+    // Check that the jobs really ran.
+    if (checksum != ((jobs + batchSize - 1) / batchSize) * batchSize * 26)
+    {
+        throw std::runtime_error("accelerator returned wrong results");
+    }
+
+    return sw.elapsed<std::chrono::nanoseconds>() / (((jobs + batchSize - 1) / batchSize) * batchSize);
+}
+
+namespace
+{
+    // The thread pool we used before the work-stealing one, kept here for comparison.
+    class MutexQueuePool
+    {
+    public:
+        MutexQueuePool(int amountOfThreads) :
+        terminateFlag(false)
+        {
+            for (auto i = 0; i < amountOfThreads; ++i)
+            {
+                threads.emplace_back(&MutexQueuePool::loop, this);
+            }
+        }
+
+        ~MutexQueuePool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(jobQueueMutex);
+                terminateFlag = true;
+            }
+            cv.notify_all();
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        template<class Fn, class... Args>
+        void addJob(Fn&& fn, Args&&... args)
+        {
+            const auto job = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
+            std::unique_lock<std::mutex> lock(jobQueueMutex);
+            jobQueue.push(job);
+            cv.notify_one();
+        }
+
+    private:
+        std::vector<std::thread> threads;
+        std::queue<std::function<void()>> jobQueue;
+        std::mutex jobQueueMutex;
+        std::condition_variable cv;
+        bool terminateFlag;
+
+        void loop()
+        {
+            for (;;)
+            {
+                std::function<void()> job;
+
+                {
+                    std::unique_lock<std::mutex> lock(jobQueueMutex);
+                    while (!terminateFlag && jobQueue.empty())
+                    {
+                        cv.wait(lock);
+                    }
+
+                    if (terminateFlag)
+                    {
+                        return;
+                    }
+
+                    job = jobQueue.front();
+                    jobQueue.pop();
+                }
+
+                job();
+            }
+        }
+    };
+
+    template <class Pool>
+    struct PoolBenchmark
+    {
+        static void increment(std::atomic<int>* counter)
+        {
+            counter->fetch_add(1, std::memory_order_release);
+        }
+
+        // Splits the jobs in two until single jobs remain, so almost all jobs are added from inside the pool.
+        static void spawn(Pool* pool, std::atomic<int>* counter, int jobs)
+        {
+            if (jobs == 1)
+            {
+                increment(counter);
+                return;
+            }
+            pool->addJob(&PoolBenchmark::spawn, pool, counter, jobs / 2);
+            pool->addJob(&PoolBenchmark::spawn, pool, counter, jobs - jobs / 2);
+        }
+
+        static void waitFor(const std::atomic<int>& counter, int value)
+        {
+            while (counter.load(std::memory_order_acquire) < value)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        static Benchmark::ThreadPoolResult run(Pool& pool, int jobs)
+        {
+            // Add the external jobs in batches so that they fit into the job slots of the work-stealing pool.
+            const auto batchSize = 256;
+            const auto roundTrips = std::min(jobs, 10000);
+            Benchmark::ThreadPoolResult result;
+            std::atomic<int> counter(0);
+            Stopwatch sw;
+
+            sw.start();
+            for (auto i = 0; i < roundTrips; ++i)
+            {
+                pool.addJob(&PoolBenchmark::increment, &counter);
+                waitFor(counter, i + 1);
+            }
+            sw.stop();
+            result.mLatency = sw.elapsed<std::chrono::nanoseconds>() / roundTrips;
+
+            counter = 0;
+            sw.start();
+            for (auto i = 0; i < jobs; i += batchSize)
+            {
+                const auto batch = std::min(batchSize, jobs - i);
+                for (auto j = 0; j < batch; ++j)
+                {
+                    pool.addJob(&PoolBenchmark::increment, &counter);
+                }
+                waitFor(counter, i + batch);
+            }
+            sw.stop();
+            result.mExternalThroughput = jobs * 1000000000ULL / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+
+            counter = 0;
+            sw.start();
+            pool.addJob(&PoolBenchmark::spawn, &pool, &counter, jobs);
+            waitFor(counter, jobs);
+            sw.stop();
+            // A tree with n leaves has 2n - 1 nodes, every one of them is a job.
+            result.mNestedThroughput = (2ULL * jobs - 1) * 1000000000ULL / std::max<uint64_t>(sw.elapsed<std::chrono::nanoseconds>(), 1);
+
+            return result;
+        }
+    };
+}
+
+Benchmark::ThreadPoolResult Benchmark::runThreadPoolBenchmark(bool workStealing, int threads, int jobs)
+{
+    if (workStealing)
+    {
+        ThreadPool pool(threads);
+        return PoolBenchmark<ThreadPool>::run(pool, jobs);
+    }
+
+    MutexQueuePool pool(threads);
+    return PoolBenchmark<MutexQueuePool>::run(pool, jobs);
+}
+
+uint64_t Benchmark::parallelPerft(const Position& pos, int depth, int threads, PerftHashTable* hashTable)
+{
+    // Splitting only the root moves leaves threads idle when a few moves have much bigger subtrees than the rest, so split the second ply too.
+    const auto splitDepth = std::min(depth - 1, 2);
+    std::vector<Position> positions;
+    std::atomic<uint64_t> nodes(0);
+
+    if (threads <= 1 || splitDepth <= 0)
+    {
+        Position root(pos);
+        return perft(root, depth, hashTable);
+    }
+
+    collectPositions(pos, splitDepth, positions);
+    // The calling thread works too, so the pool needs one thread less.
+    ThreadPool tp(threads - 1);
+    tp.parallelFor(0, static_cast<int>(positions.size()), [&](int i)
+    {
+        nodes.fetch_add(perft(positions[i], depth - splitDepth, hashTable), std::memory_order_relaxed);
+    });
+
+    return nodes;
+}
+
+void Benchmark::collectPositions(const Position& pos, int depth, std::vector<Position>& positions)
+{
+    MoveList moveList;
+
+    MoveGen::generateLegalMoves(pos, moveList);
+    for (auto i = 0; i < moveList.size(); ++i)
+    {
+        Position newPos(pos);
+        newPos.makeMove(moveList.getMove(i));
         if (depth == 1)
         {
-            ++nodes;
-            continue;
+            positions.push_back(newPos);
+        }
+        else
+        {
+            collectPositions(newPos, depth - 1, positions);
         }
+    }
+}
+
+uint64_t Benchmark::perft(Position& pos, int depth, PerftHashTable* hashTable)
+{
+    MoveList moveList;
+    uint64_t nodes = 0; 
+
+    // Bulk count the last ply, no need to generate the moves let alone make them.
+    if (depth == 1)
+    {
+        return MoveGen::countLegalMoves(pos);
+    }
 
+    if (hashTable && hashTable->probe(pos.getHashKey(), depth, nodes))
+    {
+        return nodes;
+    }
+
+    MoveGen::generateLegalMoves(pos, moveList);
+    for (auto i = 0; i < moveList.size(); ++i)
+    {
+#ifdef MAKE_UNMAKE
+        Position::UndoInfo undo;
+        pos.makeMove(moveList.getMove(i), undo);
+        nodes += perft(pos, depth - 1, hashTable);
+        pos.unmakeMove(moveList.getMove(i), undo);
+#else
         Position newPos(pos);
-        newPos.makeMove(move);
-        nodes += depth == 1 ? 1 : perft(newPos, depth - 1, newPos.inCheck());
+        newPos.makeMove(moveList.getMove(i));
+        nodes += perft(newPos, depth - 1, hashTable);
+#endif
+    }
+
+    if (hashTable)
+    {
+        hashTable->save(pos.getHashKey(), depth, nodes);
     }
 
     return nodes;
@@ -22,8 +22,12 @@
 #define BENCHMARK_HPP_
 
 #include <cstdint>
+#include <vector>
 #include "position.hpp"
 #include "movegen.hpp"
+#include "perft_hash.hpp"
+#include "evaluation.hpp"
+#include "utils/accelerator.hpp"
 
 /// @brief Benchmarking functions and utilities.
 ///
@@ -31,20 +35,142 @@
 class Benchmark
 {
 public:
+    /// @brief The results of runThreadPoolBenchmark.
+    struct ThreadPoolResult
+    {
+        uint64_t mLatency; ///< The average time from adding a job to seeing it done, in nanoseconds.
+        uint64_t mExternalThroughput; ///< Jobs per second when all jobs are added by a thread outside the pool.
+        uint64_t mNestedThroughput; ///< Jobs per second when the jobs are added by other jobs, like in a recursive search.
+    };
+
+    /// @brief The results of runMaterialBenchmark, all in operations per second.
+    struct MaterialResult
+    {
+        uint64_t mPositions; ///< The amount of different positions used.
+        uint64_t mUnorderedSetRate; ///< Drawn endgame lookups from the unordered sets of the EndgameModule plus the bishop pair check, what the evaluation function did before the material hash table.
+        uint64_t mMaterialHashTableRate; ///< Material hash table probes.
+        uint64_t mEvaluationRate; ///< Full evaluations, which include a material hash table probe.
+    };
+
+    /// @brief The results of runPawnBenchmark.
+    struct PawnResult
+    {
+        uint64_t mPositions; ///< The amount of different positions used.
+        uint64_t mProbes; ///< Pawn hash table probes done when evaluating the positions once in search order, starting from an empty table.
+        uint64_t mHits; ///< How many of those probes were hits.
+        uint64_t mFirstPassTime; ///< The average time of an evaluation in the first pass, in nanoseconds.
+        uint64_t mHitTime; ///< The average time of an evaluation when every pawn hash table probe hits, in nanoseconds.
+    };
+
+    /// @brief The results of runEvaluationBenchmark for a single instruction set.
+    struct EvaluationResult
+    {
+        Evaluation::InstructionSet mInstructionSet; ///< The instruction set.
+        uint64_t mCyclesPerEvaluation; ///< The average amount of processor cycles an evaluation took, as counted by RDTSC. Nanoseconds on other processors.
+        int64_t mChecksum; ///< The sum of all evaluations. Must be the same for all instruction sets.
+    };
+
+    /// @brief The results of runNnueBenchmark for either the scalar or the vectorized version of the network.
+    struct NnueResult
+    {
+        bool mVectorized; ///< Whether AVX2 was used.
+        uint64_t mEvaluationsPerSecond; ///< Evaluations per second, given an up to date accumulator.
+        uint64_t mRefreshTime; ///< The average time it took to calculate both sides of an accumulator from scratch, in nanoseconds.
+        int64_t mChecksum; ///< The sum of all evaluations. Must be the same for both versions.
+    };
+
+    /// @brief The results of runSearchBenchmark.
+    struct SearchResult
+    {
+        uint64_t mPositions; ///< The amount of positions searched.
+        uint64_t mNodes; ///< The total amount of nodes searched. Serves as a signature of the search, as it changes whenever the search or evaluation does.
+        uint64_t mTime; ///< The total time spent searching, in ms.
+    };
+
     /// @brief Run perft to a given depth on a given position.
     /// @param pos The position.
     /// @param depth The depth.
+    /// @param threads The amount of threads to use.
+    /// @param hashSizeInMegaBytes The size of the perft hash table, 0 disables it.
     /// @return A pair of the perft result and the time it took to calculate it, in ms.
-    static std::pair<uint64_t, uint64_t> runPerft(const Position& pos, int depth);
+    static std::pair<uint64_t, uint64_t> runPerft(const Position& pos, int depth, int threads = 1, size_t hashSizeInMegaBytes = 0);
 
     /// @brief Runs perft on a predetermined set of positions. 
+    /// @param threads The amount of threads to use.
+    /// @param hashSizeInMegaBytes The size of the perft hash table, 0 disables it.
     /// @return A pair of the nodes searched and the time it took to calculate it, in ms.
     ///
     /// Throws an exception if the perft result is incorrect at any point.
-    static std::pair<uint64_t, uint64_t> testPerft();
+    static std::pair<uint64_t, uint64_t> testPerft(int threads = 1, size_t hashSizeInMegaBytes = 0);
+
+    /// @brief Measures the throughput of the transposition table when accessed concurrently.
+    /// @param threads The amount of threads hammering the table.
+    /// @param sizeInMegaBytes The size of the table.
+    /// @param operationsPerThread The amount of probes and saves every thread does. Half of the operations are probes and half saves.
+    /// @return A pair of the total amount of operations done and the time it took, in ms.
+    static std::pair<uint64_t, uint64_t> runTranspositionTableBenchmark(int threads, size_t sizeInMegaBytes, uint64_t operationsPerThread);
+
+    /// @brief Measures the round-trip time of jobs sent to an accelerator.
+    /// @param accelerator The accelerator.
+    /// @param jobs The amount of jobs to send.
+    /// @param batchSize The amount of jobs submitted at once before joining them. 1 means that every job is joined before sending the next one.
+    /// @return The average round-trip time of a single job, in nanoseconds.
+    static uint64_t runAcceleratorBenchmark(Accelerator& accelerator, int jobs, int batchSize);
+
+    /// @brief Measures the throughput of slider attack generation with whichever backend, magics or PEXT, the program was compiled with.
+    /// @param iterations The amount of occupancies to go through. Bishop and rook attacks are calculated from every square for each.
+    /// @return A pair of the amount of attack sets calculated and the time it took, in ms.
+    static std::pair<uint64_t, uint64_t> runSliderAttackBenchmark(uint64_t iterations);
+
+    /// @brief Measures the cost of the material part of the evaluation function with and without the material hash table.
+    /// @param iterations How many times to go through the positions.
+    /// @return The results.
+    static MaterialResult runMaterialBenchmark(int iterations);
+
+    /// @brief Measures the hit rate of the pawn hash table and the time the evaluation function takes per position.
+    /// @param depth The depth the positions are collected from.
+    /// @param iterations How many times to go through the positions when every probe hits.
+    /// @return The results.
+    static PawnResult runPawnBenchmark(int depth, int iterations);
+
+    /// @brief Measures the time a full evaluation takes with every instruction set supported by the processor.
+    /// @param iterations How many times to go through the positions.
+    /// @return The results, one for each supported instruction set.
+    static std::vector<EvaluationResult> runEvaluationBenchmark(int iterations);
+
+    /// @brief Measures the speed of the neural network evaluation, both with and without AVX2 if the processor supports it.
+    /// @param iterations How many times to go through the positions.
+    /// @return The results, one for each version. Empty if no network is loaded.
+    static std::vector<NnueResult> runNnueBenchmark(int iterations);
+
+    /// @brief Searches a predetermined set of positions to a fixed depth, starting every search with cleared tables.
+    /// @param hashSizeInMegaBytes The size of the TT.
+    /// @param threads The amount of searcher threads.
+    /// @param depth The depth to search every position to.
+    /// @return The results.
+    ///
+    /// Uses a search of its own, so the tables of any other search are not touched.
+    /// The node count is the same on every run only with a single thread, helper threads make it vary.
+    static SearchResult runSearchBenchmark(size_t hashSizeInMegaBytes, int threads, int depth);
+
+    /// @brief Get the positions runSearchBenchmark searches, followed by every position up to a given amount of plies from each of them.
+    /// @param depth The amount of plies. 0 gives just the positions of runSearchBenchmark.
+    /// @return The positions.
+    ///
+    /// A corpus of realistic positions for microbenchmarks.
+    static std::vector<Position> getSearchBenchmarkPositions(int depth);
+
+    /// @brief Measures the cost of dispatching jobs to a thread pool.
+    /// @param workStealing Whether to measure the work-stealing ThreadPool or the mutex protected job queue it replaced.
+    /// @param threads The amount of threads in the pool.
+    /// @param jobs The amount of empty jobs to run for every measurement.
+    /// @return The results.
+    static ThreadPoolResult runThreadPoolBenchmark(bool workStealing, int threads, int jobs);
 
 private:
-    static uint64_t perft(const Position& pos, int depth, bool inCheck);
+    static uint64_t perft(Position& pos, int depth, PerftHashTable* hashTable);
+    static uint64_t parallelPerft(const Position& pos, int depth, int threads, PerftHashTable* hashTable);
+    static void collectPositions(const Position& pos, int depth, std::vector<Position>& positions);
 };
 
 #endif
@@ -18,6 +18,13 @@
 #include "bitboards.hpp"
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// With precomputed tables these are defined in precomputed_tables.cpp instead.
+#ifndef PRECOMPUTED_TABLES
 std::array<Bitboard, 64> Bitboards::mBits;
 std::array<Bitboard, 64> Bitboards::mKingAttacks;
 std::array<Bitboard, 64> Bitboards::mKnightAttacks;
@@ -31,6 +38,12 @@ std::array<std::array<Bitboard, 64>, 2> Bitboards::mBackward;
 std::array<Bitboard, 64> Bitboards::mIsolated;
 std::array<std::array<Bitboard, 64>, 2> Bitboards::mKingZone;
 
+std::array<Bitboards::Magic, 64> Bitboards::mBishopMagics;
+std::array<Bitboards::Magic, 64> Bitboards::mRookMagics;
+
+std::array<Bitboard, Bitboards::lookupTableSize> Bitboards::mLookupTable;
+#endif
+
 const std::array<Bitboard, 8> Bitboards::ranks = {
     0x00000000000000FF,
     0x000000000000FF00,
@@ -54,6 +67,9 @@ const std::array<Bitboard, 8> Bitboards::files = {
 };
 
 bool Bitboards::mHardwarePopcntSupported;
+bool Bitboards::mBmi2Supported;
+bool Bitboards::mSse42Supported;
+bool Bitboards::mAvx2Supported;
 
 #if !(defined _WIN64 || defined __x86_64__)
 const std::array<int, 64> Bitboards::mIndex = {
@@ -68,11 +84,6 @@ const std::array<int, 64> Bitboards::mIndex = {
 };
 #endif
 
-std::array<Bitboards::Magic, 64> Bitboards::mBishopMagics;
-std::array<Bitboards::Magic, 64> Bitboards::mRookMagics;
-
-std::array<Bitboard, 97264> Bitboards::mLookupTable;
-
 const std::array<Bitboards::MagicInit, 64> Bitboards::mBishopInit = { {
         { 0x007bfeffbfeffbff, 16530 },
         { 0x003effbfeffbfe08, 9162 },
@@ -211,6 +222,7 @@ const std::array<Bitboards::MagicInit, 64> Bitboards::mRookInit = { {
 
 void Bitboards::staticInitialize()
 {
+#ifndef PRECOMPUTED_TABLES
     static const std::array<int, 8> rankDirection = {
         -1, -1, -1, 0, 0, 1, 1, 1
     };
@@ -353,9 +365,13 @@ void Bitboards::staticInitialize()
     mLookupTable.fill(0);
     initializeMagics(mBishopInit, mBishopMagics, bishopDirections, 64 - 9);
     initializeMagics(mRookInit, mRookMagics, rookDirections, 64 - 12);
+#endif
 
 #if !(defined _WIN64 || defined __x86_64__)
     mHardwarePopcntSupported = false;
+    mBmi2Supported = false;
+    mSse42Supported = false;
+    mAvx2Supported = false;
 #else
     int regs[4] = { 0, 0, 0, 0 };
  #if (defined __clang__ || defined __GNUC__)
@@ -370,9 +386,56 @@ void Bitboards::staticInitialize()
     __cpuid(regs, 0x00000001);
  #endif
     mHardwarePopcntSupported = (regs[2] & (1 << 23)) != 0;
+    mSse42Supported = (regs[2] & (1 << 20)) != 0;
+
+    // AVX2 also needs the operating system to save the YMM registers on context switches, which is checked with XGETBV.
+    auto osSavesYmm = false;
+    if (regs[2] & (1 << 27))
+    {
+ #if (defined __clang__ || defined __GNUC__)
+        uint32_t xcr0, edx;
+        __asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+ #else
+        const auto xcr0 = _xgetbv(0);
+ #endif
+        osSavesYmm = (xcr0 & 6) == 6;
+    }
+
+    // BMI2 is reported in EBX of leaf 7, subleaf 0. Leaf 0 tells whether leaf 7 exists at all.
+ #if (defined __clang__ || defined __GNUC__)
+    regs[0] = 0x00000000;
+    __asm__ __volatile__ (
+     "cpuid;"
+    : "+a" (regs[0]),
+      "=b" (regs[1]),
+      "=c" (regs[2]),
+      "=d" (regs[3]));
+ #else
+    __cpuid(regs, 0x00000000);
+ #endif
+    mBmi2Supported = false;
+    mAvx2Supported = false;
+    if (regs[0] >= 7)
+    {
+ #if (defined __clang__ || defined __GNUC__)
+        regs[0] = 0x00000007;
+        regs[2] = 0x00000000;
+        __asm__ __volatile__ (
+         "cpuid;"
+        : "+a" (regs[0]),
+          "=b" (regs[1]),
+          "+c" (regs[2]),
+          "=d" (regs[3]));
+ #else
+        __cpuidex(regs, 0x00000007, 0x00000000);
+ #endif
+        mBmi2Supported = (regs[1] & (1 << 8)) != 0;
+        mAvx2Supported = osSavesYmm && (regs[1] & (1 << 5)) != 0;
+    }
 #endif
 }
 
+#ifndef PRECOMPUTED_TABLES
 void Bitboards::initializeMagics(const std::array<MagicInit, 64>& magicInit, std::array<Magic, 64>& magic, 
                                  const std::array<std::array<int, 2>, 4>& dir, int shift)
 {
@@ -400,11 +463,22 @@ void Bitboards::initializeMagics(const std::array<MagicInit, 64>& magicInit, std
         return result;
     };
 
+#ifdef USE_PEXT
+    // The rook attacks come after all bishop attacks.
+    auto offset = (shift == 64 - 12) ? 5248 : 0;
+#endif
+
     for (Square sq = Square::A1; sq <= Square::H8; ++sq)
     {
         magic[sq].mMagic = magicInit[sq].mMagic;
-        magic[sq].mData = &mLookupTable[magicInit[sq].mIndex];
         auto bb = magic[sq].mMask = ((shift == 64 - 12) ? rookMask(sq) : bishopMask(sq));
+#ifdef USE_PEXT
+        const auto base = offset;
+        offset += 1 << popcnt<false>(bb);
+#else
+        const auto base = magicInit[sq].mIndex;
+#endif
+        magic[sq].mData = &mLookupTable[base];
         const auto sq88 = sq + (sq & ~7);
 
         squares.clear();
@@ -435,9 +509,18 @@ void Bitboards::initializeMagics(const std::array<MagicInit, 64>& magicInit, std
                     }
                 }
             }
+#ifdef USE_PEXT
+            const auto j = _pext_u64(bb, magic[sq].mMask);
+#else
             const auto j = ((bb * magic[sq].mMagic) >> shift);
-            magic[sq].mData[j] = bb2;
+#endif
+            mLookupTable[base + j] = bb2;
         }
     }
+
+#ifdef USE_PEXT
+    assert(offset == ((shift == 64 - 12) ? lookupTableSize : 5248));
+#endif
 }
+#endif
 
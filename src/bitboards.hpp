@@ -27,6 +27,11 @@
 #include "square.hpp"
 #include "color.hpp"
 #include "piece.hpp"
+#include "precomputed_tables.hpp"
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
 
 /// @brief A bitboard is just a quadword, so let's do a simple typedef for convenience. Why am I even commenting this?
 using Bitboard = uint64_t;
@@ -181,10 +186,26 @@ public:
     /// @return True if hardware POPCNT is supported, false otherwise.
     static bool hardwarePopcntSupported() noexcept;
 
+    /// @brief Used for checking if the processor we are running on supports BMI2, i.e. PEXT. 
+    /// @return True if BMI2 is supported, false otherwise.
+    ///
+    /// Builds with USE_PEXT defined index the slider attack tables with PEXT and can't run without BMI2.
+    static bool bmi2Supported() noexcept;
+
+    /// @brief Used for checking if the processor we are running on supports SSE4.2.
+    /// @return True if SSE4.2 is supported, false otherwise.
+    static bool sse42Supported() noexcept;
+
+    /// @brief Used for checking if the processor and the operating system we are running on support AVX2.
+    /// @return True if AVX2 is supported, false otherwise.
+    static bool avx2Supported() noexcept;
+
 private:
+    friend class TableGenerator;
+
     struct Magic
     {
-        Bitboard* mData;
+        const Bitboard* mData;
         Bitboard mMask;
         Bitboard mMagic;
     };
@@ -198,44 +219,63 @@ private:
     static int hardwarePopcnt(Bitboard bb) noexcept;
     static int softwarePopcnt(Bitboard bb) noexcept;
 
-    static std::array<Magic, 64> mBishopMagics;
-    static std::array<Magic, 64> mRookMagics;
-    static std::array<Bitboard, 97264> mLookupTable;
+    static PRECOMPUTED_TABLE std::array<Magic, 64> mBishopMagics;
+    static PRECOMPUTED_TABLE std::array<Magic, 64> mRookMagics;
+    // With magics the attack sets of different squares overlap in the table, with PEXT every square needs 2^(bits in mask) entries of its own.
+#ifdef USE_PEXT
+    static const int lookupTableSize = 5248 + 102400;
+#else
+    static const int lookupTableSize = 97264;
+#endif
+    static PRECOMPUTED_TABLE std::array<Bitboard, lookupTableSize> mLookupTable;
     static const std::array<MagicInit, 64> mRookInit;
     static const std::array<MagicInit, 64> mBishopInit;
 
     static void initializeMagics(const std::array<MagicInit, 64>& magicInit, std::array<Magic, 64>& magic, 
                                  const std::array<std::array<int, 2>, 4>& dir, int shift);
 
-    static std::array<Bitboard, 64> mBits;
-    static std::array<Bitboard, 64> mKingAttacks;
-    static std::array<Bitboard, 64> mKnightAttacks;
-    static std::array<std::array<Bitboard, 64>, 2> mPawnAttacks;
-    static std::array<std::array<Bitboard, 64>, 64> mLines;
-    static std::array<std::array<Bitboard, 64>, 64> mBetween;
-    static std::array<std::array<Bitboard, 64>, 8> mRays;
-    static std::array<std::array<Bitboard, 64>, 2> mPassed;
-    static std::array<std::array<Bitboard, 64>, 2> mBackward;
-    static std::array<Bitboard, 64> mIsolated;
-    static std::array<std::array<Bitboard, 64>, 2> mKingZone;
+    static PRECOMPUTED_TABLE std::array<Bitboard, 64> mBits;
+    static PRECOMPUTED_TABLE std::array<Bitboard, 64> mKingAttacks;
+    static PRECOMPUTED_TABLE std::array<Bitboard, 64> mKnightAttacks;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 2> mPawnAttacks;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 64> mLines;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 64> mBetween;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 8> mRays;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 2> mPassed;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 2> mBackward;
+    static PRECOMPUTED_TABLE std::array<Bitboard, 64> mIsolated;
+    static PRECOMPUTED_TABLE std::array<std::array<Bitboard, 64>, 2> mKingZone;
 
 #if !(defined _WIN64 || defined __x86_64__)
     static const std::array<int, 64> mIndex;
 #endif
 
     static bool mHardwarePopcntSupported;
+    static bool mBmi2Supported;
+    static bool mSse42Supported;
+    static bool mAvx2Supported;
 };
 
+// PEXT gathers the occupied squares within the mask into a dense index directly, so there is no multiplication and no magic constant.
+// The magic structures are the same for both, only mMagic is unused with PEXT.
 inline Bitboard Bitboards::bishopAttacks(Square sq, Bitboard occupied)
 {
     const auto& mag = mBishopMagics[sq];
+#ifdef USE_PEXT
+    return mag.mData[_pext_u64(occupied, mag.mMask)];
+#else
     return mag.mData[((occupied & mag.mMask) * mag.mMagic) >> (64 - 9)];
+#endif
 }
 
 inline Bitboard Bitboards::rookAttacks(Square sq, Bitboard occupied)
 {
     const auto& mag = mRookMagics[sq];
+#ifdef USE_PEXT
+    return mag.mData[_pext_u64(occupied, mag.mMask)];
+#else
     return mag.mData[((occupied & mag.mMask) * mag.mMagic) >> (64 - 12)];
+#endif
 }
 
 inline Bitboard Bitboards::queenAttacks(Square sq, Bitboard occupied)
@@ -390,6 +430,21 @@ inline bool Bitboards::hardwarePopcntSupported() noexcept
     return mHardwarePopcntSupported;
 }
 
+inline bool Bitboards::bmi2Supported() noexcept
+{
+    return mBmi2Supported;
+}
+
+inline bool Bitboards::sse42Supported() noexcept
+{
+    return mSse42Supported;
+}
+
+inline bool Bitboards::avx2Supported() noexcept
+{
+    return mAvx2Supported;
+}
+
 inline int Bitboards::hardwarePopcnt(Bitboard bb) noexcept
 {
 #if (defined _WIN64 || defined __x86_64__)
@@ -0,0 +1,63 @@
+#!/usr/bin/env python
+
+# Compares two runs of microbench and flags the benchmarks which got slower by more than a threshold.
+# The CPU time per operation is compared, it is less affected by other processes running on the machine than the wall time.
+# Exits with 1 if there are any such regressions, so that it can be used in scripts.
+#
+# Usage: ./compare_microbench.py <baseline.json> <contender.json> [threshold in percent]
+#
+# For example:
+#   make microbench && ./microbench > baseline.json
+#   (apply the change) make microbench && ./microbench > contender.json
+#   ./compare_microbench.py baseline.json contender.json 5
+
+from __future__ import print_function
+
+import json
+import sys
+
+def load(file_name):
+    with open(file_name) as f:
+        data = json.load(f)
+    return data["context"], dict((b["name"], b) for b in data["benchmarks"])
+
+def main():
+    if len(sys.argv) < 3:
+        print("Usage: ./compare_microbench.py <baseline.json> <contender.json> [threshold in percent]")
+        sys.exit(2)
+
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 5.0
+    base_context, base = load(sys.argv[1])
+    new_context, new = load(sys.argv[2])
+
+    if base_context.get("positions") != new_context.get("positions"):
+        print("warning: the runs used different corpora (%s and %s positions)" % (base_context.get("positions"), new_context.get("positions")))
+    print("baseline:  %s (%s)" % (base_context.get("executable"), base_context.get("build")))
+    print("contender: %s (%s)" % (new_context.get("executable"), new_context.get("build")))
+    print()
+    print("%-40s %12s %12s %9s" % ("benchmark", "base(ns)", "new(ns)", "change"))
+
+    regressions = []
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-40s %s" % (name, "only in " + (sys.argv[1] if name in base else sys.argv[2])))
+            continue
+        old_time = base[name]["cpu_time"]
+        new_time = new[name]["cpu_time"]
+        change = (new_time - old_time) / old_time * 100.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        elif change < -threshold:
+            flag = "  improvement"
+        print("%-40s %12.2f %12.2f %+8.1f%%%s" % (name, old_time, new_time, change, flag))
+
+    print()
+    if regressions:
+        print("%d benchmark(s) slower by more than %.1f%%" % (len(regressions), threshold))
+        sys.exit(1)
+    print("no regressions over %.1f%%" % threshold)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python
+
+# Decodes a search trace written by Hakkapeliitta (the UCI option "Trace File") into CSV or the Chrome trace event format.
+# The Chrome format can be opened in chrome://tracing or https://ui.perfetto.dev, every search in the file is shown as its own process.
+#
+# Usage: ./decode_trace.py <trace file> [csv|chrome]
+#
+# For example:
+#   setoption name Trace File value search.trace
+#   go movetime 10000
+#   ./decode_trace.py search.trace chrome > search.json
+
+from __future__ import print_function
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<4sIII")
+RECORD = struct.Struct("<QQiiHHhBB")
+
+EVENTS = ["search_start", "iteration_start", "root_move", "fail_high", "fail_low",
+          "best_move_change", "iteration_end", "time_check", "search_end"]
+
+# The meaning of the two event-specific values, see SearchTrace::EventType.
+VALUES = {
+    "search_start": ("target_time_ms", "max_time_ms"),
+    "iteration_start": ("alpha", "beta"),
+    "root_move": ("time_us", "nodes"),
+    "fail_high": ("alpha", "beta"),
+    "fail_low": ("alpha", "beta"),
+    "best_move_change": (None, None),
+    "iteration_end": ("sel_depth", "moves_searched"),
+    "time_check": ("elapsed_ms", "continue"),
+    "search_end": ("dropped_events", None),
+}
+
+def square(s):
+    return "abcdefgh"[s % 8] + str(s // 8 + 1)
+
+def move_to_uci(raw):
+    if raw == 0:
+        return ""
+    flags = raw >> 12
+    move = square(raw & 63) + square((raw >> 6) & 63)
+    # Flags 1-4 are promotions, the other special moves look like normal moves in UCI notation.
+    if 1 <= flags <= 4:
+        move += "pnbrqk"[flags]
+    return move
+
+def read_records(file_name):
+    with open(file_name, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        raise ValueError("%s: too short to be a trace" % file_name)
+    magic, version, record_size, _ = HEADER.unpack_from(data, 0)
+    if magic != b"HKTR" or version != 1 or record_size != RECORD.size:
+        raise ValueError("%s: not a trace written by this version" % file_name)
+
+    search = -1
+    for offset in range(HEADER.size, len(data) - RECORD.size + 1, RECORD.size):
+        time, nodes, value1, value2, move, move_number, score, event, depth = RECORD.unpack_from(data, offset)
+        event = EVENTS[event] if event < len(EVENTS) else "unknown_%d" % event
+        if event == "search_start":
+            search += 1
+        yield dict(search=max(search, 0), time_us=time, nodes=nodes, event=event, depth=depth,
+                   move=move_to_uci(move), move_number=move_number, score=score, value1=value1, value2=value2)
+
+def write_csv(records):
+    columns = ["search", "time_us", "event", "depth", "move", "move_number", "score", "nodes", "value1", "value2"]
+    print(",".join(columns))
+    for r in records:
+        print(",".join(str(r[c]) for c in columns))
+
+def write_chrome(records):
+    events = []
+    iteration_start = {}
+    for r in records:
+        pid = r["search"]
+        names = VALUES.get(r["event"], ("value1", "value2"))
+        args = dict(depth=r["depth"], score=r["score"], nodes=r["nodes"])
+        for name, key in zip(names, ("value1", "value2")):
+            if name:
+                args[name] = r[key]
+        if r["move"]:
+            args["move"] = r["move"]
+
+        if r["event"] == "iteration_start":
+            iteration_start[pid] = r
+        elif r["event"] == "iteration_end" and pid in iteration_start:
+            start = iteration_start.pop(pid)
+            events.append(dict(name="depth %d" % r["depth"], ph="X", pid=pid, tid=0, ts=start["time_us"],
+                               dur=r["time_us"] - start["time_us"], args=args))
+        elif r["event"] == "root_move":
+            # The record is written when the move is done, value1 is how long it took.
+            events.append(dict(name=r["move"], ph="X", pid=pid, tid=1, ts=r["time_us"] - r["value1"],
+                               dur=r["value1"], args=args))
+        else:
+            events.append(dict(name=r["event"], ph="i", s="p", pid=pid, tid=0, ts=r["time_us"], args=args))
+        events.append(dict(name="nodes", ph="C", pid=pid, ts=r["time_us"], args=dict(nodes=r["nodes"])))
+
+    pids = set(e["pid"] for e in events)
+    for pid in sorted(pids):
+        events.append(dict(name="process_name", ph="M", pid=pid, args=dict(name="search %d" % pid)))
+        events.append(dict(name="thread_name", ph="M", pid=pid, tid=0, args=dict(name="iterations")))
+        events.append(dict(name="thread_name", ph="M", pid=pid, tid=1, args=dict(name="root moves")))
+    json.dump(dict(traceEvents=events, displayTimeUnit="ms"), sys.stdout)
+    print()
+
+def main():
+    if len(sys.argv) < 2 or (len(sys.argv) > 2 and sys.argv[2] not in ("csv", "chrome")):
+        print("Usage: ./decode_trace.py <trace file> [csv|chrome]")
+        sys.exit(2)
+
+    try:
+        records = list(read_records(sys.argv[1]))
+    except (IOError, ValueError) as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+    if len(sys.argv) > 2 and sys.argv[2] == "chrome":
+        write_chrome(records)
+    else:
+        write_csv(records)
+
+if __name__ == "__main__":
+    main()
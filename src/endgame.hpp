@@ -29,7 +29,7 @@
 /// @brief Contains information on different kinds of endgames indexed by the material hash key.
 ///
 /// It is safe to do a cut-off inside the search with absolutely drawn endgames, not so with the others. 
-/// Therefore this module is only used inside the evaluation function.
+/// Therefore this module is only used inside the evaluation function, which caches the results in the material hash table.
 class EndgameModule 
 {
 public:
@@ -41,6 +41,11 @@ public:
     /// @return True if the position is drawn, false otherwise. 
     bool drawnEndgame(HashKey materialHashKey) const;
 
+    /// @brief Used for checking if an endgame is drawn according to the rules of chess, i.e. neither side can possibly checkmate.
+    /// @param materialHashKey The material hash key of the position to check.
+    /// @return True if the position is drawn, false otherwise. 
+    bool fideDrawnEndgame(HashKey materialHashKey) const;
+
 private:
     std::unordered_set<HashKey> mFideDrawnEndgames; // Endgames which are drawn according to rules of chess.
     std::unordered_set<HashKey> mOtherDrawnEndgames; // Endgames which cannot be won unless the weak side is actively trying to lose.
@@ -106,4 +111,9 @@ inline bool EndgameModule::drawnEndgame(HashKey materialHashKey) const
     return mFideDrawnEndgames.count(materialHashKey) > 0 || mOtherDrawnEndgames.count(materialHashKey) > 0;
 }
 
+inline bool EndgameModule::fideDrawnEndgame(HashKey materialHashKey) const
+{
+    return mFideDrawnEndgames.count(materialHashKey) > 0;
+}
+
 #endif
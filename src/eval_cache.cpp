@@ -0,0 +1,64 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "eval_cache.hpp"
+#include "bitboards.hpp"
+#include <cmath>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+EvaluationCache::EvaluationCache() :
+mMask(0), mProbes(0), mHits(0)
+{
+    setSize(1);
+}
+
+void EvaluationCache::setSize(size_t sizeInMegaBytes)
+{
+    // If size is not a power of two make it the biggest power of two smaller than size.
+    if (Bitboards::moreThanOneBitSet(sizeInMegaBytes))
+    {
+        sizeInMegaBytes = static_cast<size_t>(std::pow(2, std::floor(log2(sizeInMegaBytes))));
+    }
+
+    const auto oldTableSize = mTable.size();
+    const auto tableSize = ((sizeInMegaBytes * 1024 * 1024) / sizeof(mTable[0]));
+    mTable = decltype(mTable)();
+    try
+    {
+        mTable.resize(tableSize);
+    }
+    catch (const std::bad_alloc&)
+    {
+        mTable.resize(oldTableSize);
+        mMask = (oldTableSize ? oldTableSize - 1 : 0);
+        clear();
+        throw std::runtime_error("not enough memory for a " + std::to_string(sizeInMegaBytes) + " MB evaluation cache, keeping the old size");
+    }
+    mMask = (tableSize ? tableSize - 1 : 0);
+    clear();
+}
+
+void EvaluationCache::clear()
+{
+    if (mTable.empty())
+    {
+        return;
+    }
+    LargePages::zero(mTable.data(), mTable.size() * sizeof(mTable[0]));
+}
@@ -0,0 +1,126 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file eval_cache.hpp
+/// @author Mikko Aarnos
+
+#ifndef EVAL_CACHE_HPP_
+#define EVAL_CACHE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "zobrist.hpp"
+#include "utils/large_pages.hpp"
+
+/// @brief Small hash table for caching the scores given by the evaluation function, indexed by the full hash key.
+///
+/// Transpositions and the static evaluation being needed in both search and quiescence search mean that the same position is often evaluated several times.
+/// Every search thread has its own cache, so no synchronization is needed except for the statistics, which other threads read for reporting.
+/// An entry packs the upper 48 bits of the hash key and the score into a single quadword.
+/// Size 0 disables the cache, probes then always miss. Default size of the cache is 1MB.
+class EvaluationCache
+{
+public:
+    /// @brief Default constructor.
+    EvaluationCache();
+
+    /// @brief Sets the size of the cache.
+    /// @param sizeInMegaBytes The new size in megabytes. Rounded down to a power of two, 0 disables the cache.
+    ///
+    /// Throws std::runtime_error if there is not enough memory. In that case the cache keeps its old size but is cleared.
+    void setSize(size_t sizeInMegaBytes);
+
+    /// @brief Clears the cache.
+    void clear();
+
+    /// @brief Save a score to the cache.
+    /// @param hk The hash key of the position.
+    /// @param score The score given to the position by the evaluation function.
+    void save(HashKey hk, int score);
+
+    /// @brief Get a score from the cache.
+    /// @param hk The hash key of the position.
+    /// @param score On a succesful probe the score is put here.
+    /// @return True on a succesful probe, false otherwise.
+    bool probe(HashKey hk, int& score);
+
+    /// @brief Get the amount of probes done since the last call to resetStatistics.
+    /// @return The amount of probes.
+    uint64_t getProbes() const;
+
+    /// @brief Get the amount of succesful probes since the last call to resetStatistics.
+    /// @return The amount of hits.
+    uint64_t getHits() const;
+
+    /// @brief Resets the probe and hit counters.
+    void resetStatistics();
+
+private:
+    static const uint64_t keyMask = ~0xffffULL;
+
+    std::vector<uint64_t, LargePageAllocator<uint64_t>> mTable;
+    uint64_t mMask;
+    // Only written by the owning thread, so a relaxed load and store is enough.
+    std::atomic<uint64_t> mProbes;
+    std::atomic<uint64_t> mHits;
+};
+
+inline void EvaluationCache::save(HashKey hk, int score)
+{
+    if (!mTable.empty())
+    {
+        mTable[hk & mMask] = (hk & keyMask) | static_cast<uint16_t>(score);
+    }
+}
+
+inline bool EvaluationCache::probe(HashKey hk, int& score)
+{
+    mProbes.store(mProbes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (mTable.empty())
+    {
+        return false;
+    }
+
+    const auto data = mTable[hk & mMask];
+    if ((data ^ hk) & keyMask)
+    {
+        return false;
+    }
+
+    mHits.store(mHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    score = static_cast<int16_t>(data);
+    return true;
+}
+
+inline uint64_t EvaluationCache::getProbes() const
+{
+    return mProbes.load(std::memory_order_relaxed);
+}
+
+inline uint64_t EvaluationCache::getHits() const
+{
+    return mHits.load(std::memory_order_relaxed);
+}
+
+inline void EvaluationCache::resetStatistics()
+{
+    mProbes.store(0, std::memory_order_relaxed);
+    mHits.store(0, std::memory_order_relaxed);
+}
+
+#endif
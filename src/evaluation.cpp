@@ -21,18 +21,47 @@
 #include "square.hpp"
 #include "utils/clamp.hpp"
 
+#if (defined _WIN64 || defined __x86_64__)
+ #ifdef _MSC_VER
+ #include <intrin.h>
+ #endif
+#include <immintrin.h>
+// GCC and clang only allow the intrinsics of instruction sets enabled for the function, MSVC allows them anywhere.
+ #if (defined __clang__ || defined __GNUC__)
+ #define TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+ #define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+ #else
+ #define TARGET_SSE42
+ #define TARGET_AVX2
+ #endif
+#endif
+
+#if (defined TUNING && defined PRECOMPUTED_TABLES)
+#error "the tuner changes the piece-square tables at run time, it cannot be built with precomputed tables"
+#endif
+
+// The evaluation parameters are constants, except when compiled with TUNING. The tuner then changes them at run time, see Evaluation::getParameterTables.
+#ifdef TUNING
+#define TUNABLE
+#else
+#define TUNABLE const
+#endif
+
+// With precomputed tables these are defined in precomputed_tables.cpp instead.
+#ifndef PRECOMPUTED_TABLES
 std::array<std::array<short, 64>, 12> Evaluation::mPieceSquareTableOpening;
 std::array<std::array<short, 64>, 12> Evaluation::mPieceSquareTableEnding;
+#endif
 
-const std::array<short, 6> pieceValuesOpening = {
+TUNABLE std::array<int, 6> pieceValuesOpening = {
     79, 248, 253, 355, 847, 0
 };
 
-const std::array<short, 6> pieceValuesEnding = {
+TUNABLE std::array<int, 6> pieceValuesEnding = {
     127, 275, 292, 526, 939, 0
 };
 
-const std::array<std::array<short, 64>, 6> openingPST = {{
+TUNABLE std::array<std::array<int, 64>, 6> openingPST = {{
     {
         0, 0, 0, 0, 0, 0, 0, 0, -35, -28, -32, -38, -17, -3, -4, -39, -35, -23, -31, -25, -11, -1, -10, -26, -31, -17, -16, -7, 2, 1, -18, -21, -22, -6, -9, 6, 20, 14, -1, -15, 4, -7, 27, 27, 52, 60, 51, 15, 55, 44, 89, 100, 87, 64, -11, -24, 0, 0, 0, 0, 0, 0, 0, 0
     },
@@ -53,7 +82,7 @@ const std::array<std::array<short, 64>, 6> openingPST = {{
     }
 }};
 
-const std::array<std::array<short, 64>, 6> endingPST = {{
+TUNABLE std::array<std::array<int, 64>, 6> endingPST = {{
     {
         0, 0, 0, 0, 0, 0, 0, 0, -12, -3, -10, 0, 4, -9, -13, -20, -19, -8, -17, -16, -16, -19, -14, -22, -11, -3, -21, -29, -24, -19, -10, -20, 9, 0, -6, -26, -21, -15, 1, -5, 42, 44, 11, 7, -7, 10, 31, 20, 56, 71, 62, 14, 52, 17, 16, 42, 0, 0, 0, 0, 0, 0, 0, 0
     },
@@ -74,7 +103,7 @@ const std::array<std::array<short, 64>, 6> endingPST = {{
     }
 }};
 
-const std::array<std::vector<int>, 6> mobilityOpening = {{
+TUNABLE std::array<std::vector<int>, 6> mobilityOpening = {{
     {},
     { -1, 6, 12, 16, 17, 16, 16, 15, 18 },
     { -12, -7, -2, 1, 6, 14, 17, 22, 19, 23, 21, 34, 34, 29 },
@@ -83,7 +112,7 @@ const std::array<std::vector<int>, 6> mobilityOpening = {{
     {}
 }};
 
-const std::array<std::vector<int>, 6> mobilityEnding = {{
+TUNABLE std::array<std::vector<int>, 6> mobilityEnding = {{
     {},
     { -30, 1, 4, 11, 16, 25, 23, 23, 19 },
     { -22, -32, -19, -6, 5, 20, 29, 33, 42, 40, 36, 38, 28, 13 },
@@ -92,68 +121,129 @@ const std::array<std::vector<int>, 6> mobilityEnding = {{
     {}
 }};
 
-const std::array<int, 8> passedBonusOpening = {
+// The mobility tables of all pieces packed into one table, so that the SIMD versions of the mobility evaluation can look up several pieces at once.
+// The opening score is in the lower 16 bits and the ending score in the upper 16 bits, so that adding the packed scores adds both at once.
+// Entry 0 is always zero and used for padding.
+const std::array<int, 6> mobilityTableOffset = {
+    0, 1, 10, 24, 39, 0
+};
+
+std::array<int32_t, 67> packMobilityTable()
+{
+    std::array<int32_t, 67> table = {};
+    for (Piece p = Piece::Knight; p <= Piece::Queen; ++p)
+    {
+        for (size_t i = 0; i < mobilityOpening[p].size(); ++i)
+        {
+            table[mobilityTableOffset[p] + i] = mobilityOpening[p][i] + mobilityEnding[p][i] * 65536;
+        }
+    }
+    return table;
+}
+
+TUNABLE std::array<int32_t, 67> mobilityTable = packMobilityTable();
+
+inline int packedScoreOp(int32_t packed)
+{
+    return static_cast<int16_t>(static_cast<uint32_t>(packed));
+}
+
+inline int packedScoreEd(int32_t packed)
+{
+    return static_cast<int16_t>(static_cast<uint32_t>(packed + 0x8000) >> 16);
+}
+
+TUNABLE std::array<int, 8> passedBonusOpening = {
     0, 4, -19, -8, 19, 48, 58, 0
 };
 
-const std::array<int, 8> passedBonusEnding = {
+TUNABLE std::array<int, 8> passedBonusEnding = {
     0, 4, 17, 32, 51, 67, 90, 0
 };
 
-const std::array<int, 8> doubledPenaltyOpening = {
+TUNABLE std::array<int, 8> doubledPenaltyOpening = {
     36, 9, 2, 23, 18, 20, 0, 26
 };
 
-const std::array<int, 8> doubledPenaltyEnding = {
+TUNABLE std::array<int, 8> doubledPenaltyEnding = {
     46, 25, 31, 24, 21, 19, 29, 44
 };
 
-const std::array<int, 8> isolatedPenaltyOpening = {
+TUNABLE std::array<int, 8> isolatedPenaltyOpening = {
     1, 5, 14, 13, 22, 14, 14, 20
 };
 
-const std::array<int, 8> isolatedPenaltyEnding = {
+TUNABLE std::array<int, 8> isolatedPenaltyEnding = {
     5, 13, 21, 26, 22, 16, 10, 6
 };
 
-const std::array<int, 8> backwardPenaltyOpening = {
+TUNABLE std::array<int, 8> backwardPenaltyOpening = {
     -4, 3, 2, 21, 8, 7, 13, -1
 };
 
-const std::array<int, 8> backwardPenaltyEnding = {
+TUNABLE std::array<int, 8> backwardPenaltyEnding = {
     2, 7, 13, 14, 7, 1, 1, 3
 };
 
-const int bishopPairBonusOpening = 42;
-const int bishopPairBonusEnding = 52;
-const int sideToMoveBonus = 1;
+TUNABLE int bishopPairBonusOpening = 42;
+TUNABLE int bishopPairBonusEnding = 52;
+TUNABLE int sideToMoveBonus = 1;
+TUNABLE int rookOpenFileBonus = 26;
+TUNABLE int rookHalfOpenFileBonus = 13;
 
-const std::array<int, 6> attackWeight = {
+TUNABLE std::array<int, 6> attackWeight = {
     0, 2, 2, 3, 5, 0
 };
 
-const std::array<int, 100> kingSafetyTable = {
+TUNABLE std::array<int, 100> kingSafetyTable = {
     21, 7, 11, 7, 7, 9, 5, 7, 10, 14, 15, 20, 19, 20, 25, 22, 28, 40, 45, 47, 46, 60, 56, 82, 86, 102, 98, 109, 107, 117, 125, 132, 159, 168, 181, 188, 211, 213, 234, 216, 265, 276, 288, 272, 308, 339, 351, 355, 374, 354, 370, 412, 420, 481, 439, 457, 478, 478, 441, 509, 494, 431, 517, 569, 562, 499, 500, 531, 523, 500, 500, 500, 522, 517, 500, 500, 500, 508, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500, 500
 };
 
+// The pawn shelter penalties, added to the attack units of the opponent.
+TUNABLE std::array<int, 8> openFilePenalty = { 6, 5, 4, 4, 4, 4, 5, 6 };
+TUNABLE std::array<int, 8> halfopenFilePenalty = { 5, 4, 3, 3, 3, 3, 4, 5 };
+TUNABLE std::array<int, 8> pawnStormPenalty = { 0, 0, 0, 1, 2, 3, 0, 0 };
+
 void Evaluation::staticInitialize()
 {
+#ifndef PRECOMPUTED_TABLES
     for (Piece p = Piece::Pawn; p <= Piece::King; ++p)
     {
         for (Square sq = Square::A1; sq <= Square::H8; ++sq)
         {
-            mPieceSquareTableOpening[p][sq] = openingPST[p][sq] + pieceValuesOpening[p];
-            mPieceSquareTableEnding[p][sq] = endingPST[p][sq] + pieceValuesEnding[p];
+            mPieceSquareTableOpening[p][sq] = static_cast<short>(openingPST[p][sq] + pieceValuesOpening[p]);
+            mPieceSquareTableEnding[p][sq] = static_cast<short>(endingPST[p][sq] + pieceValuesEnding[p]);
 
-            mPieceSquareTableOpening[p + Color::Black * 6][sq ^ 56] = -(openingPST[p][sq] + pieceValuesOpening[p]);
-            mPieceSquareTableEnding[p + Color::Black * 6][sq ^ 56] = -(endingPST[p][sq] + pieceValuesEnding[p]);
+            mPieceSquareTableOpening[p + Color::Black * 6][sq ^ 56] = static_cast<short>(-(openingPST[p][sq] + pieceValuesOpening[p]));
+            mPieceSquareTableEnding[p + Color::Black * 6][sq ^ 56] = static_cast<short>(-(endingPST[p][sq] + pieceValuesEnding[p]));
         }
     }
+#endif
 }
 
-int Evaluation::evaluate(const Position& pos)
+int Evaluation::evaluateWithNetwork(const Position& pos)
 {
-    return (Bitboards::hardwarePopcntSupported() ? evaluate<true>(pos) : evaluate<false>(pos));
+    // The network has no idea about the endgames which are dead draws, but the material hash table does.
+    const auto& material = probeMaterial(pos);
+    if (!material.mScaleFactors[Color::White] && !material.mScaleFactors[Color::Black])
+    {
+        return 0;
+    }
+
+    return Nnue::evaluate(pos);
+}
+
+int Evaluation::evaluate(const Position& pos, InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case InstructionSet::Avx2:
+        return evaluate<InstructionSet::Avx2>(pos);
+    case InstructionSet::Sse42:
+        return evaluate<InstructionSet::Sse42>(pos);
+    default:
+        return evaluate<InstructionSet::Generic>(pos);
+    }
 }
 
 int interpolateScore(int scoreOp, int scoreEd, int phase)
@@ -161,93 +251,244 @@ int interpolateScore(int scoreOp, int scoreEd, int phase)
     return ((scoreOp * (64 - phase)) + (scoreEd * phase)) / 64;
 }
 
-template <bool hardwarePopcnt> 
+// Get the attacks of the piece of a given type on a given square. With ATTACK_MAPS the position already knows them.
+inline Bitboard pieceAttacks(const Position& pos, Piece piece, Square from, Bitboard occupied)
+{
+#ifdef ATTACK_MAPS
+    return pos.getAttacksFrom(from);
+#else
+    return Bitboards::pieceAttacks(Color::White, piece, from, occupied);
+#endif
+}
+
+template <Evaluation::InstructionSet instructionSet> 
 int Evaluation::evaluate(const Position& pos)
 {
-    if (mEndgameModule.drawnEndgame(pos.getMaterialHashKey()))
+    const auto& material = probeMaterial(pos);
+    if (!material.mScaleFactors[Color::White] && !material.mScaleFactors[Color::Black])
     {
         return 0;
     }
 
     std::array<int, 2> kingSafetyScore;
-    const auto phase = clamp(static_cast<int>(pos.getGamePhase()), 0, 64); // The phase can be negative in some weird cases, guard against that.
+    const int phase = material.mPhase;
+    const auto& pawns = probePawns(pos);
 
-    auto score = mobilityEval<hardwarePopcnt>(pos, kingSafetyScore, phase);
-    score += pawnStructureEval(pos, phase);
-    score += kingSafetyEval(pos, phase, kingSafetyScore);
+    auto score = mobilityEval<instructionSet>(pos, pawns, kingSafetyScore, phase);
+    score += interpolateScore(pawns.mScoreOp, pawns.mScoreEd, phase);
+    score += kingSafetyEval(pos, pawns, phase, kingSafetyScore);
     score += interpolateScore(pos.getPstScoreOp(), pos.getPstScoreEd(), phase);
+    score += material.mImbalance;
+    score = score * material.mScaleFactors[score < 0] / 64;
+
+    score += (pos.getSideToMove() ? -sideToMoveBonus : sideToMoveBonus);
+
+    return (pos.getSideToMove() ? -score : score);
+}
+
+void Evaluation::calculateMaterial(const Position& pos, MaterialHashTable::Entry& entry) const
+{
+    const auto materialHashKey = pos.getMaterialHashKey();
+
+    entry.mHash = materialHashKey;
+    entry.mPhase = static_cast<uint8_t>(clamp(static_cast<int>(pos.getGamePhase()), 0, 64)); // The phase can be negative in some weird cases, guard against that.
 
     // Bishop pair bonus.
+    auto imbalance = 0;
     for (Color c = Color::White; c <= Color::Black; ++c)
     {
         if (pos.getPieceCount(c, Piece::Bishop) == 2)
         {
-            const auto bishopPairBonus = interpolateScore(bishopPairBonusOpening, bishopPairBonusEnding, phase);
-            score += (c ? -bishopPairBonus : bishopPairBonus);
+            const auto bishopPairBonus = interpolateScore(bishopPairBonusOpening, bishopPairBonusEnding, entry.mPhase);
+            imbalance += (c ? -bishopPairBonus : bishopPairBonus);
         }
     }
+    entry.mImbalance = static_cast<int16_t>(imbalance);
 
-    score += (pos.getSideToMove() ? -sideToMoveBonus : sideToMoveBonus);
+    if (mEndgameModule.drawnEndgame(materialHashKey))
+    {
+        entry.mEndgame = mEndgameModule.fideDrawnEndgame(materialHashKey) ? MaterialHashTable::InsufficientMaterial : MaterialHashTable::DrawishEndgame;
+        entry.mScaleFactors.fill(0);
+    }
+    else
+    {
+        entry.mEndgame = MaterialHashTable::NoEndgame;
+        entry.mScaleFactors.fill(64);
+    }
+}
 
-    return (pos.getSideToMove() ? -score : score);
+// The attacks of the pieces of one side, collected for scoring them all at once.
+// The arrays are padded to a multiple of four pieces with pieces which have no attacks, a zero weight and the zero entry of the mobility table.
+struct MobilityBatch
+{
+    alignas(32) std::array<Bitboard, 16> mAttacks;
+    alignas(32) std::array<Bitboard, 16> mXrayAttacks; // The attacks through own sliders, used for king safety.
+    alignas(16) std::array<int32_t, 16> mTableOffsets;
+    alignas(16) std::array<int32_t, 16> mAttackWeights;
+    int mCount;
+};
+
+// Sums the packed mobility scores and the king attack units of the pieces in a batch. 
+// The mobility of a piece is the amount of target squares it attacks, its king attack units the weighted amount of squares in the opponent king zone.
+template <Evaluation::InstructionSet instructionSet>
+void scoreMobility(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits);
+
+template <>
+void scoreMobility<Evaluation::InstructionSet::Generic>(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits)
+{
+    packedScore = 0;
+    attackUnits = 0;
+    for (auto i = 0; i < batch.mCount; ++i)
+    {
+        packedScore += mobilityTable[batch.mTableOffsets[i] + Bitboards::popcnt<false>(batch.mAttacks[i] & targets)];
+        attackUnits += batch.mAttackWeights[i] * Bitboards::popcnt<false>(batch.mXrayAttacks[i] & targets & kingZone);
+    }
+}
+
+#if (defined _WIN64 || defined __x86_64__)
+
+// Two pieces per iteration. SSE has no vector popcount, so the counts come from POPCNT on the two halves of the vector.
+template <>
+TARGET_SSE42 void scoreMobility<Evaluation::InstructionSet::Sse42>(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits)
+{
+    const auto targetVector = _mm_set1_epi64x(static_cast<int64_t>(targets));
+    const auto kingZoneVector = _mm_set1_epi64x(static_cast<int64_t>(targets & kingZone));
+
+    packedScore = 0;
+    attackUnits = 0;
+    for (auto i = 0; i < batch.mCount; i += 2)
+    {
+        const auto mobility = _mm_and_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(&batch.mAttacks[i])), targetVector);
+        const auto kingAttacks = _mm_and_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(&batch.mXrayAttacks[i])), kingZoneVector);
+
+        packedScore += mobilityTable[batch.mTableOffsets[i] + static_cast<int>(_mm_popcnt_u64(static_cast<uint64_t>(_mm_cvtsi128_si64(mobility))))];
+        packedScore += mobilityTable[batch.mTableOffsets[i + 1] + static_cast<int>(_mm_popcnt_u64(static_cast<uint64_t>(_mm_extract_epi64(mobility, 1))))];
+        attackUnits += batch.mAttackWeights[i] * static_cast<int>(_mm_popcnt_u64(static_cast<uint64_t>(_mm_cvtsi128_si64(kingAttacks))));
+        attackUnits += batch.mAttackWeights[i + 1] * static_cast<int>(_mm_popcnt_u64(static_cast<uint64_t>(_mm_extract_epi64(kingAttacks, 1))));
+    }
+}
+
+// Popcount of every 64-bit lane, the lookup table method by Wojciech Mula. The counts end up in the lowest 32 bits of each lane.
+TARGET_AVX2 inline __m256i popcnt256(__m256i v)
+{
+    const auto lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const auto lowNibbles = _mm256_set1_epi8(0x0f);
+    const auto low = _mm256_and_si256(v, lowNibbles);
+    const auto high = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles);
+    const auto bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+// Four pieces per iteration: the intersections, popcounts, table lookups and the multiplication by the attack weights are all done in vectors.
+template <>
+TARGET_AVX2 void scoreMobility<Evaluation::InstructionSet::Avx2>(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits)
+{
+    const auto targetVector = _mm256_set1_epi64x(static_cast<int64_t>(targets));
+    const auto kingZoneVector = _mm256_set1_epi64x(static_cast<int64_t>(targets & kingZone));
+    // Gathers the lowest 32 bits of every 64-bit lane into the lower half of the vector.
+    const auto compress = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    auto scores = _mm_setzero_si128();
+    auto units = _mm_setzero_si128();
+
+    for (auto i = 0; i < batch.mCount; i += 4)
+    {
+        const auto mobility = _mm256_and_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(&batch.mAttacks[i])), targetVector);
+        const auto kingAttacks = _mm256_and_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(&batch.mXrayAttacks[i])), kingZoneVector);
+        const auto mobilityCounts = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(popcnt256(mobility), compress));
+        const auto kingAttackCounts = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(popcnt256(kingAttacks), compress));
+        const auto offsets = _mm_load_si128(reinterpret_cast<const __m128i*>(&batch.mTableOffsets[i]));
+        const auto weights = _mm_load_si128(reinterpret_cast<const __m128i*>(&batch.mAttackWeights[i]));
+
+        scores = _mm_add_epi32(scores, _mm_i32gather_epi32(mobilityTable.data(), _mm_add_epi32(offsets, mobilityCounts), 4));
+        units = _mm_add_epi32(units, _mm_mullo_epi32(weights, kingAttackCounts));
+    }
+
+    // Horizontal sums.
+    scores = _mm_add_epi32(scores, _mm_shuffle_epi32(scores, _MM_SHUFFLE(1, 0, 3, 2)));
+    scores = _mm_add_epi32(scores, _mm_shuffle_epi32(scores, _MM_SHUFFLE(2, 3, 0, 1)));
+    units = _mm_add_epi32(units, _mm_shuffle_epi32(units, _MM_SHUFFLE(1, 0, 3, 2)));
+    units = _mm_add_epi32(units, _mm_shuffle_epi32(units, _MM_SHUFFLE(2, 3, 0, 1)));
+    packedScore = _mm_cvtsi128_si32(scores);
+    attackUnits = _mm_cvtsi128_si32(units);
+}
+
+#else
+
+// Nothing to vectorize with elsewhere, bestInstructionSet never selects these but they have to exist.
+template <>
+void scoreMobility<Evaluation::InstructionSet::Sse42>(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits)
+{
+    scoreMobility<Evaluation::InstructionSet::Generic>(batch, targets, kingZone, packedScore, attackUnits);
+}
+
+template <>
+void scoreMobility<Evaluation::InstructionSet::Avx2>(const MobilityBatch& batch, Bitboard targets, Bitboard kingZone, int32_t& packedScore, int& attackUnits)
+{
+    scoreMobility<Evaluation::InstructionSet::Generic>(batch, targets, kingZone, packedScore, attackUnits);
 }
 
-template <bool hardwarePopcnt> 
-int Evaluation::mobilityEval(const Position& pos, std::array<int, 2>& kingSafetyScore, int phase)
+#endif
+
+inline void addToBatch(MobilityBatch& batch, Piece piece, Bitboard attacks, Bitboard xrayAttacks)
+{
+    batch.mAttacks[batch.mCount] = attacks;
+    batch.mXrayAttacks[batch.mCount] = xrayAttacks;
+    batch.mTableOffsets[batch.mCount] = mobilityTableOffset[piece];
+    batch.mAttackWeights[batch.mCount] = attackWeight[piece];
+    ++batch.mCount;
+}
+
+template <Evaluation::InstructionSet instructionSet> 
+int Evaluation::mobilityEval(const Position& pos, const PawnHashTable::Entry& pawns, std::array<int, 2>& kingSafetyScore, int phase)
 {
     const auto occupied = pos.getOccupiedSquares();
     auto scoreOp = 0, scoreEd = 0;
+    MobilityBatch batch;
 
     for (Color c = Color::White; c <= Color::Black; ++c)
     {
-        const auto targetBitboard = ~pos.getPieces(c);
         const auto opponentKingZone = Bitboards::kingSafetyZone(!c, Bitboards::lsb(pos.getBitboard(!c, Piece::King)));
-        auto scoreOpForColor = 0, scoreEdForColor = 0;
-        auto attackUnits = 0;
+        auto scoreOpForColor = 0;
+        batch.mCount = 0;
 
+        // First collect the attacks of all pieces, then score them all at once.
         auto tempPiece = pos.getBitboard(c, Piece::Knight);
         while (tempPiece)
         {
             const auto from = Bitboards::popLsb(tempPiece);
-            const auto tempMove = Bitboards::knightAttacks(from) & targetBitboard;
-            const auto count = Bitboards::popcnt<hardwarePopcnt>(tempMove);
-            scoreOpForColor += mobilityOpening[Piece::Knight][count];
-            scoreEdForColor += mobilityEnding[Piece::Knight][count];
-            attackUnits += attackWeight[Piece::Knight] * Bitboards::popcnt<hardwarePopcnt>(tempMove & opponentKingZone);
+            const auto attacks = Bitboards::knightAttacks(from);
+            addToBatch(batch, Piece::Knight, attacks, attacks);
         }
 
         tempPiece = pos.getBitboard(c, Piece::Bishop);
         while (tempPiece)
         {
             const auto from = Bitboards::popLsb(tempPiece);
-            auto tempMove = Bitboards::bishopAttacks(from, occupied) & targetBitboard;
-            const auto count = Bitboards::popcnt<hardwarePopcnt>(tempMove);
-            scoreOpForColor += mobilityOpening[Piece::Bishop][count];
-            scoreEdForColor += mobilityEnding[Piece::Bishop][count];
-            tempMove = Bitboards::bishopAttacks(from, occupied ^ pos.getBitboard(c, Piece::Queen)) & targetBitboard;
-            attackUnits += attackWeight[Piece::Bishop] * Bitboards::popcnt<hardwarePopcnt>(tempMove & opponentKingZone);
+            const auto attacks = pieceAttacks(pos, Piece::Bishop, from, occupied);
+            // King attacks are counted through our own queens. The x-ray attacks only differ if a queen actually blocks the bishop.
+            const auto xrayBlockers = pos.getBitboard(c, Piece::Queen);
+            addToBatch(batch, Piece::Bishop, attacks, (attacks & xrayBlockers) ? Bitboards::bishopAttacks(from, occupied ^ xrayBlockers) : attacks);
         }
 
         tempPiece = pos.getBitboard(c, Piece::Rook);
         while (tempPiece)
         {
             const auto from = Bitboards::popLsb(tempPiece);
-            auto tempMove = Bitboards::rookAttacks(from, occupied) & targetBitboard;
-            const auto count = Bitboards::popcnt<hardwarePopcnt>(tempMove);
-            scoreOpForColor += mobilityOpening[Piece::Rook][count];
-            scoreEdForColor += mobilityEnding[Piece::Rook][count];
-            tempMove = Bitboards::rookAttacks(from, occupied ^ pos.getBitboard(c, Piece::Queen) ^ pos.getBitboard(c, Piece::Rook)) & targetBitboard;
-            attackUnits += attackWeight[Piece::Rook] * Bitboards::popcnt<hardwarePopcnt>(tempMove & opponentKingZone);
-
-            if (!(Bitboards::files[file(from)] & pos.getBitboard(c, Piece::Pawn)))
+            const auto attacks = pieceAttacks(pos, Piece::Rook, from, occupied);
+            const auto xrayBlockers = pos.getBitboard(c, Piece::Queen) | pos.getBitboard(c, Piece::Rook);
+            addToBatch(batch, Piece::Rook, attacks, (attacks & xrayBlockers) ? Bitboards::rookAttacks(from, occupied ^ xrayBlockers) : attacks);
+
+            const auto fileMask = 1 << file(from);
+            if (!(pawns.mPawnFiles[c] & fileMask))
             {
-                if (!(Bitboards::files[file(from)] & pos.getBitboard(!c, Piece::Pawn)))
+                if (!(pawns.mPawnFiles[!c] & fileMask))
                 {
-                    scoreOpForColor += 26;
+                    scoreOpForColor += rookOpenFileBonus;
                 }
                 else
                 {
-                    scoreOpForColor += 13;
+                    scoreOpForColor += rookHalfOpenFileBonus;
                 }
             }
         }
@@ -256,14 +497,20 @@ int Evaluation::mobilityEval(const Position& pos, std::array<int, 2>& kingSafety
         while (tempPiece)
         {
             const auto from = Bitboards::popLsb(tempPiece);
-            const auto tempMove = Bitboards::queenAttacks(from, occupied) & targetBitboard;
-            const auto count = Bitboards::popcnt<hardwarePopcnt>(tempMove);
-            scoreOpForColor += mobilityOpening[Piece::Queen][count];
-            scoreEdForColor += mobilityEnding[Piece::Queen][count];
-            attackUnits += attackWeight[Piece::Queen] * Bitboards::popcnt<hardwarePopcnt>(tempMove & opponentKingZone);
+            const auto attacks = pieceAttacks(pos, Piece::Queen, from, occupied);
+            addToBatch(batch, Piece::Queen, attacks, attacks);
         }
-        
-        kingSafetyScore[c] = attackUnits;
+
+        while (batch.mCount & 3)
+        {
+            addToBatch(batch, Piece::Pawn, 0, 0);
+        }
+
+        int32_t packedScore;
+        scoreMobility<instructionSet>(batch, ~pos.getPieces(c), opponentKingZone, packedScore, kingSafetyScore[c]);
+        scoreOpForColor += packedScoreOp(packedScore);
+        const auto scoreEdForColor = packedScoreEd(packedScore);
+
         scoreOp += (c ? -scoreOpForColor : scoreOpForColor);
         scoreEd += (c ? -scoreEdForColor : scoreEdForColor);
     }
@@ -271,14 +518,11 @@ int Evaluation::mobilityEval(const Position& pos, std::array<int, 2>& kingSafety
     return interpolateScore(scoreOp, scoreEd, phase);
 }
 
-int Evaluation::pawnStructureEval(const Position& pos, int phase)
+void Evaluation::calculatePawns(const Position& pos, PawnHashTable::Entry& entry)
 {
     auto scoreOp = 0, scoreEd = 0;
 
-    if (mPawnHashTable.probe(pos.getPawnHashKey(), scoreOp, scoreEd))
-    {
-        return interpolateScore(scoreOp, scoreEd, phase);
-    }
+    entry.mHash = pos.getPawnHashKey();
 
     for (Color c = Color::White; c <= Color::Black; ++c)
     {
@@ -328,48 +572,117 @@ int Evaluation::pawnStructureEval(const Position& pos, int phase)
             }
         }
 
+        entry.mPawnFiles[c] = 0;
+        for (auto f = 0; f < 8; ++f)
+        {
+            entry.mPawnFiles[c] |= ((Bitboards::files[f] & ownPawns) ? 1 << f : 0);
+        }
+
+        // The pawn shelter for every file the king could be on.
+        // If the king is at the edge assume that it is a bit closer to the center.
+        // This prevents all bugs related to the next loop and going off the board.
+        for (auto kingFile = 0; kingFile < 8; ++kingFile)
+        {
+            const auto shelterFile = clamp(kingFile, 1, 6);
+            auto penalty = 0;
+
+            for (auto f = shelterFile - 1; f <= shelterFile + 1; ++f)
+            {
+                const auto own = Bitboards::files[f] & ownPawns;
+                const auto opponent = Bitboards::files[f] & opponentPawns;
+
+                penalty += (own | opponent) ? 0 : openFilePenalty[f];
+                penalty += (!own && opponent) ? halfopenFilePenalty[f] : 0;
+                penalty += opponent ? pawnStormPenalty[c ? rank(Bitboards::msb(opponent)) : 7 - rank(Bitboards::lsb(opponent))] : 0;
+            }
+
+            entry.mShelterPenalty[c][kingFile] = static_cast<uint8_t>(penalty);
+        }
+
         scoreOp += (c == Color::Black ? -scoreOpForColor : scoreOpForColor);
         scoreEd += (c == Color::Black ? -scoreEdForColor : scoreEdForColor);
     }
 
-    mPawnHashTable.save(pos.getPawnHashKey(), scoreOp, scoreEd);
-
-    return interpolateScore(scoreOp, scoreEd, phase);
+    entry.mScoreOp = static_cast<int16_t>(scoreOp);
+    entry.mScoreEd = static_cast<int16_t>(scoreEd);
 }
 
-int evaluatePawnShelter(const Position& pos, Color side)
+int Evaluation::kingSafetyEval(const Position& pos, const PawnHashTable::Entry& pawns, int phase, std::array<int, 2>& kingSafetyScore)
 {
-    static const std::array<int, 8> openFilePenalty = { 6, 5, 4, 4, 4, 4, 5, 6 };
-    static const std::array<int, 8> halfopenFilePenalty = { 5, 4, 3, 3, 3, 3, 4, 5 };
-    static const std::array<int, 8> pawnStormPenalty = { 0, 0, 0, 1, 2, 3, 0, 0 };
-
-    auto penalty = 0;
-    const auto ownPawns = pos.getBitboard(side, Piece::Pawn);
-    const auto enemyPawns = pos.getBitboard(!side, Piece::Pawn);
-    // If the king is at the edge assume that it is a bit closer to the center.
-    // This prevents all bugs related to the next loop and going off the board.
-    const auto kingFile = clamp(file(Bitboards::lsb(pos.getBitboard(side, Piece::King))), 1, 6);
-
-    for (auto f = kingFile - 1; f <= kingFile + 1; ++f)
+    for (Color c = Color::White; c <= Color::Black; ++c)
     {
-        const auto own = Bitboards::files[f] & ownPawns;
-        const auto opponent = Bitboards::files[f] & enemyPawns;
+        kingSafetyScore[!c] += pawns.mShelterPenalty[c][file(Bitboards::lsb(pos.getBitboard(c, Piece::King)))];
+    }
+    kingSafetyScore[Color::White] = std::min(kingSafetyScore[Color::White], 99);
+    kingSafetyScore[Color::Black] = std::min(kingSafetyScore[Color::Black], 99);
 
-        penalty += (own | opponent) ? 0 : openFilePenalty[f];
-        penalty += (!own && opponent) ? halfopenFilePenalty[f] : 0;
-        penalty += opponent ? pawnStormPenalty[side ? rank(Bitboards::msb(opponent)) : 7 - rank(Bitboards::lsb(opponent))] : 0;
+    const auto score = kingSafetyTable[kingSafetyScore[Color::White]] - kingSafetyTable[kingSafetyScore[Color::Black]];
+    return ((score * (64 - phase)) / 64);
+}
+
+#ifdef TUNING
+
+// Pointers to the values of a single array.
+template <class Array>
+std::vector<int*> parameterRow(Array& values)
+{
+    std::vector<int*> row;
+    for (auto& value : values)
+    {
+        row.push_back(&value);
     }
+    return row;
+}
 
-    return penalty;
+// Pointers to the values of an array of arrays, one row per inner array.
+template <class Array>
+std::vector<std::vector<int*>> parameterRows(Array& values)
+{
+    std::vector<std::vector<int*>> rows;
+    for (auto& row : values)
+    {
+        rows.push_back(parameterRow(row));
+    }
+    return rows;
 }
 
-int Evaluation::kingSafetyEval(const Position& pos, int phase, std::array<int, 2>& kingSafetyScore)
+std::vector<Evaluation::ParameterTable> Evaluation::getParameterTables()
 {
-    kingSafetyScore[Color::Black] += evaluatePawnShelter(pos, Color::White);
-    kingSafetyScore[Color::White] += evaluatePawnShelter(pos, Color::Black);
-    kingSafetyScore[Color::White] = std::min(kingSafetyScore[Color::White], 99);
-    kingSafetyScore[Color::Black] = std::min(kingSafetyScore[Color::Black], 99);
+    // The bounds keep the scores inside the 16-bit integers of the hash tables and the attack units inside the king safety table.
+    const auto minimumScore = -2000, maximumScore = 2000;
+
+    return {
+        { "pieceValuesOpening", 1, { parameterRow(pieceValuesOpening) }, 0, maximumScore },
+        { "pieceValuesEnding", 1, { parameterRow(pieceValuesEnding) }, 0, maximumScore },
+        { "openingPST", 2, parameterRows(openingPST), minimumScore, maximumScore },
+        { "endingPST", 2, parameterRows(endingPST), minimumScore, maximumScore },
+        { "mobilityOpening", 2, parameterRows(mobilityOpening), minimumScore, maximumScore },
+        { "mobilityEnding", 2, parameterRows(mobilityEnding), minimumScore, maximumScore },
+        { "passedBonusOpening", 1, { parameterRow(passedBonusOpening) }, minimumScore, maximumScore },
+        { "passedBonusEnding", 1, { parameterRow(passedBonusEnding) }, minimumScore, maximumScore },
+        { "doubledPenaltyOpening", 1, { parameterRow(doubledPenaltyOpening) }, minimumScore, maximumScore },
+        { "doubledPenaltyEnding", 1, { parameterRow(doubledPenaltyEnding) }, minimumScore, maximumScore },
+        { "isolatedPenaltyOpening", 1, { parameterRow(isolatedPenaltyOpening) }, minimumScore, maximumScore },
+        { "isolatedPenaltyEnding", 1, { parameterRow(isolatedPenaltyEnding) }, minimumScore, maximumScore },
+        { "backwardPenaltyOpening", 1, { parameterRow(backwardPenaltyOpening) }, minimumScore, maximumScore },
+        { "backwardPenaltyEnding", 1, { parameterRow(backwardPenaltyEnding) }, minimumScore, maximumScore },
+        { "bishopPairBonusOpening", 0, { { &bishopPairBonusOpening } }, minimumScore, maximumScore },
+        { "bishopPairBonusEnding", 0, { { &bishopPairBonusEnding } }, minimumScore, maximumScore },
+        { "sideToMoveBonus", 0, { { &sideToMoveBonus } }, minimumScore, maximumScore },
+        { "rookOpenFileBonus", 0, { { &rookOpenFileBonus } }, minimumScore, maximumScore },
+        { "rookHalfOpenFileBonus", 0, { { &rookHalfOpenFileBonus } }, minimumScore, maximumScore },
+        { "attackWeight", 1, { parameterRow(attackWeight) }, 0, 10 },
+        { "kingSafetyTable", 1, { parameterRow(kingSafetyTable) }, minimumScore, maximumScore },
+        { "openFilePenalty", 1, { parameterRow(openFilePenalty) }, 0, 10 },
+        { "halfopenFilePenalty", 1, { parameterRow(halfopenFilePenalty) }, 0, 10 },
+        { "pawnStormPenalty", 1, { parameterRow(pawnStormPenalty) }, 0, 10 }
+    };
+}
 
-    const auto score = kingSafetyTable[kingSafetyScore[Color::White]] - kingSafetyTable[kingSafetyScore[Color::Black]];
-    return ((score * (64 - phase)) / 64);
+void Evaluation::parametersChanged()
+{
+    staticInitialize();
+    mobilityTable = packMobilityTable();
 }
+
+#endif
@@ -22,30 +22,100 @@
 #define EVALUATION_HPP_
 
 #include <array>
+#include <string>
+#include <vector>
 #include "position.hpp"
 #include "zobrist.hpp"
 #include "endgame.hpp"
+#include "mht.hpp"
 #include "pht.hpp"
+#include "nnue.hpp"
+#include "precomputed_tables.hpp"
 
 /// @brief The evaluation function.
 class Evaluation
 {
 public:
+    /// @brief The instruction sets the mobility evaluation has been written for.
+    ///
+    /// Generic works everywhere, Sse42 needs SSE4.2 and hardware POPCNT, Avx2 processes four pieces at a time with AVX2.
+    /// All of them give exactly the same scores.
+    enum class InstructionSet
+    {
+        Generic, Sse42, Avx2
+    };
+
     /// @brief Initializes the class, must be called before using any other methods.
     static void staticInitialize();
 
-    /// @brief Evaluates a given position.
+#ifdef TUNING
+    /// @brief A table of evaluation parameters the tuner can change.
+    struct ParameterTable
+    {
+        std::string mName; ///< The name of the table in evaluation.cpp.
+        int mDimensions; ///< 0 for a single value, 1 or 2 for arrays.
+        std::vector<std::vector<int*>> mRows; ///< The parameters. Single values and one-dimensional arrays have a single row.
+        int mMinimum; ///< The smallest value a parameter of the table may have.
+        int mMaximum; ///< The largest value a parameter of the table may have.
+    };
+
+    /// @brief Get all tables of evaluation parameters. Only available when compiled with TUNING.
+    /// @return The tables, in the order they are in evaluation.cpp.
+    static std::vector<ParameterTable> getParameterTables();
+
+    /// @brief Recalculates everything derived from the parameters, must be called after changing them. Only available when compiled with TUNING.
+    ///
+    /// Positions created before the call still have the old piece-square table scores,
+    /// and the material and pawn hash tables of every Evaluation object have to be cleared as well.
+    static void parametersChanged();
+#endif
+
+    /// @brief Checks whether the processor we are running on supports a given instruction set.
+    /// @param instructionSet The instruction set.
+    /// @return True if it is supported, false otherwise.
+    static bool instructionSetSupported(InstructionSet instructionSet);
+
+    /// @brief Gets the fastest instruction set supported by the processor we are running on.
+    ///
+    /// AVX2 is supported by more processors than it is faster on, see evalbench, so SSE4.2 is preferred when both are available.
+    /// @return The instruction set.
+    static InstructionSet bestInstructionSet();
+
+    /// @brief Evaluates a given position, with the neural network if it is active.
     /// @param pos The position.
     /// @return The heuristic score given to the position.
     int evaluate(const Position& pos);
 
+    /// @brief Evaluates a given position using a given instruction set. Used for benchmarking the instruction sets against each other.
+    /// @param pos The position.
+    /// @param instructionSet The instruction set, must be supported by the processor.
+    /// @return The heuristic score given to the position.
+    int evaluate(const Position& pos, InstructionSet instructionSet);
+
+    /// @brief Get the information the evaluation function derives from the material of a given position.
+    /// @param pos The position.
+    /// @return The material hash table entry of the position, calculated on the spot if it wasn't in the table already.
+    const MaterialHashTable::Entry& probeMaterial(const Position& pos);
+
+    /// @brief Get the information the evaluation function derives from the pawns of a given position.
+    /// @param pos The position.
+    /// @return The pawn hash table entry of the position, calculated on the spot if it wasn't in the table already.
+    const PawnHashTable::Entry& probePawns(const Position& pos);
+
     /// @brief Clears the pawn hash table used by the evalation function.
     void clearPawnHashTable();
 
+    /// @brief Clears the material hash table used by the evalation function.
+    void clearMaterialHashTable();
+
     /// @brief Sets the size of the pawn hash table used by the evaluation function.
     /// @param sizeInMegaBytes The new size in megabytes.
     void setPawnHashTableSize(size_t sizeInMegaBytes);
 
+    /// @brief Get the pawn hash table used by the evaluation function, mainly for reading its statistics.
+    /// @return The pawn hash table.
+    PawnHashTable& getPawnHashTable();
+
     /// @brief Get the opening PST score of a given piece on a given square.
     /// @param p The piece.
     /// @param sq The square.
@@ -59,22 +129,30 @@ public:
     static short getPieceSquareTableEd(Piece p, Square sq);
 
 private:
+    friend class TableGenerator;
+
     EndgameModule mEndgameModule;
+    MaterialHashTable mMaterialHashTable;
     PawnHashTable mPawnHashTable;
 
     // These two have to be annoyingly static, as we use them in position.cpp to incrementally update the PST eval.
-    static std::array<std::array<short, 64>, 12> mPieceSquareTableOpening;
-    static std::array<std::array<short, 64>, 12> mPieceSquareTableEnding;
+    static PRECOMPUTED_TABLE std::array<std::array<short, 64>, 12> mPieceSquareTableOpening;
+    static PRECOMPUTED_TABLE std::array<std::array<short, 64>, 12> mPieceSquareTableEnding;
 
-    template <bool hardwarePopcnt> 
+    template <InstructionSet instructionSet> 
     int evaluate(const Position& pos);
 
-    template <bool hardwarePopcnt> 
-    int mobilityEval(const Position& pos, std::array<int, 2>& kingSafetyScore, int phase);
+    int evaluateWithNetwork(const Position& pos);
+
+    void calculateMaterial(const Position& pos, MaterialHashTable::Entry& entry) const;
+
+    static void calculatePawns(const Position& pos, PawnHashTable::Entry& entry);
+
+    template <InstructionSet instructionSet> 
+    int mobilityEval(const Position& pos, const PawnHashTable::Entry& pawns, std::array<int, 2>& kingSafetyScore, int phase);
 
-    int pawnStructureEval(const Position& pos, int phase);
     // Static to get around a static analysis tool warning.
-    static int kingSafetyEval(const Position& pos, int phase, std::array<int, 2>& kingSafetyScore);
+    static int kingSafetyEval(const Position& pos, const PawnHashTable::Entry& pawns, int phase, std::array<int, 2>& kingSafetyScore);
 };
 
 inline void Evaluation::clearPawnHashTable()
@@ -82,11 +160,64 @@ inline void Evaluation::clearPawnHashTable()
     mPawnHashTable.clear();
 }
 
+inline void Evaluation::clearMaterialHashTable()
+{
+    mMaterialHashTable.clear();
+}
+
 inline void Evaluation::setPawnHashTableSize(size_t sizeInMegaBytes)
 {
     mPawnHashTable.setSize(sizeInMegaBytes);
 }
 
+inline bool Evaluation::instructionSetSupported(InstructionSet instructionSet)
+{
+    return (instructionSet == InstructionSet::Avx2 ? Bitboards::avx2Supported()
+          : instructionSet == InstructionSet::Sse42 ? Bitboards::sse42Supported() && Bitboards::hardwarePopcntSupported()
+          : true);
+}
+
+inline Evaluation::InstructionSet Evaluation::bestInstructionSet()
+{
+    return (instructionSetSupported(InstructionSet::Sse42) ? InstructionSet::Sse42 
+          : instructionSetSupported(InstructionSet::Avx2) ? InstructionSet::Avx2 
+          : InstructionSet::Generic);
+}
+
+inline int Evaluation::evaluate(const Position& pos)
+{
+    return (Nnue::isActive() ? evaluateWithNetwork(pos) : evaluate(pos, bestInstructionSet()));
+}
+
+inline PawnHashTable& Evaluation::getPawnHashTable()
+{
+    return mPawnHashTable;
+}
+
+inline const PawnHashTable::Entry& Evaluation::probePawns(const Position& pos)
+{
+    auto& entry = mPawnHashTable.getEntry(pos.getPawnHashKey());
+
+    if (entry.mHash != pos.getPawnHashKey())
+    {
+        calculatePawns(pos, entry);
+    }
+
+    return entry;
+}
+
+inline const MaterialHashTable::Entry& Evaluation::probeMaterial(const Position& pos)
+{
+    auto& entry = mMaterialHashTable.getEntry(pos.getMaterialHashKey());
+
+    if (entry.mHash != pos.getMaterialHashKey())
+    {
+        calculateMaterial(pos, entry);
+    }
+
+    return entry;
+}
+
 inline short Evaluation::getPieceSquareTableOp(Piece p, Square sq)
 {
     return mPieceSquareTableOpening[p][sq];
@@ -16,6 +16,8 @@
 */
 
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <thread>
 #include <algorithm>
 #include "bitboards.hpp"
@@ -24,7 +26,7 @@
 #include "uci.hpp"
 #include "syzygy/tbprobe.hpp"
 
-int main() 
+int main(int argc, char* argv[])
 {
     std::cout << "Hakkapeliitta 3.0 (C) 2013-2015 Mikko Aarnos" << std::endl;
     std::cout << "Detected " << std::max(1u, std::thread::hardware_concurrency()) << " CPU core(s)" << std::endl;
@@ -37,9 +39,32 @@ int main()
     {
         std::cout << "Detected hardware POPCNT" << std::endl;
     }
+    if (Bitboards::bmi2Supported())
+    {
+        std::cout << "Detected BMI2" << std::endl;
+    }
+#ifdef USE_PEXT
+    if (!Bitboards::bmi2Supported())
+    {
+        std::cout << "This build uses PEXT for slider attacks, which needs BMI2" << std::endl;
+        return 1;
+    }
+#endif
 
     UCI uci;
 
+    // "Hakkapeliitta bench [hash size in MB] [threads] [depth] [expected node count]" runs the search benchmark and exits without reading anything from stdin.
+    if (argc > 1 && std::string(argv[1]) == "bench")
+    {
+        std::string arguments;
+        for (auto i = 2; i < argc; ++i)
+        {
+            arguments += std::string(argv[i]) + " ";
+        }
+        std::istringstream iss(arguments);
+        return uci.runBenchmark(iss);
+    }
+
     uci.mainLoop();
 
     return 0;
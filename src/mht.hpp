@@ -0,0 +1,77 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file mht.hpp
+/// @author Mikko Aarnos
+
+#ifndef MHT_HPP_
+#define MHT_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "zobrist.hpp"
+#include "utils/large_pages.hpp"
+
+/// @brief Hash table for caching everything the evaluation function derives from the material alone.
+///
+/// Indexed by the material hash key. A search only reaches a few hundred different material configurations, so the table is small and fixed-size.
+/// The entries are filled by the evaluation function, this only stores them.
+class MaterialHashTable
+{
+public:
+    /// @brief Endgames which the evaluation function handles differently from the rest. 
+    enum Endgame : uint8_t
+    {
+        NoEndgame = 0, ///< Nothing special.
+        InsufficientMaterial = 1, ///< Drawn according to the rules of chess.
+        DrawishEndgame = 2 ///< Cannot be won unless the weak side is actively trying to lose.
+    };
+
+    /// @brief A single entry, four of them fit into a cache line.
+    struct Entry
+    {
+        HashKey mHash; ///< The material hash key of the position the entry is for.
+        int16_t mImbalance; ///< The material imbalance score from the point of view of white, already interpolated by the game phase.
+        uint8_t mPhase; ///< The game phase clamped to 0 (opening) to 64 (ending).
+        Endgame mEndgame; ///< The kind of endgame.
+        std::array<uint8_t, 2> mScaleFactors; ///< The score is multiplied by mScaleFactors[stronger side] / 64. 0 means a draw.
+    };
+
+    /// @brief Default constructor.
+    MaterialHashTable();
+
+    /// @brief Clears the material hash table.
+    void clear();
+
+    /// @brief Get the entry a given material hash key maps to.
+    /// @param mhk The material hash key.
+    /// @return The entry. It only holds information for mhk if its mHash equals mhk, otherwise the caller should fill it.
+    Entry& getEntry(HashKey mhk);
+
+private:
+    static const size_t tableSize = 8192;
+
+    std::vector<Entry, LargePageAllocator<Entry>> mTable;
+};
+
+inline MaterialHashTable::Entry& MaterialHashTable::getEntry(HashKey mhk)
+{
+    return mTable[mhk & (tableSize - 1)];
+}
+
+#endif
@@ -0,0 +1,418 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmarks of the primitives the search spends most of its time in, run over a corpus of realistic positions.
+// The corpus is the positions of the bench command and every position one ply from them.
+// The results are written to stdout as JSON in the format Google Benchmark uses, compare two runs with compare_microbench.py.
+//
+// Usage: microbench [minimum time per benchmark in ms] [syzygy path]
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "benchmark.hpp"
+#include "bitboards.hpp"
+#include "evaluation.hpp"
+#include "history.hpp"
+#include "movegen.hpp"
+#include "movesort.hpp"
+#include "pht.hpp"
+#include "position.hpp"
+#include "tt.hpp"
+#include "zobrist.hpp"
+#include "syzygy/tbprobe.hpp"
+#include "utils/stopwatch.hpp"
+
+class MicroBenchmark
+{
+public:
+    MicroBenchmark(uint64_t minimumTime) :
+    mMinimumTime(minimumTime), mSink(0)
+    {
+    }
+
+    // Calls fn until the minimum time has passed, five times, and records the median time per operation.
+    // fn goes through the corpus once and returns the amount of operations it did, adding the results of the operations to the checksum.
+    // The checksum is only there so that the compiler cannot optimize the operations away.
+    template <class Fn>
+    void run(const std::string& name, Fn fn)
+    {
+        const auto repetitions = 5;
+        std::vector<Measurement> measurements;
+        uint64_t checksum = 0;
+
+        fn(checksum);
+        for (auto i = 0; i < repetitions; ++i)
+        {
+            Measurement measurement = {};
+            Stopwatch sw;
+            const auto cpuStart = std::clock();
+
+            sw.start();
+            while (sw.elapsed<std::chrono::milliseconds>() < mMinimumTime / repetitions)
+            {
+                measurement.mOperations += fn(checksum);
+            }
+            sw.stop();
+            measurement.mRealTime = static_cast<double>(sw.elapsed<std::chrono::nanoseconds>()) / measurement.mOperations;
+            measurement.mCpuTime = (std::clock() - cpuStart) * (1000000000.0 / CLOCKS_PER_SEC) / measurement.mOperations;
+            measurements.push_back(measurement);
+        }
+        mSink += checksum;
+
+        std::sort(measurements.begin(), measurements.end(), [](const Measurement& a, const Measurement& b)
+        {
+            return a.mRealTime < b.mRealTime;
+        });
+        mResults.emplace_back(name, measurements[repetitions / 2]);
+        std::cerr << name << ": " << measurements[repetitions / 2].mRealTime << " ns" << std::endl;
+    }
+
+    void write(std::ostream& out, const std::string& executable, size_t positions) const
+    {
+        char date[64];
+        const auto now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << "{\n"
+            << "  \"context\": {\n"
+            << "    \"date\": \"" << date << "\",\n"
+            << "    \"executable\": \"" << executable << "\",\n"
+            << "    \"num_cpus\": " << std::max(1u, std::thread::hardware_concurrency()) << ",\n"
+            << "    \"build\": \"" << buildFlags() << "\",\n"
+            << "    \"positions\": " << positions << "\n"
+            << "  },\n"
+            << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < mResults.size(); ++i)
+        {
+            const auto& result = mResults[i].second;
+            out << "    {\n"
+                << "      \"name\": \"" << mResults[i].first << "\",\n"
+                << "      \"iterations\": " << result.mOperations << ",\n"
+                << "      \"real_time\": " << result.mRealTime << ",\n"
+                << "      \"cpu_time\": " << result.mCpuTime << ",\n"
+                << "      \"time_unit\": \"ns\"\n"
+                << "    }" << (i + 1 < mResults.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n"
+            << "}" << std::endl;
+    }
+
+private:
+    struct Measurement
+    {
+        uint64_t mOperations;
+        double mRealTime;
+        double mCpuTime;
+    };
+
+    uint64_t mMinimumTime;
+    std::vector<std::pair<std::string, Measurement>> mResults;
+    volatile uint64_t mSink;
+
+    // The compile-time options affecting the speed of the primitives, so that runs of different builds can be told apart.
+    static std::string buildFlags()
+    {
+        std::string flags;
+#ifdef USE_PEXT
+        flags += " PEXT";
+#endif
+#ifdef MAKE_UNMAKE
+        flags += " MAKE_UNMAKE";
+#endif
+#ifdef ATTACK_MAPS
+        flags += " ATTACK_MAPS";
+#endif
+#ifdef NNUE
+        flags += " NNUE";
+#endif
+#ifndef NDEBUG
+        flags += " DEBUG";
+#endif
+        return flags.empty() ? "default" : flags.substr(1);
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    Bitboards::staticInitialize();
+    Zobrist::staticInitialize();
+    Evaluation::staticInitialize();
+
+    uint64_t minimumTime = 1000;
+    if (argc > 1 && !(std::istringstream(argv[1]) >> minimumTime))
+    {
+        std::cerr << "Usage: microbench [minimum time per benchmark in ms] [syzygy path]" << std::endl;
+        return 1;
+    }
+    if (argc > 2)
+    {
+        Syzygy::initialize(argv[2]);
+    }
+
+    const auto positions = Benchmark::getSearchBenchmarkPositions(1);
+    std::vector<MoveList> legalMoves(positions.size()), pseudoLegalMoves(positions.size()), captures(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        MoveGen::generateLegalMoves(positions[i], legalMoves[i]);
+        if (!positions[i].inCheck())
+        {
+            MoveGen::generatePseudoLegalMoves(positions[i], pseudoLegalMoves[i]);
+            MoveGen::generatePseudoLegalCaptures(positions[i], captures[i], true);
+        }
+    }
+
+    MicroBenchmark bench(minimumTime);
+
+    bench.run("Position::makeMove/copy", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            for (auto j = 0; j < legalMoves[i].size(); ++j)
+            {
+                Position newPos(positions[i]);
+                newPos.makeMove(legalMoves[i].getMove(j));
+                checksum += newPos.getHashKey();
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("Position::makeMove/unmake", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            Position pos(positions[i]);
+            Position::UndoInfo undo;
+            for (auto j = 0; j < legalMoves[i].size(); ++j)
+            {
+                pos.makeMove(legalMoves[i].getMove(j), undo);
+                checksum += pos.getHashKey();
+                pos.unmakeMove(legalMoves[i].getMove(j), undo);
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("Position::SEE", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            for (auto j = 0; j < captures[i].size(); ++j)
+            {
+                checksum += positions[i].SEE(captures[i].getMove(j));
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("Position::givesCheck", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            for (auto j = 0; j < legalMoves[i].size(); ++j)
+            {
+                checksum += positions[i].givesCheck(legalMoves[i].getMove(j));
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    // Position::legal doesn't work when in check, so positions in check have no pseudo-legal moves here.
+    bench.run("Position::legal", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            for (auto j = 0; j < pseudoLegalMoves[i].size(); ++j)
+            {
+                checksum += positions[i].legal(pseudoLegalMoves[i].getMove(j), false);
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("MoveGen::generateLegalMoves", [&](uint64_t& checksum)
+    {
+        MoveList moveList;
+        for (auto& pos : positions)
+        {
+            moveList.clear();
+            MoveGen::generateLegalMoves(pos, moveList);
+            checksum += moveList.size();
+        }
+        return static_cast<uint64_t>(positions.size());
+    });
+
+    bench.run("MoveGen::generatePseudoLegalMoves", [&](uint64_t& checksum)
+    {
+        MoveList moveList;
+        uint64_t operations = 0;
+        for (auto& pos : positions)
+        {
+            if (!pos.inCheck())
+            {
+                moveList.clear();
+                MoveGen::generatePseudoLegalMoves(pos, moveList);
+                checksum += moveList.size();
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("MoveGen::generatePseudoLegalCaptures", [&](uint64_t& checksum)
+    {
+        MoveList moveList;
+        uint64_t operations = 0;
+        for (auto& pos : positions)
+        {
+            if (!pos.inCheck())
+            {
+                moveList.clear();
+                MoveGen::generatePseudoLegalCaptures(pos, moveList, false);
+                checksum += moveList.size();
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    bench.run("MoveGen::generateLegalEvasions", [&](uint64_t& checksum)
+    {
+        MoveList moveList;
+        uint64_t operations = 0;
+        for (auto& pos : positions)
+        {
+            if (pos.inCheck())
+            {
+                moveList.clear();
+                MoveGen::generateLegalEvasions(pos, moveList);
+                checksum += moveList.size();
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    // The pawn hash table is warm after the first call, as in the search where nearly all probes hit.
+    std::unique_ptr<Evaluation> evaluation(new Evaluation());
+    bench.run("Evaluation::evaluate", [&](uint64_t& checksum)
+    {
+        for (auto& pos : positions)
+        {
+            checksum += evaluation->evaluate(pos);
+        }
+        return static_cast<uint64_t>(positions.size());
+    });
+
+    TranspositionTable transpositionTable;
+    transpositionTable.setSize(16);
+    bench.run("TranspositionTable::save", [&](uint64_t&)
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            const auto move = (legalMoves[i].empty() ? Move() : legalMoves[i].getMove(0));
+            transpositionTable.save(positions[i].getHashKey(), move, 0, 0, 10, TranspositionTable::Flags::ExactScore);
+        }
+        return static_cast<uint64_t>(positions.size());
+    });
+
+    bench.run("TranspositionTable::probe", [&](uint64_t& checksum)
+    {
+        TranspositionTable::TranspositionTableEntry ttEntry;
+        for (auto& pos : positions)
+        {
+            checksum += transpositionTable.probe(pos.getHashKey(), ttEntry);
+        }
+        return static_cast<uint64_t>(positions.size());
+    });
+
+    PawnHashTable pawnHashTable;
+    pawnHashTable.setSize(4);
+    bench.run("PawnHashTable::getEntry", [&](uint64_t& checksum)
+    {
+        for (auto& pos : positions)
+        {
+            auto& entry = pawnHashTable.getEntry(pos.getPawnHashKey());
+            checksum += entry.mScoreOp;
+            entry.mHash = pos.getPawnHashKey();
+        }
+        return static_cast<uint64_t>(positions.size());
+    });
+
+    std::unique_ptr<HistoryTable> historyTable(new HistoryTable());
+    bench.run("MoveSort::next", [&](uint64_t& checksum)
+    {
+        uint64_t operations = 0;
+        for (auto& pos : positions)
+        {
+            MoveSort ms(pos, *historyTable, Move(), Move(), Move(), Move(), pos.inCheck());
+            for (auto move = ms.next(); !move.empty(); move = ms.next())
+            {
+                checksum += move.getRawMove();
+                ++operations;
+            }
+        }
+        return operations;
+    });
+
+    // Probing needs positions with few enough pieces and no castling rights, without tablebases the benchmark is skipped.
+    std::vector<Position> tablebasePositions;
+    for (auto& pos : positions)
+    {
+        if (Syzygy::maxCardinality > 0 && !pos.getCastlingRights() && Bitboards::popcnt<false>(pos.getOccupiedSquares()) <= Syzygy::maxCardinality)
+        {
+            tablebasePositions.push_back(pos);
+        }
+    }
+    if (!tablebasePositions.empty())
+    {
+        bench.run("Syzygy::probeWdl", [&](uint64_t& checksum)
+        {
+            for (auto& pos : tablebasePositions)
+            {
+                auto success = 0;
+                checksum += Syzygy::probeWdl(pos, success) + success;
+            }
+            return static_cast<uint64_t>(tablebasePositions.size());
+        });
+    }
+    else
+    {
+        std::cerr << "Syzygy::probeWdl: skipped, no tablebases or no positions with few enough pieces" << std::endl;
+    }
+
+    bench.write(std::cout, argv[0], positions.size());
+
+    return 0;
+}
@@ -501,3 +501,255 @@ void MoveGen::generatePseudoLegalCaptures(const Position& pos, MoveList& moveLis
     }
 }
 
+
+namespace
+{
+    // Receives legal moves from generateLegal and puts them into a movelist.
+    class MoveListSink
+    {
+    public:
+        MoveListSink(MoveList& moveList) : mMoveList(moveList)
+        {
+        }
+
+        void addMove(Square from, Square to, Piece flags)
+        {
+            mMoveList.emplace_back(from, to, flags);
+        }
+
+        void addPieceMoves(Bitboard mask, Square from)
+        {
+            addPieceMovesFromMask(mMoveList, mask, from);
+        }
+
+        void addPawnSingleMoves(Bitboard mask, Color side)
+        {
+            addPawnSingleMovesFromMask(mMoveList, mask, true, side);
+        }
+
+        void addPawnDoubleMoves(Bitboard mask, Color side)
+        {
+            addPawnDoubleMovesFromMask(mMoveList, mask, side);
+        }
+
+        template <bool rightCaptures>
+        void addPawnCaptures(Bitboard mask, Color side)
+        {
+            addPawnCapturesFromMask<rightCaptures>(mMoveList, mask, Square::NoSquare, true, side);
+        }
+
+    private:
+        MoveList& mMoveList;
+    };
+
+    // Receives legal moves from generateLegal and only counts them. A promotion counts as four moves.
+    template <bool hardwarePopcnt>
+    class MoveCountSink
+    {
+    public:
+        MoveCountSink() : mCount(0)
+        {
+        }
+
+        void addMove(Square, Square, Piece)
+        {
+            ++mCount;
+        }
+
+        void addPieceMoves(Bitboard mask, Square)
+        {
+            mCount += Bitboards::popcnt<hardwarePopcnt>(mask);
+        }
+
+        void addPawnSingleMoves(Bitboard mask, Color)
+        {
+            addPawnMoves(mask);
+        }
+
+        void addPawnDoubleMoves(Bitboard mask, Color)
+        {
+            mCount += Bitboards::popcnt<hardwarePopcnt>(mask);
+        }
+
+        template <bool rightCaptures>
+        void addPawnCaptures(Bitboard mask, Color)
+        {
+            addPawnMoves(mask);
+        }
+
+        int getCount() const
+        {
+            return mCount;
+        }
+
+    private:
+        int mCount;
+
+        void addPawnMoves(Bitboard mask)
+        {
+            const auto promotions = mask & (Bitboards::ranks[0] | Bitboards::ranks[7]);
+            mCount += Bitboards::popcnt<hardwarePopcnt>(mask ^ promotions) + 4 * Bitboards::popcnt<hardwarePopcnt>(promotions);
+        }
+    };
+
+    // Pawn pushes and captures of the given pawns. The targets are limited to allowed, which is how checks and pins are taken into account.
+    template <class Sink>
+    void generateLegalPawnMoves(Sink& sink, Bitboard pawns, Bitboard freeSquares, Bitboard enemyPieces, Bitboard allowed, Color side)
+    {
+        auto tempMove = (side ? pawns >> 8 : pawns << 8) & freeSquares;
+        sink.addPawnSingleMoves(tempMove & allowed, side);
+
+        tempMove = (side ? (tempMove & Bitboards::ranks[5]) >> 8 : (tempMove & Bitboards::ranks[2]) << 8) & freeSquares;
+        sink.addPawnDoubleMoves(tempMove & allowed, side);
+
+        tempMove = (side ? pawns >> 9 : pawns << 7) & 0x7F7F7F7F7F7F7F7F & enemyPieces;
+        sink.template addPawnCaptures<false>(tempMove & allowed, side);
+
+        tempMove = (side ? pawns >> 7 : pawns << 9) & 0xFEFEFEFEFEFEFEFE & enemyPieces;
+        sink.template addPawnCaptures<true>(tempMove & allowed, side);
+    }
+
+    template <class Sink>
+    void generateLegal(const Position& pos, Sink& sink)
+    {
+        const auto side = pos.getSideToMove();
+        const auto occupied = pos.getOccupiedSquares();
+        const auto freeSquares = ~occupied;
+        const auto ownPieces = pos.getPieces(side);
+        const auto enemyPieces = pos.getPieces(!side);
+        const auto kingLocation = Bitboards::lsb(pos.getBitboard(side, Piece::King));
+
+        // King moves. The king must not be counted as a blocker, otherwise it could step back along the line of a slider.
+        auto tempMove = Bitboards::kingAttacks(kingLocation) & ~ownPieces;
+        while (tempMove)
+        {
+            const auto to = Bitboards::popLsb(tempMove);
+            if (!pos.isAttacked(to, !side, occupied ^ Bitboards::bit(kingLocation)))
+            {
+                sink.addMove(kingLocation, to, Piece::Empty);
+            }
+        }
+
+        const auto checkers = (Bitboards::rookAttacks(kingLocation, occupied) & pos.getRooksAndQueens(!side))
+                            | (Bitboards::bishopAttacks(kingLocation, occupied) & pos.getBishopsAndQueens(!side))
+                            | (Bitboards::knightAttacks(kingLocation) & pos.getBitboard(!side, Piece::Knight))
+                            | (Bitboards::pawnAttacks(side, kingLocation) & pos.getBitboard(!side, Piece::Pawn));
+        // In double check only the king can move.
+        if (Bitboards::moreThanOneBitSet(checkers))
+        {
+            return;
+        }
+
+        // The squares other pieces can move to. When in check they must capture the checker or block it.
+        const auto checkMask = checkers ? Bitboards::squaresBetween(kingLocation, Bitboards::lsb(checkers)) | checkers : ~0ULL;
+        const auto targetBitboard = ~ownPieces & checkMask;
+        const auto pinned = pos.getPinnedPieces();
+
+        // Pawn moves. Unpinned pawns can be done all at once, pinned ones one at a time along their pin.
+        generateLegalPawnMoves(sink, pos.getBitboard(side, Piece::Pawn) & ~pinned, freeSquares, enemyPieces, checkMask, side);
+        auto tempPiece = pos.getBitboard(side, Piece::Pawn) & pinned;
+        while (tempPiece)
+        {
+            const auto from = Bitboards::popLsb(tempPiece);
+            generateLegalPawnMoves(sink, Bitboards::bit(from), freeSquares, enemyPieces, 
+                                   checkMask & Bitboards::lineFormedBySquares(kingLocation, from), side);
+        }
+
+        // En passant. Rare enough that we simply check whether the king is attacked after the capture.
+        // That also takes care of the case where both pawns are between the king and an enemy rook on the same rank.
+        const auto ep = pos.getEnPassantSquare();
+        if (ep != Square::NoSquare)
+        {
+            const auto captureSquare = ep ^ 8;
+            tempPiece = Bitboards::pawnAttacks(!side, ep) & pos.getBitboard(side, Piece::Pawn);
+            // A pawn or knight giving check can't be blocked, so the captured pawn must be the checker.
+            if (!(checkers & ~Bitboards::bit(captureSquare) & (pos.getBitboard(!side, Piece::Pawn) | pos.getBitboard(!side, Piece::Knight))))
+            {
+                while (tempPiece)
+                {
+                    const auto from = Bitboards::popLsb(tempPiece);
+                    const auto occupiedAfter = (occupied ^ Bitboards::bit(from) ^ Bitboards::bit(captureSquare)) | Bitboards::bit(ep);
+                    if (!(Bitboards::bishopAttacks(kingLocation, occupiedAfter) & pos.getBishopsAndQueens(!side))
+                        && !(Bitboards::rookAttacks(kingLocation, occupiedAfter) & pos.getRooksAndQueens(!side)))
+                    {
+                        sink.addMove(from, ep, Piece::Pawn);
+                    }
+                }
+            }
+        }
+
+        // Knight moves. A pinned knight can never move.
+        tempPiece = pos.getBitboard(side, Piece::Knight) & ~pinned;
+        while (tempPiece)
+        {
+            const auto from = Bitboards::popLsb(tempPiece);
+            sink.addPieceMoves(Bitboards::knightAttacks(from) & targetBitboard, from);
+        }
+
+        // Slider moves. A pinned slider can only move along the line formed by it and the king.
+        tempPiece = pos.getBishopsAndQueens(side);
+        while (tempPiece)
+        {
+            const auto from = Bitboards::popLsb(tempPiece);
+            tempMove = Bitboards::bishopAttacks(from, occupied) & targetBitboard;
+            if (Bitboards::testBit(pinned, from))
+            {
+                tempMove &= Bitboards::lineFormedBySquares(kingLocation, from);
+            }
+            sink.addPieceMoves(tempMove, from);
+        }
+
+        tempPiece = pos.getRooksAndQueens(side);
+        while (tempPiece)
+        {
+            const auto from = Bitboards::popLsb(tempPiece);
+            tempMove = Bitboards::rookAttacks(from, occupied) & targetBitboard;
+            if (Bitboards::testBit(pinned, from))
+            {
+                tempMove &= Bitboards::lineFormedBySquares(kingLocation, from);
+            }
+            sink.addPieceMoves(tempMove, from);
+        }
+
+        // Castling. Not possible when in check.
+        const auto shortCastlingPossible = pos.getCastlingRights() & (1 << (2 * side)) && !(occupied & (0x0000000000000060ULL << (56 * side)));
+        const auto longCastlingPossible = pos.getCastlingRights() & (2 << (2 * side)) && !(occupied & (0x000000000000000EULL << (56 * side)));
+        if (!checkers && (shortCastlingPossible || longCastlingPossible))
+        {
+            if (shortCastlingPossible)
+            {
+                if (!(pos.isAttacked(Square::F1 + 56 * side, !side)) && !(pos.isAttacked(Square::G1 + 56 * side, !side)))
+                {
+                    sink.addMove(Square::E1 + 56 * side, Square::G1 + 56 * side, Piece::King);
+                }
+            }
+            if (longCastlingPossible)
+            {
+                if (!(pos.isAttacked(Square::D1 + 56 * side, !side)) && !(pos.isAttacked(Square::C1 + 56 * side, !side)))
+                {
+                    sink.addMove(Square::E1 + 56 * side, Square::C1 + 56 * side, Piece::King);
+                }
+            }
+        }
+    }
+}
+
+void MoveGen::generateLegalMoves(const Position& pos, MoveList& moveList)
+{
+    MoveListSink sink(moveList);
+    generateLegal(pos, sink);
+}
+
+int MoveGen::countLegalMoves(const Position& pos)
+{
+    if (Bitboards::hardwarePopcntSupported())
+    {
+        MoveCountSink<true> sink;
+        generateLegal(pos, sink);
+        return sink.getCount();
+    }
+
+    MoveCountSink<false> sink;
+    generateLegal(pos, sink);
+    return sink.getCount();
+}
@@ -60,6 +60,21 @@ public:
     /// In the quiescence search generating underpromotions is a waste of time.
     /// On the other hand, in the main search NOT generating underpromotions could potentially have disastrous effects.
     static void generatePseudoLegalCaptures(const Position& pos, MoveList& moveList, bool underPromotions);
+
+    /// @brief Generates legal moves, whether in check or not.
+    /// @param pos The position for which to generate moves.
+    /// @param moveList The movelist into which we should put the generated moves.
+    ///
+    /// Uses the pinned pieces and a mask of the squares which resolve a check, so no move needs to be verified with Position::legal afterwards.
+    static void generateLegalMoves(const Position& pos, MoveList& moveList);
+
+    /// @brief Counts the legal moves without generating them. 
+    /// @param pos The position.
+    /// @return The amount of legal moves.
+    ///
+    /// Much faster than generating the moves as most moves are counted a bitboard at a time.
+    /// Used for the last ply of perft.
+    static int countLegalMoves(const Position& pos);
 };
 
 #endif
@@ -0,0 +1,286 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue.hpp"
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "bitboards.hpp"
+#include "position.hpp"
+#include "utils/clamp.hpp"
+#include "utils/large_pages.hpp"
+
+#if (defined _WIN64 || defined __x86_64__)
+ #ifdef _MSC_VER
+ #include <intrin.h>
+ #endif
+#include <immintrin.h>
+// GCC and clang only allow the intrinsics of instruction sets enabled for the function, MSVC allows them anywhere.
+ #if (defined __clang__ || defined __GNUC__)
+ #define TARGET_AVX2 __attribute__((target("avx2")))
+ #else
+ #define TARGET_AVX2
+ #endif
+#endif
+
+const int16_t* Nnue::mFeatureBiases = nullptr;
+const int16_t* Nnue::mFeatureWeights = nullptr;
+const int32_t* Nnue::mHidden1Biases = nullptr;
+const int8_t* Nnue::mHidden1Weights = nullptr;
+const int32_t* Nnue::mHidden2Biases = nullptr;
+const int8_t* Nnue::mHidden2Weights = nullptr;
+const int32_t* Nnue::mOutputBias = nullptr;
+const int8_t* Nnue::mOutputWeights = nullptr;
+void* Nnue::mMapping = nullptr;
+size_t Nnue::mMappingSize = 0;
+std::string Nnue::mFileName;
+bool Nnue::mActive = false;
+
+namespace
+{
+    // The file starts with this header, after which come in order:
+    // feature transformer biases (int16_t[halfDimensions]) and weights (int16_t[featureCount][halfDimensions]),
+    // first hidden layer biases (int32_t[hiddenDimensions]) and weights (int8_t[hiddenDimensions][2 * halfDimensions]),
+    // second hidden layer biases (int32_t[hiddenDimensions]) and weights (int8_t[hiddenDimensions][hiddenDimensions]),
+    // and finally the output bias (int32_t) and weights (int8_t[hiddenDimensions]).
+    // With a 32-byte header every layer starts at a 32-byte boundary.
+    struct NetworkHeader
+    {
+        char mMagic[4];
+        uint32_t mVersion;
+        uint32_t mFeatureCount;
+        uint32_t mHalfDimensions;
+        uint32_t mHiddenDimensions;
+        uint32_t mPadding[3];
+    };
+
+    static_assert(sizeof(NetworkHeader) == 32, "network header must be 32 bytes");
+
+    const char networkMagic[4] = { 'H', 'K', 'N', 'N' };
+    const uint32_t networkVersion = 1;
+
+    // The hidden layers shift their sums right by this many bits before clipping them to [0, 127].
+    const int weightScaleBits = 6;
+    // The output of the network divided by this is the score in centipawns.
+    const int outputScale = 16;
+    // A broken network must not produce scores which look like mate or tablebase scores to the search.
+    const int maxScore = 10000;
+
+    int clippedRelu(int32_t x)
+    {
+        return clamp(x >> weightScaleBits, 0, 127);
+    }
+
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int size)
+    {
+        int32_t sum = 0;
+        for (auto i = 0; i < size; ++i)
+        {
+            sum += input[i] * weights[i];
+        }
+        return sum;
+    }
+
+#if (defined _WIN64 || defined __x86_64__)
+    // Size must be a multiple of 32.
+    // maddubs saturates to 16 bits, but with inputs in [0, 127] two products can never exceed that, so this gives exactly the same result as the scalar version.
+    TARGET_AVX2 int32_t dotProductAvx2(const uint8_t* input, const int8_t* weights, int size)
+    {
+        const auto ones = _mm256_set1_epi16(1);
+        auto sum = _mm256_setzero_si256();
+
+        for (auto i = 0; i < size; i += 32)
+        {
+            const auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+            const auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+        }
+
+        auto sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum128);
+    }
+
+    TARGET_AVX2 void addWeightsAvx2(int16_t* values, const int16_t* weights, bool add)
+    {
+        for (auto i = 0; i < Nnue::halfDimensions; i += 16)
+        {
+            const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+            const auto w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), add ? _mm256_add_epi16(v, w) : _mm256_sub_epi16(v, w));
+        }
+    }
+#else
+    int32_t dotProductAvx2(const uint8_t* input, const int8_t* weights, int size)
+    {
+        return dotProduct(input, weights, size);
+    }
+#endif
+
+    void addWeights(int16_t* values, const int16_t* weights, bool add)
+    {
+#if (defined _WIN64 || defined __x86_64__)
+        if (Bitboards::avx2Supported())
+        {
+            addWeightsAvx2(values, weights, add);
+            return;
+        }
+#endif
+        for (auto i = 0; i < Nnue::halfDimensions; ++i)
+        {
+            values[i] += (add ? weights[i] : -weights[i]);
+        }
+    }
+}
+
+void Nnue::load(const std::string& fileName)
+{
+    const size_t featureTransformerSize = halfDimensions * sizeof(int16_t) + static_cast<size_t>(featureCount) * halfDimensions * sizeof(int16_t);
+    const size_t hidden1Size = hiddenDimensions * sizeof(int32_t) + hiddenDimensions * 2 * halfDimensions;
+    const size_t hidden2Size = hiddenDimensions * sizeof(int32_t) + hiddenDimensions * hiddenDimensions;
+    const size_t outputSize = sizeof(int32_t) + hiddenDimensions;
+    size_t fileSize;
+    auto* mapping = static_cast<char*>(LargePages::mapFile(fileName, fileSize));
+    NetworkHeader header;
+    std::string error;
+
+    if (fileSize >= sizeof(header))
+    {
+        std::memcpy(&header, mapping, sizeof(header));
+    }
+
+    if (fileSize < sizeof(header) || std::memcmp(header.mMagic, networkMagic, sizeof(networkMagic)))
+    {
+        error = "not a network file";
+    }
+    else if (header.mVersion != networkVersion)
+    {
+        error = "unsupported network version " + std::to_string(header.mVersion);
+    }
+    else if (header.mFeatureCount != static_cast<uint32_t>(featureCount) || header.mHalfDimensions != static_cast<uint32_t>(halfDimensions)
+          || header.mHiddenDimensions != static_cast<uint32_t>(hiddenDimensions))
+    {
+        error = "unsupported network architecture";
+    }
+    else if (fileSize != sizeof(header) + featureTransformerSize + hidden1Size + hidden2Size + outputSize)
+    {
+        error = "network size is invalid";
+    }
+
+    if (!error.empty())
+    {
+        LargePages::unmapFile(mapping, fileSize);
+        throw std::runtime_error(fileName + ": " + error);
+    }
+
+    // Positions keep their accumulators when a network is replaced by another, so they must be refreshed after this.
+    LargePages::unmapFile(mMapping, mMappingSize);
+    auto* p = mapping + sizeof(header);
+    mFeatureBiases = reinterpret_cast<const int16_t*>(p);
+    mFeatureWeights = mFeatureBiases + halfDimensions;
+    p += featureTransformerSize;
+    mHidden1Biases = reinterpret_cast<const int32_t*>(p);
+    mHidden1Weights = reinterpret_cast<const int8_t*>(mHidden1Biases + hiddenDimensions);
+    p += hidden1Size;
+    mHidden2Biases = reinterpret_cast<const int32_t*>(p);
+    mHidden2Weights = reinterpret_cast<const int8_t*>(mHidden2Biases + hiddenDimensions);
+    p += hidden2Size;
+    mOutputBias = reinterpret_cast<const int32_t*>(p);
+    mOutputWeights = reinterpret_cast<const int8_t*>(mOutputBias + 1);
+    mMapping = mapping;
+    mMappingSize = fileSize;
+    mFileName = fileName;
+}
+
+void Nnue::unload()
+{
+    LargePages::unmapFile(mMapping, mMappingSize);
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mFileName.clear();
+    mActive = false;
+}
+
+void Nnue::refreshAccumulator(const Position& pos, Accumulator& accumulator, Color perspective)
+{
+    assert(isLoaded());
+
+    const auto kingSquare = Bitboards::lsb(pos.getBitboard(perspective, Piece::King));
+    auto pieces = pos.getOccupiedSquares() & ~(pos.getBitboard(Color::White, Piece::King) | pos.getBitboard(Color::Black, Piece::King));
+    auto& values = accumulator.mValues[perspective];
+
+    std::memcpy(values.data(), mFeatureBiases, sizeof(values));
+    while (pieces)
+    {
+        const auto sq = Bitboards::popLsb(pieces);
+        addWeights(values.data(), mFeatureWeights + featureIndex(perspective, kingSquare, pos.getBoard(sq), sq) * halfDimensions, true);
+    }
+}
+
+void Nnue::updateAccumulator(Accumulator& accumulator, Color perspective, Square kingSquare, const FeatureChange* changes, int count)
+{
+    assert(isLoaded());
+
+    for (auto i = 0; i < count; ++i)
+    {
+        assert(changes[i].mPiece.getPieceType() != Piece::King);
+        const auto index = featureIndex(perspective, kingSquare, changes[i].mPiece, changes[i].mSquare);
+        addWeights(accumulator.mValues[perspective].data(), mFeatureWeights + index * halfDimensions, changes[i].mAdded);
+    }
+}
+
+int Nnue::evaluate(const Position& pos)
+{
+#ifdef NNUE
+    return evaluate(pos.getAccumulator(), pos.getSideToMove(), Bitboards::avx2Supported());
+#else
+    Accumulator accumulator;
+    refreshAccumulator(pos, accumulator, Color::White);
+    refreshAccumulator(pos, accumulator, Color::Black);
+    return evaluate(accumulator, pos.getSideToMove(), Bitboards::avx2Supported());
+#endif
+}
+
+int Nnue::evaluate(const Accumulator& accumulator, Color sideToMove, bool vectorized)
+{
+    assert(isLoaded());
+
+    const auto dot = (vectorized ? dotProductAvx2 : dotProduct);
+    alignas(32) std::array<uint8_t, 2 * halfDimensions> input;
+    alignas(32) std::array<uint8_t, hiddenDimensions> hidden1;
+    alignas(32) std::array<uint8_t, hiddenDimensions> hidden2;
+
+    // The side to move always comes first, so the network knows whose turn it is.
+    for (auto i = 0; i < halfDimensions; ++i)
+    {
+        input[i] = static_cast<uint8_t>(clamp<int>(accumulator.mValues[sideToMove][i], 0, 127));
+        input[halfDimensions + i] = static_cast<uint8_t>(clamp<int>(accumulator.mValues[!sideToMove][i], 0, 127));
+    }
+
+    for (auto i = 0; i < hiddenDimensions; ++i)
+    {
+        hidden1[i] = static_cast<uint8_t>(clippedRelu(mHidden1Biases[i] + dot(input.data(), mHidden1Weights + i * 2 * halfDimensions, 2 * halfDimensions)));
+    }
+
+    for (auto i = 0; i < hiddenDimensions; ++i)
+    {
+        hidden2[i] = static_cast<uint8_t>(clippedRelu(mHidden2Biases[i] + dot(hidden1.data(), mHidden2Weights + i * hiddenDimensions, hiddenDimensions)));
+    }
+
+    return clamp((*mOutputBias + dot(hidden2.data(), mOutputWeights, hiddenDimensions)) / outputScale, -maxScore, maxScore);
+}
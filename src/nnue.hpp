@@ -0,0 +1,166 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file nnue.hpp
+/// @author Mikko Aarnos
+
+#ifndef NNUE_HPP_
+#define NNUE_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "color.hpp"
+#include "piece.hpp"
+#include "square.hpp"
+
+class Position;
+
+/// @brief An efficiently updatable neural network evaluation, an alternative to the handcrafted evaluation function.
+///
+/// The network has HalfKP inputs: for both sides, every non-king piece on every square relative to the square of the king of that side.
+/// The first layer transforms these into an accumulator of halfDimensions 16-bit values per side.
+/// As a move changes only a couple of inputs, the accumulator can be updated incrementally instead of being recalculated.
+/// Built with NNUE=1 Position does exactly that, otherwise the accumulator is calculated from scratch for every evaluation.
+/// The rest of the network is two small hidden layers with 8-bit weights and clipped ReLU activations, run with AVX2 if available.
+///
+/// The network is read from a file which is mapped into memory, the weights are used in place.
+/// The file consists of a 32-byte header followed by the weights and biases of each layer in little-endian order, see nnue.cpp.
+/// Everything is static for convenience reasons.
+class Nnue
+{
+public:
+    /// @brief The amount of inputs of the network per side.
+    static const int featureCount = 64 * 641;
+
+    /// @brief The size of the accumulator per side.
+    static const int halfDimensions = 128;
+
+    /// @brief The output of the feature transformer for both sides, indexed by the color whose king the features are relative to.
+    struct Accumulator
+    {
+        std::array<std::array<int16_t, halfDimensions>, 2> mValues;
+    };
+
+    /// @brief A piece added to or removed from a square by a move.
+    struct FeatureChange
+    {
+        Piece mPiece;
+        Square mSquare;
+        bool mAdded;
+    };
+
+    /// @brief Loads a network from a file, replacing the current network. Positions must be refreshed after calling this.
+    /// @param fileName The name of the file. Throws std::runtime_error if the file cannot be read or is not a valid network.
+    static void load(const std::string& fileName);
+
+    /// @brief Unloads the current network. Also deactivates the network.
+    static void unload();
+
+    /// @brief Checks if a network is loaded.
+    /// @return True if a network is loaded.
+    static bool isLoaded() noexcept;
+
+    /// @brief Get the name of the file the current network was loaded from.
+    /// @return The name of the file, empty if no network is loaded.
+    static const std::string& getFileName() noexcept;
+
+    /// @brief Set whether the network is used instead of the handcrafted evaluation function. Positions must be refreshed after calling this.
+    /// @param active Whether the network is used. Must be false if no network is loaded.
+    static void setActive(bool active) noexcept;
+
+    /// @brief Checks if the network is used instead of the handcrafted evaluation function.
+    /// @return True if the network is used.
+    static bool isActive() noexcept;
+
+    /// @brief Calculate one side of an accumulator from scratch.
+    /// @param pos The position.
+    /// @param accumulator The accumulator.
+    /// @param perspective The side to calculate.
+    static void refreshAccumulator(const Position& pos, Accumulator& accumulator, Color perspective);
+
+    /// @brief Apply the changes made by a move to one side of an accumulator. Not usable when the king of that side moves.
+    /// @param accumulator The accumulator.
+    /// @param perspective The side to update.
+    /// @param kingSquare The square of the king of that side.
+    /// @param changes The pieces added and removed by the move. Kings are not allowed here.
+    /// @param count The amount of changes.
+    static void updateAccumulator(Accumulator& accumulator, Color perspective, Square kingSquare, const FeatureChange* changes, int count);
+
+    /// @brief Evaluates a given position with the network.
+    /// @param pos The position.
+    /// @return The score given to the position from the point of view of the side to move, in centipawns.
+    static int evaluate(const Position& pos);
+
+    /// @brief Evaluates a given position with the network, using a given accumulator for it.
+    /// @param accumulator The accumulator of the position.
+    /// @param sideToMove The side to move in the position.
+    /// @param vectorized Whether to use AVX2 or not. Must be false if the processor doesn't support AVX2.
+    /// @return The score given to the position from the point of view of the side to move, in centipawns.
+    static int evaluate(const Accumulator& accumulator, Color sideToMove, bool vectorized);
+
+private:
+    static const int hiddenDimensions = 32;
+
+    // Pointers into the mapped file.
+    static const int16_t* mFeatureBiases;
+    static const int16_t* mFeatureWeights;
+    static const int32_t* mHidden1Biases;
+    static const int8_t* mHidden1Weights;
+    static const int32_t* mHidden2Biases;
+    static const int8_t* mHidden2Weights;
+    static const int32_t* mOutputBias;
+    static const int8_t* mOutputWeights;
+
+    static void* mMapping;
+    static size_t mMappingSize;
+    static std::string mFileName;
+    static bool mActive;
+
+    static int featureIndex(Color perspective, Square kingSquare, Piece piece, Square sq);
+};
+
+inline bool Nnue::isLoaded() noexcept
+{
+    return mMapping != nullptr;
+}
+
+inline const std::string& Nnue::getFileName() noexcept
+{
+    return mFileName;
+}
+
+inline void Nnue::setActive(bool active) noexcept
+{
+    mActive = active;
+}
+
+inline bool Nnue::isActive() noexcept
+{
+    return mActive;
+}
+
+inline int Nnue::featureIndex(Color perspective, Square kingSquare, Piece piece, Square sq)
+{
+    // Black sees the board upside down, so that the same weights work for both sides.
+    const auto flip = (perspective == Color::Black ? 56 : 0);
+    const auto pieceIndex = piece.getPieceType() * 2 + ((piece >= Piece::BlackPawn) != (perspective == Color::Black));
+
+    return (kingSquare ^ flip) * 641 + 1 + pieceIndex * 64 + (sq ^ flip);
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "perft_hash.hpp"
+#include "bitboards.hpp"
+#include <cassert>
+#include <cmath>
+
+PerftHashTable::PerftHashTable(size_t sizeInMegaBytes)
+{
+    // If size is not a power of two make it the biggest power of two smaller than size.
+    if (Bitboards::moreThanOneBitSet(sizeInMegaBytes))
+    {
+        sizeInMegaBytes = static_cast<size_t>(std::pow(2, std::floor(log2(sizeInMegaBytes))));
+    }
+
+    mTable.resize((sizeInMegaBytes * 1024 * 1024) / sizeof(PerftHashTableEntry));
+    LargePages::zero(mTable.data(), mTable.size() * sizeof(mTable[0]));
+}
+
+void PerftHashTable::save(HashKey hk, int depth, uint64_t nodes)
+{
+    assert(nodes < (1ULL << 56));
+    assert(depth > 0 && depth < 256);
+
+    const auto k = key(hk, depth);
+    auto& hashEntry = mTable[k & (mTable.size() - 1)];
+    const auto data = (nodes << 8) | static_cast<uint64_t>(depth);
+
+    hashEntry.setData(data);
+    hashEntry.setHash(k ^ data);
+}
+
+bool PerftHashTable::probe(HashKey hk, int depth, uint64_t& nodes) const
+{
+    const auto k = key(hk, depth);
+    const auto& hashEntry = mTable[k & (mTable.size() - 1)];
+    const auto data = hashEntry.getData();
+
+    if ((hashEntry.getHash() ^ data) == k && (data & 0xff) == static_cast<uint64_t>(depth))
+    {
+        nodes = data >> 8;
+        return true;
+    }
+
+    return false;
+}
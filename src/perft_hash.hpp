@@ -0,0 +1,102 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file perft_hash.hpp
+/// @author Mikko Aarnos
+
+#ifndef PERFT_HASH_HPP_
+#define PERFT_HASH_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "zobrist.hpp"
+#include "utils/large_pages.hpp"
+
+/// @brief Hash table for storing perft results of subtrees, so that transposed subtrees only have to be counted once.
+///
+/// Can be used by several threads at once without locking. 
+/// Like in the pawn hash table the hash is stored xored with the data, so torn entries just look like misses.
+class PerftHashTable
+{
+public:
+    /// @brief Constructs a perft hash table of a given size.
+    /// @param sizeInMegaBytes The size of the table in megabytes. Rounded down to a power of two.
+    PerftHashTable(size_t sizeInMegaBytes);
+
+    /// @brief Save a perft result to the table.
+    /// @param hk The hash key of the position.
+    /// @param depth The depth of the perft.
+    /// @param nodes The result of the perft. Must be smaller than 2^56.
+    void save(HashKey hk, int depth, uint64_t nodes);
+
+    /// @brief Get a perft result from the table.
+    /// @param hk The hash key of the position.
+    /// @param depth The depth of the perft.
+    /// @param nodes On a succesful probe the result of the perft is put here.
+    /// @return True on a succesful probe, false otherwise.
+    bool probe(HashKey hk, int depth, uint64_t& nodes) const;
+
+private:
+    // A single entry in the perft hash table. The lowest 8 bits of the data are the depth, the rest the result.
+    class PerftHashTableEntry
+    {
+    public:
+        PerftHashTableEntry() noexcept : mHash(0), mData(0)
+        {
+        }
+
+        // Only needed by std::vector, the table is never resized while in use.
+        PerftHashTableEntry(const PerftHashTableEntry& other) noexcept : mHash(other.getHash()), mData(other.getData())
+        {
+        }
+
+        void setHash(uint64_t newHash) noexcept
+        {
+            mHash.store(newHash, std::memory_order_relaxed);
+        }
+
+        void setData(uint64_t newData) noexcept
+        {
+            mData.store(newData, std::memory_order_relaxed);
+        }
+
+        uint64_t getHash() const noexcept
+        {
+            return mHash.load(std::memory_order_relaxed);
+        }
+
+        uint64_t getData() const noexcept
+        {
+            return mData.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> mHash;
+        std::atomic<uint64_t> mData;
+    };
+
+    // The same position at different depths must not hit, so mix the depth into the key.
+    static HashKey key(HashKey hk, int depth) noexcept
+    {
+        return hk ^ (0x9E3779B97F4A7C15ULL * static_cast<uint64_t>(depth));
+    }
+
+    std::vector<PerftHashTableEntry, LargePageAllocator<PerftHashTableEntry>> mTable;
+};
+
+#endif
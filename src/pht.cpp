@@ -17,10 +17,15 @@
 
 #include "pht.hpp"
 #include "bitboards.hpp"
-#include <cassert>
 #include <cmath>
+#include <new>
+#include <stdexcept>
+#include <string>
 
-PawnHashTable::PawnHashTable()
+static_assert(sizeof(PawnHashTable::Entry) == 32, "pawn hash table entries should divide a cache line evenly");
+
+PawnHashTable::PawnHashTable() :
+mProbes(0), mHits(0)
 {
     setSize(4); 
 }
@@ -33,40 +38,27 @@ void PawnHashTable::setSize(size_t sizeInMegaBytes)
         sizeInMegaBytes = static_cast<size_t>(std::pow(2, std::floor(log2(sizeInMegaBytes))));
     }
 
-    const auto tableSize = ((sizeInMegaBytes * 1024 * 1024) / sizeof(PawnHashTableEntry));
-    mTable.clear();
-    mTable.resize(tableSize);
-    mTable.shrink_to_fit();
+    const auto oldTableSize = mTable.size();
+    const auto tableSize = ((sizeInMegaBytes * 1024 * 1024) / sizeof(Entry));
+    // Replacing the vector instead of resizing it makes changes to the page settings take effect.
+    mTable = decltype(mTable)();
+    try
+    {
+        mTable.resize(tableSize);
+    }
+    catch (const std::bad_alloc&)
+    {
+        mTable.resize(oldTableSize);
+        clear();
+        throw std::runtime_error("not enough memory for a " + std::to_string(sizeInMegaBytes) + " MB pawn hash table, keeping the old size");
+    }
+    clear();
 }
 
 void PawnHashTable::clear()
 {
-    const auto tableSize = mTable.size();
-    mTable.clear();
-    mTable.resize(tableSize);
-}
-
-void PawnHashTable::save(HashKey phk, int scoreOp, int scoreEd)
-{
-    auto& hashEntry = mTable[phk & (mTable.size() - 1)];
-
-    hashEntry.setData((scoreOp & 0xffff) | (scoreEd << 16));
-    hashEntry.setHash(phk ^ hashEntry.getData());
-
-    assert(hashEntry.getScoreOp() == scoreOp);
-    assert(hashEntry.getScoreEd() == scoreEd);
-}
-
-bool PawnHashTable::probe(HashKey phk, int& scoreOp, int& scoreEd) const
-{
-    const auto& hashEntry = mTable[phk & (mTable.size() - 1)];
-
-    if ((hashEntry.getHash() ^ hashEntry.getData()) == phk)
-    {
-        scoreOp = hashEntry.getScoreOp();
-        scoreEd = hashEntry.getScoreEd();
-        return true;
-    }
-
-    return false;
+    LargePages::zero(mTable.data(), mTable.size() * sizeof(mTable[0]));
+    // All pawnless positions have the pawn hash key 0, so a zeroed entry would look like a valid entry for them.
+    // Key 0 only ever maps to the first entry, so giving that one a key which can never map to it is enough.
+    mTable[0].mHash = 1;
 }
@@ -21,84 +21,87 @@
 #ifndef PHT_HPP_
 #define PHT_HPP_
 
+#include <array>
 #include <cstdint>
 #include <vector>
+#include "bitboards.hpp"
 #include "zobrist.hpp"
+#include "utils/large_pages.hpp"
 
 /// @brief Hash table for speeding up pawn evaluation.
 ///
+/// Besides the pawn structure score an entry caches everything else the evaluation function derives from the pawns alone,
+/// so that a hit saves the pawn shelter and open file calculations as well. Two entries fit into a cache line.
 /// Default size of the pawn hash table is 4MB.
 class PawnHashTable
 {
 public:
+    /// @brief A single entry.
+    struct Entry
+    {
+        HashKey mHash; ///< The pawn hash key of the position the entry is for.
+        int16_t mScoreOp; ///< The opening pawn structure score from the point of view of white.
+        int16_t mScoreEd; ///< The ending pawn structure score from the point of view of white.
+        std::array<uint8_t, 2> mPawnFiles; ///< Bit f is set if the side has a pawn on file f. Files without are semi-open for that side.
+        std::array<std::array<uint8_t, 8>, 2> mShelterPenalty; ///< The pawn shelter penalty of a side for each file its king can be on.
+    };
+
     /// @brief Default constructor.
     PawnHashTable();
 
     /// @brief Sets the size of the pawn hash table.
     /// @param sizeInMegaBytes Obviously, the new size of the hash table in megabytes.
+    ///
+    /// Throws std::runtime_error if there is not enough memory. In that case the table keeps its old size but is cleared.
     void setSize(size_t sizeInMegaBytes);
 
     /// @brief Clears the pawn hash table. Can potentially be an expensive operation.
     void clear();
 
-    /// @brief Save some information to the pawn hash table.
-    /// @param phk The pawn hash key of the position the information is for.
-    /// @param scoreOp The opening pawn score of the position.
-    /// @param scoreEd The ending pawn score of the position.
-    void save(HashKey phk, int scoreOp, int scoreEd);
+    /// @brief Get the entry a given pawn hash key maps to.
+    /// @param phk The pawn hash key.
+    /// @return The entry. It only holds information for phk if its mHash equals phk, otherwise the caller should fill it.
+    Entry& getEntry(HashKey phk);
 
-    /// @brief Get some information from the hash table. 
-    /// @param phk The pawn hash key of the position we are probing information for.
-    /// @param scoreOp On a succesful probe the opening pawn score is put here.
-    /// @param scoreEd On a succesful probe the ending pawn score is put here.
-    /// @return True on a succesful probe, false otherwise.
-    bool probe(HashKey phk, int& scoreOp, int& scoreEd) const;
+    /// @brief Get the amount of probes done since the last call to resetStatistics.
+    /// @return The amount of probes.
+    uint64_t getProbes() const;
 
-private:
-    // A single entry in the pawn hash table.
-    class PawnHashTableEntry
-    {
-    public:
-        PawnHashTableEntry() noexcept : mHash(0), mData(0) 
-        {
-        }
-
-        void setHash(uint64_t newHash) noexcept 
-        {
-            mHash = newHash; 
-        }
-
-        void setData(uint64_t newData) noexcept 
-        { 
-            mData = newData; 
-        }
-
-        uint64_t getHash() const noexcept 
-        { 
-            return mHash; 
-        }
-
-        uint64_t getData() const noexcept 
-        { 
-            return mData; 
-        }
-
-        int16_t getScoreOp() const noexcept 
-        {
-            return static_cast<int16_t>(mData);
-        }
-
-        int16_t getScoreEd() const noexcept
-        { 
-            return static_cast<int16_t>(mData >> 16); 
-        }
-
-    private:
-        uint64_t mHash;
-        uint64_t mData;
-    };
+    /// @brief Get the amount of probes which found the entry they were looking for since the last call to resetStatistics.
+    /// @return The amount of hits.
+    uint64_t getHits() const;
+
+    /// @brief Resets the probe and hit counters.
+    void resetStatistics();
 
-    std::vector<PawnHashTableEntry> mTable;
+private:
+    std::vector<Entry, LargePageAllocator<Entry>> mTable;
+    uint64_t mProbes;
+    uint64_t mHits;
 };
 
+inline PawnHashTable::Entry& PawnHashTable::getEntry(HashKey phk)
+{
+    auto& entry = mTable[phk & (mTable.size() - 1)];
+
+    ++mProbes;
+    mHits += (entry.mHash == phk);
+    return entry;
+}
+
+inline uint64_t PawnHashTable::getProbes() const
+{
+    return mProbes;
+}
+
+inline uint64_t PawnHashTable::getHits() const
+{
+    return mHits;
+}
+
+inline void PawnHashTable::resetStatistics()
+{
+    mProbes = mHits = 0;
+}
+
 #endif
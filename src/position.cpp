@@ -168,6 +168,48 @@ Position::Position(const std::string& fen)
         }
     }
 
+    initialize();
+}
+
+Position::Position(const PackedPosition& packed)
+{
+    mBoard.fill(Piece::Empty);
+    for (Piece p = Piece::WhitePawn; p <= Piece::BlackKing; ++p)
+    {
+        auto bitboard = packed.bitboards[p];
+        while (bitboard)
+        {
+            mBoard[Bitboards::popLsb(bitboard)] = p;
+        }
+    }
+
+    mSideToMove = packed.sideToMove;
+    mCastlingRights = packed.castlingRights;
+    mEnPassant = packed.enPassant;
+    mFiftyMoveDistance = packed.fiftyMoveDistance;
+    mGamePly = packed.gamePly;
+    initialize();
+}
+
+PackedPosition Position::pack() const
+{
+    PackedPosition packed;
+
+    for (Piece p = Piece::WhitePawn; p <= Piece::BlackKing; ++p)
+    {
+        packed.bitboards[p] = mBitboards[p];
+    }
+    packed.sideToMove = static_cast<uint8_t>(mSideToMove);
+    packed.castlingRights = mCastlingRights;
+    packed.enPassant = static_cast<uint8_t>(mEnPassant);
+    packed.fiftyMoveDistance = mFiftyMoveDistance;
+    packed.gamePly = mGamePly;
+
+    return packed;
+}
+
+void Position::initialize()
+{
     // Populate the bitboards.
     mBitboards.fill(0);
     mPieceCounts.fill(0);
@@ -204,6 +246,17 @@ Position::Position(const std::string& fen)
     mPinned = pinnedPieces(mSideToMove);
     mDcCandidates = discoveredCheckCandidates();
 
+#ifdef ATTACK_MAPS
+    mAttacksFrom.fill(0);
+    for (auto& counts : mAttackerCounts)
+    {
+        counts.fill(0);
+    }
+    mAttacks.fill(0);
+    addAttacks(getOccupiedSquares());
+#endif
+    refreshAccumulator();
+
     // Calculate the phase of the game.
     mGamePhase = totalPhase;
     for (Piece p = Piece::Knight; p < Piece::King; ++p)
@@ -214,7 +267,11 @@ Position::Position(const std::string& fen)
 
 bool Position::isAttacked(Square sq, Color side) const
 {
+#ifdef ATTACK_MAPS
+    return Bitboards::testBit(mAttacks[side], sq);
+#else
     return (side ? isAttacked<true>(sq, getOccupiedSquares()) : isAttacked<false>(sq, getOccupiedSquares()));
+#endif
 }
 
 bool Position::isAttacked(Square sq, Color side, Bitboard occupied) const
@@ -234,6 +291,12 @@ void Position::makeMove(const Move& m)
     const auto captured = mBoard[to];
     const auto fromToBB = Bitboards::bit(from) | Bitboards::bit(to);
 
+#ifdef ATTACK_MAPS
+    // Take out the attacks which may change before changing the board, and put them back in afterwards.
+    const auto dirty = changedSquares(m) | slidersAttacking(changedSquares(m));
+    removeAttacks(dirty);
+#endif
+
     // Update the PST score for the piece moving.
     mPstScoreOp += Evaluation::getPieceSquareTableOp(piece, to) 
                  - Evaluation::getPieceSquareTableOp(piece, from);
@@ -349,6 +412,17 @@ void Position::makeMove(const Move& m)
         mCastlingRights &= ~cf;
     }
 
+#ifdef ATTACK_MAPS
+    addAttacks(dirty);
+    assert(verifyAttacks());
+#endif
+#ifdef NNUE
+    if (Nnue::isActive())
+    {
+        updateAccumulator(m, side, piece, captured, false);
+    }
+    assert(verifyAccumulator());
+#endif
     assert(verifyPsts());
     assert(verifyHashKeysAndPhase());
     assert(verifyPieceCounts());
@@ -369,6 +443,277 @@ void Position::makeNullMove()
     mDcCandidates = discoveredCheckCandidates();
 }
 
+void Position::makeMove(const Move& m, UndoInfo& undo)
+{
+    saveState(undo);
+    undo.mCaptured = mBoard[m.getTo()];
+    makeMove(m);
+}
+
+void Position::unmakeMove(const Move& m, const UndoInfo& undo)
+{
+    const auto side = !mSideToMove;
+    const auto from = m.getFrom();
+    const auto to = m.getTo();
+    const auto flags = m.getFlags();
+    const auto captured = undo.mCaptured;
+    const auto fromToBB = Bitboards::bit(from) | Bitboards::bit(to);
+    auto piece = mBoard[to];
+
+#ifdef ATTACK_MAPS
+    const auto dirty = changedSquares(m) | slidersAttacking(changedSquares(m));
+    removeAttacks(dirty);
+#endif
+
+    // Turn a promoted piece back into a pawn before moving it back.
+    if (flags != Piece::Empty && flags != Piece::Pawn && flags != Piece::King)
+    {
+        Bitboards::clearBit(mBitboards[piece], to);
+        --mPieceCounts[piece];
+        piece = Piece::Pawn + side * 6;
+        Bitboards::setBit(mBitboards[piece], to);
+        ++mPieceCounts[piece];
+        --mNonPawnPieceCounts[side];
+    }
+
+    mBoard[from] = piece;
+    mBoard[to] = captured;
+    mBitboards[piece] ^= fromToBB;
+    mBitboards[12 + side] ^= fromToBB;
+
+    if (captured != Piece::Empty)
+    {
+        Bitboards::setBit(mBitboards[captured], to);
+        Bitboards::setBit(mBitboards[12 + !side], to);
+        ++mPieceCounts[captured];
+        ++mTotalPieceCount;
+        if (captured.getPieceType() != Piece::Pawn)
+        {
+            ++mNonPawnPieceCounts[!side];
+        }
+    }
+    else if (flags == Piece::Pawn) // En passant
+    {
+        const auto enPassantSquare = to ^ 8;
+        Bitboards::setBit(mBitboards[Piece::Pawn + !side * 6], enPassantSquare);
+        Bitboards::setBit(mBitboards[12 + !side], enPassantSquare);
+        mBoard[enPassantSquare] = Piece::Pawn + !side * 6;
+        ++mPieceCounts[Piece::Pawn + !side * 6];
+        ++mTotalPieceCount;
+    }
+    else if (flags == Piece::King) // Castling
+    {
+        const auto fromRook = (from > to ? (to - 2) : (to + 1));
+        const auto toRook = (from + to) / 2;
+        const auto fromToBBCastling = Bitboards::bit(fromRook) | Bitboards::bit(toRook);
+
+        mBitboards[Piece::Rook + side * 6] ^= fromToBBCastling;
+        mBitboards[12 + side] ^= fromToBBCastling;
+        mBoard[fromRook] = mBoard[toRook];
+        mBoard[toRook] = Piece::Empty;
+    }
+
+    mSideToMove = side;
+    --mGamePly;
+    restoreState(undo);
+
+#ifdef ATTACK_MAPS
+    addAttacks(dirty);
+    assert(verifyAttacks());
+#endif
+#ifdef NNUE
+    if (Nnue::isActive())
+    {
+        updateAccumulator(m, side, piece, captured, true);
+    }
+    assert(verifyAccumulator());
+#endif
+    assert(verifyPsts());
+    assert(verifyHashKeysAndPhase());
+    assert(verifyPieceCounts());
+    assert(verifyBoardAndBitboards());
+}
+
+void Position::makeNullMove(UndoInfo& undo)
+{
+    saveState(undo);
+    makeNullMove();
+}
+
+void Position::unmakeNullMove(const UndoInfo& undo)
+{
+    mSideToMove = !mSideToMove;
+    restoreState(undo);
+}
+
+#ifdef ATTACK_MAPS
+Bitboard Position::changedSquares(const Move& m) const
+{
+    const auto from = m.getFrom();
+    const auto to = m.getTo();
+    auto squares = Bitboards::bit(from) | Bitboards::bit(to);
+
+    if (m.getFlags() == Piece::King)
+    {
+        squares |= Bitboards::bit(from > to ? (to - 2) : (to + 1)) | Bitboards::bit((from + to) / 2);
+    }
+    else if (m.getFlags() == Piece::Pawn)
+    {
+        squares |= Bitboards::bit(to ^ 8);
+    }
+
+    return squares;
+}
+
+Bitboard Position::slidersAttacking(Bitboard squares) const
+{
+    auto sliders = getBishopsAndQueens() | getRooksAndQueens();
+    Bitboard result = 0;
+
+    while (sliders)
+    {
+        const auto sq = Bitboards::popLsb(sliders);
+        if (mAttacksFrom[sq] & squares)
+        {
+            Bitboards::setBit(result, sq);
+        }
+    }
+
+    return result;
+}
+
+void Position::removeAttacks(Bitboard squares)
+{
+    squares &= getOccupiedSquares();
+    while (squares)
+    {
+        const auto sq = Bitboards::popLsb(squares);
+        const auto color = mBoard[sq] >= Piece::BlackPawn;
+        auto attacks = mAttacksFrom[sq];
+
+        mAttacksFrom[sq] = 0;
+        while (attacks)
+        {
+            const auto target = Bitboards::popLsb(attacks);
+            if (!--mAttackerCounts[color][target])
+            {
+                Bitboards::clearBit(mAttacks[color], target);
+            }
+        }
+    }
+}
+
+void Position::addAttacks(Bitboard squares)
+{
+    const auto occupied = getOccupiedSquares();
+
+    squares &= occupied;
+    while (squares)
+    {
+        const auto sq = Bitboards::popLsb(squares);
+        const auto color = mBoard[sq] >= Piece::BlackPawn;
+        auto attacks = Bitboards::pieceAttacks(color, mBoard[sq].getPieceType(), sq, occupied);
+
+        mAttacksFrom[sq] = attacks;
+        mAttacks[color] |= attacks;
+        while (attacks)
+        {
+            ++mAttackerCounts[color][Bitboards::popLsb(attacks)];
+        }
+    }
+}
+#endif
+
+void Position::refreshAccumulator()
+{
+#ifdef NNUE
+    if (Nnue::isActive())
+    {
+        Nnue::refreshAccumulator(*this, mAccumulator, Color::White);
+        Nnue::refreshAccumulator(*this, mAccumulator, Color::Black);
+    }
+#endif
+}
+
+#ifdef NNUE
+void Position::updateAccumulator(const Move& m, Color side, Piece piece, Piece captured, bool unmake)
+{
+    const auto from = m.getFrom();
+    const auto to = m.getTo();
+    const auto flags = m.getFlags();
+    std::array<Nnue::FeatureChange, 3> changes;
+    auto count = 0;
+    const auto addChange = [&](Piece p, Square sq, bool added)
+    {
+        changes[count++] = { p, sq, added != unmake };
+    };
+
+    if (piece.getPieceType() != Piece::King)
+    {
+        const auto promotion = piece.getPieceType() == Piece::Pawn && flags != Piece::Empty && flags != Piece::Pawn;
+        addChange(piece, from, false);
+        addChange(promotion ? Piece(flags + side * 6) : piece, to, true);
+    }
+    else if (flags == Piece::King)
+    {
+        addChange(Piece::Rook + side * 6, from > to ? (to - 2) : (to + 1), false);
+        addChange(Piece::Rook + side * 6, (from + to) / 2, true);
+    }
+
+    if (captured != Piece::Empty)
+    {
+        addChange(captured, to, false);
+    }
+    else if (piece.getPieceType() == Piece::Pawn && flags == Piece::Pawn)
+    {
+        addChange(Piece::Pawn + !side * 6, to ^ 8, false);
+    }
+
+    // The features of a side are relative to its king, so if the king moves everything changes.
+    for (Color c = Color::White; c <= Color::Black; ++c)
+    {
+        if (c == side && piece.getPieceType() == Piece::King)
+        {
+            Nnue::refreshAccumulator(*this, mAccumulator, c);
+        }
+        else
+        {
+            Nnue::updateAccumulator(mAccumulator, c, Bitboards::lsb(getBitboard(c, Piece::King)), changes.data(), count);
+        }
+    }
+}
+#endif
+
+void Position::saveState(UndoInfo& undo) const
+{
+    undo.mHashKey = mHashKey;
+    undo.mPawnHashKey = mPawnHashKey;
+    undo.mMaterialHashKey = mMaterialHashKey;
+    undo.mPinned = mPinned;
+    undo.mDcCandidates = mDcCandidates;
+    undo.mPstScoreOp = mPstScoreOp;
+    undo.mPstScoreEd = mPstScoreEd;
+    undo.mCastlingRights = mCastlingRights;
+    undo.mEnPassant = mEnPassant;
+    undo.mFiftyMoveDistance = mFiftyMoveDistance;
+    undo.mGamePhase = mGamePhase;
+}
+
+void Position::restoreState(const UndoInfo& undo)
+{
+    mHashKey = undo.mHashKey;
+    mPawnHashKey = undo.mPawnHashKey;
+    mMaterialHashKey = undo.mMaterialHashKey;
+    mPinned = undo.mPinned;
+    mDcCandidates = undo.mDcCandidates;
+    mPstScoreOp = undo.mPstScoreOp;
+    mPstScoreEd = undo.mPstScoreEd;
+    mCastlingRights = undo.mCastlingRights;
+    mEnPassant = undo.mEnPassant;
+    mFiftyMoveDistance = undo.mFiftyMoveDistance;
+    mGamePhase = undo.mGamePhase;
+}
+
 template <bool side>
 bool Position::isAttacked(Square sq, Bitboard occupied) const
 {
@@ -668,6 +1013,14 @@ int16_t Position::SEE(const Move& move) const
         }
     }
 
+#ifdef ATTACK_MAPS
+    // Nothing can recapture if the opponent attacks neither the destination square nor the square we leave, which some slider could x-ray through.
+    if (flags != Piece::Pawn && !mAttackerCounts[!stm][to] && !mAttackerCounts[!stm][from])
+    {
+        return materialGains[0];
+    }
+#endif
+
     Bitboards::clearBit(occupied, from);
     auto attackers = (Bitboards::rookAttacks(to, occupied) & getRooksAndQueens())
                    | (Bitboards::bishopAttacks(to, occupied) & getBishopsAndQueens())
@@ -943,3 +1296,52 @@ bool Position::verifyBoardAndBitboards() const
 
     return true;
 }
+
+#ifdef ATTACK_MAPS
+bool Position::verifyAttacks() const
+{
+    const auto occupied = getOccupiedSquares();
+    std::array<std::array<uint8_t, 64>, 2> attackerCounts;
+    std::array<Bitboard, 2> attacks = { { 0, 0 } };
+
+    for (auto& counts : attackerCounts)
+    {
+        counts.fill(0);
+    }
+
+    for (Square sq = Square::A1; sq <= Square::H8; ++sq)
+    {
+        Bitboard pieceAttacks = 0;
+        if (mBoard[sq] != Piece::Empty)
+        {
+            const auto color = mBoard[sq] >= Piece::BlackPawn;
+            pieceAttacks = Bitboards::pieceAttacks(color, mBoard[sq].getPieceType(), sq, occupied);
+            attacks[color] |= pieceAttacks;
+            for (auto bb = pieceAttacks; bb;)
+            {
+                ++attackerCounts[color][Bitboards::popLsb(bb)];
+            }
+        }
+
+        if (mAttacksFrom[sq] != pieceAttacks)
+            return false;
+    }
+
+    return attacks == mAttacks && attackerCounts == mAttackerCounts;
+}
+#endif
+
+#ifdef NNUE
+bool Position::verifyAccumulator() const
+{
+    if (!Nnue::isActive())
+    {
+        return true;
+    }
+
+    Nnue::Accumulator accumulator;
+    Nnue::refreshAccumulator(*this, accumulator, Color::White);
+    Nnue::refreshAccumulator(*this, accumulator, Color::Black);
+    return accumulator.mValues == mAccumulator.mValues;
+}
+#endif
@@ -28,6 +28,8 @@
 #include "zobrist.hpp"
 #include "color.hpp"
 #include "piece.hpp"
+#include "nnue.hpp"
+#include "search.h"
 
 /// @brief Represents a single board position.
 class Position
@@ -37,6 +39,14 @@ public:
     /// @param fen The FEN string.
     Position(const std::string& fen); 
 
+    /// @brief Constructs a Position from its packed representation.
+    /// @param packed The packed position.
+    explicit Position(const PackedPosition& packed);
+
+    /// @brief Packs the position into a plain old data structure which can be sent to accelerators.
+    /// @return The packed position.
+    PackedPosition pack() const;
+
     /// @brief Get the piece on a given square.
     /// @param sq The square.
     /// @return The piece. Can be empty as well.
@@ -107,6 +117,35 @@ public:
     /// @return A bitboard with a bit marked for any bishop or queen of a given color.
     Bitboard getBishopsAndQueens(Color c) const;
 
+#ifdef ATTACK_MAPS
+    /// @brief Get all squares attacked by a given color. Only available when built with ATTACK_MAPS.
+    /// @param c The color.
+    /// @return A bitboard with every attacked square marked.
+    Bitboard getAttacks(Color c) const;
+
+    /// @brief Get the squares attacked by the piece on a given square. Only available when built with ATTACK_MAPS.
+    /// @param sq The square.
+    /// @return A bitboard with every attacked square marked. Empty if there is no piece on the square.
+    Bitboard getAttacksFrom(Square sq) const;
+
+    /// @brief Get the amount of pieces of a given color attacking a given square. Only available when built with ATTACK_MAPS.
+    /// @param c The color.
+    /// @param sq The square.
+    /// @return The amount of attackers. X-ray attackers are not counted.
+    int getAttackerCount(Color c, Square sq) const;
+#endif
+
+#ifdef NNUE
+    /// @brief Get the accumulator of the neural network evaluation. Only available when built with NNUE, and only up to date while the network is active.
+    /// @return The accumulator.
+    const Nnue::Accumulator& getAccumulator() const noexcept;
+#endif
+
+    /// @brief Recalculates the accumulator of the neural network evaluation. Must be called after activating or changing the network.
+    ///
+    /// Does nothing unless built with NNUE and the network is active.
+    void refreshAccumulator();
+
     /// @brief Get the normal hash key for this position. That is usually used by the TT.
     /// @return The hash key.
     HashKey getHashKey() const noexcept;
@@ -146,13 +185,46 @@ public:
     /// @return The ply.
     int16_t getGamePly() const noexcept;
 
-    /// @brief Makes a given move on the board. We use copy-make so unmake is unnecessary.
+    /// @brief The state of a position which cannot be recovered from the board after making a move. Used for make/unmake.
+    ///
+    /// The PST scores and the game phase could be recovered, but saving them is cheaper than recalculating them.
+    struct UndoInfo
+    {
+        HashKey mHashKey, mPawnHashKey, mMaterialHashKey;
+        Bitboard mPinned, mDcCandidates;
+        int16_t mPstScoreOp, mPstScoreEd;
+        Piece mCaptured;
+        uint8_t mCastlingRights;
+        Square mEnPassant;
+        uint8_t mFiftyMoveDistance;
+        int8_t mGamePhase;
+    };
+
+    /// @brief Makes a given move on the board. With copy-make unmake is unnecessary.
     /// @param move The move.
     void makeMove(const Move& move);
 
-    /// @brief Makes a null move. Unmake is unnecessary due to copy-make.
+    /// @brief Makes a given move on the board so that it can be taken back later with unmakeMove.
+    /// @param move The move.
+    /// @param undo The state needed for unmaking the move is saved here.
+    void makeMove(const Move& move, UndoInfo& undo);
+
+    /// @brief Takes back a move made with makeMove.
+    /// @param move The move, must be the last move made.
+    /// @param undo The state saved by makeMove.
+    void unmakeMove(const Move& move, const UndoInfo& undo);
+
+    /// @brief Makes a null move. With copy-make unmake is unnecessary.
     void makeNullMove();
 
+    /// @brief Makes a null move so that it can be taken back later with unmakeNullMove.
+    /// @param undo The state needed for unmaking the null move is saved here.
+    void makeNullMove(UndoInfo& undo);
+
+    /// @brief Takes back a null move made with makeNullMove.
+    /// @param undo The state saved by makeNullMove.
+    void unmakeNullMove(const UndoInfo& undo);
+
     /// @brief Checks if the current side to move is in check.
     /// @return True if the side to mvoe is in check, false otherwise.
     bool inCheck() const;
@@ -225,6 +297,17 @@ private:
     int8_t mGamePhase;
     int16_t mGamePly;
     int16_t mPstScoreOp, mPstScoreEd;
+#ifdef ATTACK_MAPS
+    // The attack maps. These are updated incrementally when making and unmaking moves.
+    // We keep the attacks of the piece on every square, how many pieces of each color attack every square and the union of the attacks of each color.
+    std::array<Bitboard, 64> mAttacksFrom;
+    std::array<std::array<uint8_t, 64>, 2> mAttackerCounts;
+    std::array<Bitboard, 2> mAttacks;
+#endif
+#ifdef NNUE
+    // The accumulator of the neural network evaluation. Updated incrementally when making and unmaking moves while the network is active.
+    Nnue::Accumulator mAccumulator;
+#endif
     
     template <bool side>
     bool isAttacked(Square sq, Bitboard occupied) const;
@@ -233,6 +316,29 @@ private:
     Bitboard pinnedPieces(Color c) const;
     Bitboard checkBlockers(Color c, Color kingColor) const;
 
+#ifdef ATTACK_MAPS
+    // The squares whose contents a given move changes.
+    Bitboard changedSquares(const Move& move) const;
+    // The sliders whose attacks include any of the given squares. Only their attacks can change when the contents of the squares change.
+    Bitboard slidersAttacking(Bitboard squares) const;
+    // Remove the attacks of the pieces on the given squares from the attack maps, or calculate and add them.
+    void removeAttacks(Bitboard squares);
+    void addAttacks(Bitboard squares);
+#endif
+
+#ifdef NNUE
+    // Applies the pieces a move added to and removed from the board to the accumulator. Must be called after the board has been updated.
+    // When unmaking a move the additions and removals are reversed.
+    void updateAccumulator(const Move& move, Color side, Piece piece, Piece captured, bool unmake);
+#endif
+
+    // Saves and restores the state of the position which unmaking a move cannot recover.
+    void saveState(UndoInfo& undo) const;
+    void restoreState(const UndoInfo& undo);
+
+    // Calculates everything else from the board, side to move, castling rights, en passant square, fifty move distance and game ply.
+    void initialize();
+
     // These functions can be used to calculate different hash keys for the current position.
     // They are slow so they are only used when initializing, instead we update them incrementally.
     HashKey calculateHash() const;
@@ -244,6 +350,12 @@ private:
     bool verifyHashKeysAndPhase() const;
     bool verifyPieceCounts() const;
     bool verifyBoardAndBitboards() const;
+#ifdef ATTACK_MAPS
+    bool verifyAttacks() const;
+#endif
+#ifdef NNUE
+    bool verifyAccumulator() const;
+#endif
 };
 
 inline Piece Position::getBoard(Square sq) const 
@@ -306,6 +418,30 @@ inline Bitboard Position::getDiscoveredCheckCandidates() const noexcept
     return mDcCandidates; 
 }
 
+#ifdef ATTACK_MAPS
+inline Bitboard Position::getAttacks(Color c) const
+{
+    return mAttacks[c];
+}
+
+inline Bitboard Position::getAttacksFrom(Square sq) const
+{
+    return mAttacksFrom[sq];
+}
+
+inline int Position::getAttackerCount(Color c, Square sq) const
+{
+    return mAttackerCounts[c][sq];
+}
+#endif
+
+#ifdef NNUE
+inline const Nnue::Accumulator& Position::getAccumulator() const noexcept
+{
+    return mAccumulator;
+}
+#endif
+
 inline HashKey Position::getHashKey() const noexcept
 { 
     return mHashKey;
@@ -353,7 +489,11 @@ inline int16_t Position::getGamePly() const noexcept
 
 inline bool Position::inCheck() const 
 { 
+#ifdef ATTACK_MAPS
+    return (mAttacks[!mSideToMove] & getBitboard(mSideToMove, Piece::King)) != 0;
+#else
     return isAttacked(Bitboards::lsb(getBitboard(mSideToMove, Piece::King)), !mSideToMove); 
+#endif
 }
 
 inline Bitboard Position::discoveredCheckCandidates() const 
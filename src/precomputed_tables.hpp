@@ -0,0 +1,36 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file precomputed_tables.hpp
+/// @author Mikko Aarnos
+
+#ifndef PRECOMPUTED_TABLES_HPP_
+#define PRECOMPUTED_TABLES_HPP_
+
+/// @brief Qualifier for the lookup tables which can be precomputed at build time.
+///
+/// Normally the lookup tables of Bitboards, Zobrist and Evaluation are calculated by their staticInitialize functions at startup.
+/// When PRECOMPUTED_TABLES is defined tablegen has calculated them at build time and written them into precomputed_tables.cpp.
+/// The tables are then constant, so they end up in read-only data which all running engine processes share through the page cache,
+/// and staticInitialize only has to detect the features of the processor.
+#ifdef PRECOMPUTED_TABLES
+#define PRECOMPUTED_TABLE const
+#else
+#define PRECOMPUTED_TABLE
+#endif
+
+#endif
@@ -25,6 +25,7 @@
 #include "task.h"
 #include "score.h"
 
+static_assert(TranspositionTable::noStaticEval == -infinity, "positions in check must get the same static evaluation from the TT as from the search");
 
 extern "C" {
   // TT-scores are adjusted to avoid some well-known problems. This adjusts a score back to normal.
@@ -60,7 +61,7 @@ extern "C" {
 
 // Used for ordering moves during the quiescence search.
 // Delete as soon as MoveSort works everywhere.
-void Search::orderCaptures(const Position& pos, MoveList& moveList, const Move& ttMove) const
+void Search::orderCaptures(const SearchThread& st, const Position& pos, MoveList& moveList, const Move& ttMove) const
 {
     for (auto i = 0; i < moveList.size(); ++i)
     {
@@ -76,7 +77,7 @@ void Search::orderCaptures(const Position& pos, MoveList& moveList, const Move&
         }
         else
         {
-            moveList.setScore(i, historyTable.getScore(pos, move));
+            moveList.setScore(i, st.mHistoryTable.getScore(pos, move));
         }
     }
 }
@@ -146,7 +147,7 @@ void removeIllegalMoves(const Position& pos, MoveList& moveList, bool inCheck)
     moveList.resize(marker);
 }
 
-void Search::orderRootMoves(const Position& pos, MoveList& moveList, const Move& ttMove) const
+void Search::orderRootMoves(const SearchThread& st, const Position& pos, MoveList& moveList, const Move& ttMove) const
 {
     for (auto i = 0; i < moveList.size(); ++i)
     {
@@ -167,7 +168,7 @@ void Search::orderRootMoves(const Position& pos, MoveList& moveList, const Move&
         }
         else
         {
-            const auto killers = killerTable.getKillers(0);
+            const auto killers = st.mKillerTable.getKillers(0);
             if (move == killers.first)
             {
                 moveList.setScore(i, killerMoveScore[1]);
@@ -178,18 +179,29 @@ void Search::orderRootMoves(const Position& pos, MoveList& moveList, const Move&
             }
             else
             {
-                moveList.setScore(i, historyTable.getScore(pos, move));
+                moveList.setScore(i, st.mHistoryTable.getScore(pos, move));
             }
         }
     }
 }
 
+SearchThread::SearchThread(int id):
+    mId(id), mNodesToTimeCheck(10000), mSelDepth(0), mNodeCount(0), mTbHits(0)
+{
+    for (auto i = 0; i < maxPly + 1; ++i)
+    {
+        mSearchStack.emplace_back(i);
+    }
+}
+
 Search::Search(SearchListener& sl):
-    tp(1), listener(sl), searchNeedsMoreTime(false), nodesToTimeCheck(10000), nextSendInfo(1000), 
+    tp(1), listener(sl), pawnHashTableSize(4), evaluationCacheSize(1), quiescenceSearchOffload(false), searchNeedsMoreTime(false), nextSendInfo(1000), 
     targetTime(1000), maxTime(10000), maxNodes(std::numeric_limits<size_t>::max()),
-    tbHits(0), nodeCount(0), selDepth(0), searching(false), pondering(false), infinite(false), 
-    cardinality(6), probeDepth(1), use50(true), rootPly(0), repetitionHashes({}), contempt({})
+    searching(false), pondering(false), infinite(false), 
+    cardinality(6), probeDepth(1), use50(true), rootPly(0), contempt({})
 {
+    setThreads(1);
+
     for (auto i = 0; i < 64; ++i)
     {
         for (auto j = 0; j < 64; ++j)
@@ -204,13 +216,233 @@ Search::Search(SearchListener& sl):
     }
 }
 
-bool Search::repetitionDraw(const Position& pos, int ply) const
+void Search::setThreads(int amountOfThreads)
+{
+    waitForClear();
+    threads.clear();
+    for (auto i = 0; i < amountOfThreads; ++i)
+    {
+        threads.emplace_back(new SearchThread(i));
+        threads.back()->mEvaluation.setPawnHashTableSize(pawnHashTableSize);
+        threads.back()->mEvaluationCache.setSize(evaluationCacheSize);
+    }
+}
+
+void Search::setupOffloadThreads(bool enabled)
+{
+    // Accelerator workers get negative ids so that they never do any of the things only the main thread (id 0) does.
+    // The contexts are only created while offloading is enabled, every one of them has hash tables of its own.
+    const auto workerCount = enabled ? Accelerator::instance().getWorkerCount() : 0;
+    waitForClear(); // A clear running in the background goes through the offload threads too.
+    offloadThreads.clear();
+    for (auto i = 0; i < workerCount; ++i)
+    {
+        offloadThreads.emplace_back(new SearchThread(-1 - i));
+        offloadThreads.back()->mEvaluation.setPawnHashTableSize(pawnHashTableSize);
+        offloadThreads.back()->mEvaluationCache.setSize(evaluationCacheSize);
+    }
+}
+
+void Search::runQuiescenceSearchJob(QSearchJob& job, int workerId)
+{
+    auto& st = *offloadThreads[workerId];
+    Position pos(job.position);
+    const auto nodeCount = st.getNodeCount();
+
+    job.score = quiescenceSearch(st, pos, 0, job.alpha, job.beta, pos.inCheck(), &st.mSearchStack[job.ply]);
+    job.nodes = st.getNodeCount() - nodeCount;
+}
+
+bool Search::offloadRootQuiescenceSearch(SearchThread& st, const Position& pos, MoveList& rootMoveList, Move& bestMove, int& bestScore)
+{
+    if (!quiescenceSearchOffload || offloadThreads.empty() || rootMoveList.empty())
+    {
+        return false;
+    }
+    auto& accelerator = Accelerator::instance();
+    if (!accelerator.supportsQuiescenceSearch())
+    {
+        return false;
+    }
+
+    std::vector<QSearchJob> jobs(rootMoveList.size());
+    for (auto i = 0; i < rootMoveList.size(); ++i)
+    {
+        Position newPosition(pos);
+        newPosition.makeMove(rootMoveList.getMove(i));
+        jobs[i].position = newPosition.pack();
+        jobs[i].alpha = -infinity;
+        jobs[i].beta = infinity;
+        jobs[i].ply = 1;
+        st.addNode();
+    }
+
+    // The accelerator is shared with every other Search object, so the handler has to be set for every batch.
+    accelerator.setQuiescenceSearchHandler([this](QSearchJob& job, int workerId) { runQuiescenceSearchJob(job, workerId); });
+    accelerator.submitQuiescenceSearchBatch(jobs.data(), static_cast<int>(jobs.size()));
+    accelerator.joinQuiescenceSearchBatch();
+
+    bestScore = -mateScore;
+    for (auto i = 0; i < rootMoveList.size(); ++i)
+    {
+        const auto score = -jobs[i].score;
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = rootMoveList.getMove(i);
+        }
+    }
+
+    return true;
+}
+
+std::pair<uint64_t, uint64_t> Search::benchmarkQuiescenceSearchOffload(const Position& root, bool offload)
+{
+    std::vector<QSearchJob> jobs;
+    MoveList moveList, childMoveList;
+    auto& st = *threads[0];
+    auto& accelerator = Accelerator::instance();
+    Stopwatch stopwatch;
+
+    if (offload && offloadThreads.empty())
+    {
+        setupOffloadThreads(true);
+    }
+    waitForClear();
+    transpositionTable.clear();
+    for (auto& t : offloadThreads)
+    {
+        t->mRepetitionHashes.assign(maxPly + 1, 0);
+    }
+    st.mRepetitionHashes.assign(maxPly + 1, 0);
+    rootPly = 0;
+
+    // Collect the positions two plies from the root.
+    const auto inCheck = root.inCheck();
+    inCheck ? MoveGen::generateLegalEvasions(root, moveList) : MoveGen::generatePseudoLegalMoves(root, moveList);
+    removeIllegalMoves(root, moveList, inCheck);
+    for (auto i = 0; i < moveList.size(); ++i)
+    {
+        Position child(root);
+        child.makeMove(moveList.getMove(i));
+        const auto childInCheck = child.inCheck();
+        childMoveList.clear();
+        childInCheck ? MoveGen::generateLegalEvasions(child, childMoveList) : MoveGen::generatePseudoLegalMoves(child, childMoveList);
+        removeIllegalMoves(child, childMoveList, childInCheck);
+        for (auto j = 0; j < childMoveList.size(); ++j)
+        {
+            Position grandChild(child);
+            grandChild.makeMove(childMoveList.getMove(j));
+            QSearchJob job;
+            job.position = grandChild.pack();
+            job.alpha = -infinity;
+            job.beta = infinity;
+            job.ply = 2;
+            jobs.push_back(job);
+        }
+    }
+
+    accelerator.setQuiescenceSearchHandler([this](QSearchJob& job, int workerId) { runQuiescenceSearchJob(job, workerId); });
+    stopwatch.start();
+    if (offload && accelerator.supportsQuiescenceSearch())
+    {
+        accelerator.submitQuiescenceSearchBatch(jobs.data(), static_cast<int>(jobs.size()));
+        accelerator.joinQuiescenceSearchBatch();
+    }
+    else
+    {
+        for (auto& job : jobs)
+        {
+            Position pos(job.position);
+            const auto nodeCount = st.getNodeCount();
+            job.score = quiescenceSearch(st, pos, 0, job.alpha, job.beta, pos.inCheck(), &st.mSearchStack[job.ply]);
+            job.nodes = st.getNodeCount() - nodeCount;
+        }
+    }
+    stopwatch.stop();
+
+    auto nodes = 0ULL;
+    for (auto& job : jobs)
+    {
+        nodes += job.nodes;
+    }
+    if (!quiescenceSearchOffload)
+    {
+        setupOffloadThreads(false);
+    }
+    return std::make_pair(nodes, stopwatch.elapsed<std::chrono::microseconds>());
+}
+
+uint64_t Search::getNodeCount() const
+{
+    auto nodeCount = 0ULL;
+    for (auto& st : threads)
+    {
+        nodeCount += st->getNodeCount();
+    }
+    for (auto& st : offloadThreads)
+    {
+        nodeCount += st->getNodeCount();
+    }
+    return nodeCount;
+}
+
+uint64_t Search::getTbHits() const
+{
+    auto tbHits = 0ULL;
+    for (auto& st : threads)
+    {
+        tbHits += st->getTbHits();
+    }
+    return tbHits;
+}
+
+std::pair<uint64_t, uint64_t> Search::getEvaluationCacheStatistics() const
+{
+    auto probes = 0ULL, hits = 0ULL;
+    for (auto& st : threads)
+    {
+        probes += st->mEvaluationCache.getProbes();
+        hits += st->mEvaluationCache.getHits();
+    }
+    for (auto& st : offloadThreads)
+    {
+        probes += st->mEvaluationCache.getProbes();
+        hits += st->mEvaluationCache.getHits();
+    }
+    return std::make_pair(probes, hits);
+}
+
+#ifdef SEARCH_STATISTICS
+SearchStatistics Search::getSearchStatistics() const
+{
+    SearchStatistics statistics;
+    for (auto& st : threads)
+    {
+        statistics.add(st->mStatistics);
+        statistics.mCounters[SearchStatistics::PawnHashTableProbes] += st->mEvaluation.getPawnHashTable().getProbes();
+        statistics.mCounters[SearchStatistics::PawnHashTableHits] += st->mEvaluation.getPawnHashTable().getHits();
+    }
+    for (auto& st : offloadThreads)
+    {
+        statistics.add(st->mStatistics);
+        statistics.mCounters[SearchStatistics::PawnHashTableProbes] += st->mEvaluation.getPawnHashTable().getProbes();
+        statistics.mCounters[SearchStatistics::PawnHashTableHits] += st->mEvaluation.getPawnHashTable().getHits();
+    }
+    const auto evaluationCacheStatistics = getEvaluationCacheStatistics();
+    statistics.mCounters[SearchStatistics::EvaluationCacheProbes] = evaluationCacheStatistics.first;
+    statistics.mCounters[SearchStatistics::EvaluationCacheHits] = evaluationCacheStatistics.second;
+    return statistics;
+}
+#endif
+
+bool Search::repetitionDraw(const SearchThread& st, const Position& pos, int ply) const
 {
     const auto limit = std::max(rootPly + ply - pos.getFiftyMoveDistance(), 0);
 
     for (auto i = rootPly + ply - 2; i >= limit; i -= 2)
     {
-        if (repetitionHashes[i] == pos.getHashKey())
+        if (st.mRepetitionHashes[i] == pos.getHashKey())
         {
             return true;
         }
@@ -227,14 +459,14 @@ std::vector<Move> Search::extractPv(const Position& pos) const
 
     for (auto ply = 0; ply < 128; ++ply)
     {
-        const auto entry = transpositionTable.probe(root.getHashKey());
+        TranspositionTable::TranspositionTableEntry entry;
 
         // No entry found -> end of PV
-        if (!entry)
+        if (!transpositionTable.probe(root.getHashKey(), entry))
             break;
 
         // No move found in the entry, so we cannot add to the PV
-        if (entry->getBestMove().empty())
+        if (entry.getBestMove().empty())
             break;
 
         // Repetition draw -> end of PV
@@ -244,10 +476,10 @@ std::vector<Move> Search::extractPv(const Position& pos) const
         // No exact score hash entry to use -> end of PV 
         // If we are very near the root we accept all flags as we absolutely need the move 
         // to be played and a ponder move is very important as well.
-        if (entry->getFlags() != TranspositionTable::Flags::ExactScore && ply >= 2)
+        if (entry.getFlags() != TranspositionTable::Flags::ExactScore && ply >= 2)
             break;
 
-        const auto m = entry->getBestMove();
+        const auto m = entry.getBestMove();
         pv.push_back(m);
         previousHashes.insert(root.getHashKey());
         root.makeMove(m);
@@ -258,16 +490,18 @@ std::vector<Move> Search::extractPv(const Position& pos) const
 
 void Search::go(const Position& root, const SearchParameters& sp)
 {
+    waitForClear();
     std::unique_lock<std::mutex> waitLock(waitMutex);
-    tp.addJob(&Search::think, this, root, sp);
+    tp.addJob(&Search::think, this, root.pack(), sp);
     // Wait here until the search function has started.
     // Think of a chain of commands "go", "stop", "go", "stop" sent within 1 or 2 milliseconds.
     // If this part isn't here, some commands could get lost.
     waitCv.wait(waitLock);
 }
 
-void Search::think(const Position& root, SearchParameters sp)
+void Search::think(PackedPosition packedRoot, SearchParameters sp)
 {
+    const Position root(packedRoot);
     const auto inCheck = root.inCheck();
     auto alpha = -infinity;
     auto beta = infinity;
@@ -277,14 +511,26 @@ void Search::think(const Position& root, SearchParameters sp)
     MoveList rootMoveList;
     std::vector<Move> pv;
     Move bestMove;
+    auto& st = *threads[0];
+    std::vector<std::thread> helpers;
 
-    tbHits = 0;
-    nodeCount = 0;
-    nodesToTimeCheck = 10000;
+    for (auto& t : offloadThreads)
+    {
+        t->resetCounters();
+    }
+    for (auto& t : threads)
+    {
+        t->resetCounters();
+        t->mNodesToTimeCheck = 10000;
+        t->mSelDepth = 1;
+        t->mRepetitionHashes = sp.mHashKeys;
+        t->mHistoryTable.age();
+        t->mCounterMoveTable.clear();
+        t->mKillerTable.clear();
+    }
     contempt[root.getSideToMove()] = -sp.mContempt;
     contempt[!root.getSideToMove()] = sp.mContempt;
     searchNeedsMoreTime = false;
-    selDepth = 1;
     nextSendInfo = 1000;
     searching = true;
     pondering = sp.mPonder;
@@ -292,14 +538,10 @@ void Search::think(const Position& root, SearchParameters sp)
     const auto maxDepth = (sp.mDepth > 0 ? std::min(sp.mDepth + 1, 128) : 128);
     maxNodes = (sp.mNodes > 0 ? sp.mNodes : std::numeric_limits<size_t>::max());
     rootPly = sp.mRootPly;
-    repetitionHashes = sp.mHashKeys;
     cardinality = sp.mSyzygyProbeLimit;
     probeDepth = sp.mSyzygyProbeDepth;
     use50 = sp.mSyzygy50MoveRule;
     transpositionTable.startNewSearch();
-    historyTable.age();
-    counterMoveTable.clear();
-    killerTable.clear();
 
     {
         // Notify the thread which is waiting in "go" that the search has started.
@@ -332,6 +574,8 @@ void Search::think(const Position& root, SearchParameters sp)
         }
     }
 
+    traceEvent(SearchTrace::SearchStart, 0, Move(), 0, 0, targetTime, maxTime);
+
     inCheck ? MoveGen::generateLegalEvasions(pos, rootMoveList)
             : MoveGen::generatePseudoLegalMoves(pos, rootMoveList);
     removeIllegalMoves(pos, rootMoveList, inCheck);
@@ -367,38 +611,48 @@ void Search::think(const Position& root, SearchParameters sp)
 
         if (rootInTb)
         {
-            tbHits = rootMoveList.size();
+            st.mTbHits = rootMoveList.size();
         }
     }
 
     // Get the tt move from a possible previous search.
-    const auto ttEntry = transpositionTable.probe(pos.getHashKey());
-    if (ttEntry)
+    TranspositionTable::TranspositionTableEntry ttEntry;
+    if (transpositionTable.probe(pos.getHashKey(), ttEntry))
     {
-        bestMove = ttEntry->getBestMove();
+        bestMove = ttEntry.getBestMove();
     }
 
-    std::vector<SearchStack> searchStack;
-    for (auto i = 0; i < 128 + 1; ++i)
+    auto ss = &st.mSearchStack[0];
+
+    // Start the helper threads. They search the same root position and share their results with us through the TT.
+    for (auto i = 1; i < static_cast<int>(threads.size()); ++i)
     {
-        searchStack.emplace_back(i);
+        helpers.emplace_back(&Search::helperThink, this, std::ref(*threads[i]), std::cref(root), rootMoveList, maxDepth);
     }
-    auto ss = &searchStack[0];
 
-    repetitionHashes[rootPly] = pos.getHashKey();
+    st.mRepetitionHashes[rootPly] = pos.getHashKey();
+    for (auto& t : offloadThreads)
+    {
+        t->mRepetitionHashes = st.mRepetitionHashes;
+    }
     for (auto depth = 1; depth < maxDepth;)
     {
         const auto lmrNode = (!inCheck && depth >= lmrDepthLimit);
-        const auto killers = killerTable.getKillers(0);
+        const auto killers = st.mKillerTable.getKillers(0);
         auto movesSearched = 0;
         auto bestScore = -mateScore;
 
-        orderRootMoves(pos, rootMoveList, bestMove);
+        traceEvent(SearchTrace::IterationStart, depth, Move(), 0, 0, alpha, beta);
+        orderRootMoves(st, pos, rootMoveList, bestMove);
+        // At depth 1 the root moves only get a quiescence search, so they can all be searched at once on the accelerator.
+        const auto offloaded = depth == 1 && offloadRootQuiescenceSearch(st, pos, rootMoveList, bestMove, bestScore);
         try {
-            for (auto i = 0; i < rootMoveList.size(); ++i) {
+            for (auto i = 0; !offloaded && i < rootMoveList.size(); ++i) {
                 const auto move = selectMove(rootMoveList, i);
-                ++nodeCount;
-                --nodesToTimeCheck;
+                const auto moveStartTime = sw.elapsed<std::chrono::microseconds>();
+                const auto moveStartNodes = st.getNodeCount();
+                st.addNode();
+                --st.mNodesToTimeCheck;
                 searchNeedsMoreTime = i > 0;
 
                 // Start sending currmove info only after one second has elapsed.
@@ -418,20 +672,20 @@ void Search::think(const Position& root, SearchParameters sp)
                 newPosition.makeMove(move);
                 ss->mCurrentMove = move;
                 if (!movesSearched) {
-                    score = newDepth > 0 ? -search<true>(newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
-                                         : -quiescenceSearch(newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
+                    score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
+                                         : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
                 } else {
                     const auto reduction = ((lmrNode && nonCriticalMove) ? lmrReductions[std::min(i, 63)][std::min(depth, 63)] : 0);
-                    score = newDepth - reduction > 0 ? -search<false>(newPosition, newDepth - reduction, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
-                                                     : -quiescenceSearch(newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
+                    score = newDepth - reduction > 0 ? -search<false>(st, newPosition, newDepth - reduction, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
+                                                     : -quiescenceSearch(st, newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
 
                     if (reduction && score > alpha) {
-                        score = newDepth > 0 ? -search<false>(newPosition, newDepth, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
-                                             : -quiescenceSearch(newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
+                        score = newDepth > 0 ? -search<false>(st, newPosition, newDepth, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
+                                             : -quiescenceSearch(st, newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
                     }
                     if (score > alpha && score < beta) {
-                        score = newDepth > 0 ? -search<true>(newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
-                                             : -quiescenceSearch(newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
+                        score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
+                                             : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
                     }
                 }
                 ++movesSearched;
@@ -440,40 +694,46 @@ void Search::think(const Position& root, SearchParameters sp)
                 };
 		/* write the result to all the cores here */
                 while (score >= beta || ((movesSearched == 1) && score <= alpha)) {
-		    int c_id = tp.addEpiphanyJob(result);
+		    int c_id = Accelerator::instance().submit(result);
                     // Don't forget to update history and killer tables.
                     if (!inCheck && score >= beta) {
                       if (quietMove) {
-                        historyTable.addCutoff(pos, move, depth);
-                        killerTable.update(move, 0);
+                        st.mHistoryTable.addCutoff(pos, move, depth);
+                        st.mKillerTable.update(move, 0);
                       }
                       for (int j = 0; j < i; ++j) {
                         const Move move2 = rootMoveList.getMove(j);
                         if (!pos.captureOrPromotion(move2)) {
-                          historyTable.addNotCutoff(pos, move2, depth);
+                          st.mHistoryTable.addNotCutoff(pos, move2, depth);
                         }
                       }
                     }
                     int boundScore = score >= beta ? TranspositionTable::Flags::LowerBoundScore 
                       : TranspositionTable::Flags::UpperBoundScore;
-                    result = tp.joinEpiphanyJob(c_id);
+                    result = Accelerator::instance().join(c_id);
                     alpha = result.alpha;
                     beta = result.beta;
+                    traceEvent(boundScore == TranspositionTable::Flags::LowerBoundScore ? SearchTrace::FailHigh : SearchTrace::FailLow, depth, move, i, score, alpha, beta);
+                    if (*(Move*)result.bestMove != bestMove) {
+                        traceEvent(SearchTrace::BestMoveChange, depth, *(Move*)result.bestMove, i, score);
+                    }
                     bestMove = *(Move*)result.bestMove;
                     searchNeedsMoreTime = result.searchNeedsMoreTime;
-                    delta *= 2;
+                    // Capped, many fail highs or lows in a row would otherwise overflow it to zero and the window would never widen again.
+                    delta = std::min(delta * 2, static_cast<int>(infinity));
                     transpositionTable.save(pos.getHashKey(), 
                                             bestMove, 
                                             realScoreToTtScore(score, 0), 
+                                            TranspositionTable::noStaticEval, 
                                             depth, 
                                             boundScore); 
                     pv = extractPv(pos);
                     listener.infoPv(pv, 
                                      sw.elapsed<std::chrono::milliseconds>(), 
-                                     nodeCount, tbHits, depth, score, 
-                                     boundScore, selDepth);
-                    score = newDepth > 0 ? -search<true>(newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
-                                         : -quiescenceSearch(newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
+                                     getNodeCount(), getTbHits(), depth, score, 
+                                     boundScore, st.mSelDepth);
+                    score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
+                                         : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
 		    result.score = score;
                 }
                 /* Capture: score, move, alpha, beta, pos, depth */
@@ -482,25 +742,32 @@ void Search::think(const Position& root, SearchParameters sp)
                     bestScore = score;
                     // No need to handle the case score >= beta, that is done slightly above
                     if (score > alpha) {
+                        if (move != bestMove) {
+                            traceEvent(SearchTrace::BestMoveChange, depth, move, i, score);
+                        }
                         bestMove = move;
                         alpha = score;
                         transpositionTable.save(pos.getHashKey(), 
                                                 bestMove, 
                                                 realScoreToTtScore(score, 0), 
+                                                TranspositionTable::noStaticEval, 
                                                 depth, 
                                                 TranspositionTable::Flags::ExactScore);
 
                         pv = extractPv(pos);
                         listener.infoPv(pv,
                                         sw.elapsed<std::chrono::milliseconds>(),
-                                        nodeCount,
-                                        tbHits,
+                                        getNodeCount(),
+                                        getTbHits(),
                                         depth,
                                         score,
                                         TranspositionTable::Flags::ExactScore, 
-                                        selDepth);
+                                        st.mSelDepth);
                     }
                 }
+                traceEvent(SearchTrace::RootMove, depth, move, i, score,
+                           sw.elapsed<std::chrono::microseconds>() - moveStartTime,
+                           st.getNodeCount() - moveStartNodes);
             }
         }
         catch (const StopSearchException&)
@@ -511,10 +778,12 @@ void Search::think(const Position& root, SearchParameters sp)
         transpositionTable.save(pos.getHashKey(), 
                                 bestMove, 
                                 realScoreToTtScore(bestScore, 0), 
+                                TranspositionTable::noStaticEval, 
                                 depth, 
                                 TranspositionTable::Flags::ExactScore);
 
         pv = extractPv(pos);
+        traceEvent(SearchTrace::IterationEnd, depth, bestMove, 0, bestScore, st.mSelDepth, movesSearched);
 
         // If there is only one root move then stop searching.
         // Not done if we are in an infinite search or pondering, since we must search for ever in those cases.
@@ -531,12 +800,12 @@ void Search::think(const Position& root, SearchParameters sp)
 
         listener.infoPv(pv,
                         sw.elapsed<std::chrono::milliseconds>(),
-                        nodeCount,
-                        tbHits,
+                        getNodeCount(),
+                        getTbHits(),
                         depth,
                         bestScore,
                         TranspositionTable::Flags::ExactScore,
-                        selDepth);
+                        st.mSelDepth);
 
         // Adjust alpha and beta based on the last score.
         // Don't adjust if depth is low - it's a waste of time.
@@ -563,15 +832,132 @@ void Search::think(const Position& root, SearchParameters sp)
         std::this_thread::sleep_for(dura);
     }
 
-    sw.stop();
     // Make sure that the the flag that we are searching is set to false when we quit.
     // If we somehow reach maximum depth we might not reset the flag otherwise.
+    // This also stops the helper threads.
     searching = false;
+    for (auto& helper : helpers)
+    {
+        helper.join();
+    }
+
+    traceEvent(SearchTrace::SearchEnd, 0, pv.empty() ? Move() : pv[0], 0, 0, trace.getDroppedRecords());
+    trace.flush();
+    sw.stop();
     const auto searchTime = sw.elapsed<std::chrono::milliseconds>();
+    const auto evaluationCacheStatistics = getEvaluationCacheStatistics();
+    listener.infoEvaluationCache(evaluationCacheStatistics.first, evaluationCacheStatistics.second);
+#ifdef SEARCH_STATISTICS
+    listener.infoSearchStatistics(getSearchStatistics());
+#endif
     listener.infoBestMove(pv,
                           searchTime,
-                          nodeCount,
-                          tbHits);
+                          getNodeCount(),
+                          getTbHits());
+}
+
+// Helper threads skip some depths so that they are not all searching the same depth at the same time.
+// Thread i skips depth d if ((d + skipPhase[i]) / skipSize[i]) is odd.
+const std::array<int, 20> skipSize = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+const std::array<int, 20> skipPhase = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+void Search::helperThink(SearchThread& st, const Position& root, MoveList rootMoveList, int maxDepth)
+{
+    const auto skip = (st.mId - 1) % 20;
+    auto ss = &st.mSearchStack[0];
+    auto rng = static_cast<uint32_t>(st.mId * 2654435761u);
+    Move bestMove;
+
+    if (rootMoveList.empty())
+    {
+        return;
+    }
+
+    TranspositionTable::TranspositionTableEntry ttEntry;
+    if (transpositionTable.probe(root.getHashKey(), ttEntry))
+    {
+        bestMove = ttEntry.getBestMove();
+    }
+
+    st.mRepetitionHashes[rootPly] = root.getHashKey();
+    for (auto depth = 1; depth < maxDepth && searching; ++depth)
+    {
+        if (((depth + skipPhase[skip]) / skipSize[skip]) % 2)
+        {
+            continue;
+        }
+
+        auto alpha = -infinity;
+        const auto beta = infinity;
+        auto bestScore = -infinity;
+
+        // Perturb the move ordering a bit so that the helpers don't all search the root moves in the same order.
+        orderRootMoves(st, root, rootMoveList, bestMove);
+        for (auto i = 0; i < rootMoveList.size(); ++i)
+        {
+            if (rootMoveList.getMove(i) != bestMove)
+            {
+                rng ^= rng << 13;
+                rng ^= rng >> 17;
+                rng ^= rng << 5;
+                rootMoveList.setScore(i, rootMoveList.getScore(i) + rng % 16);
+            }
+        }
+
+        try
+        {
+            for (auto i = 0; i < rootMoveList.size(); ++i)
+            {
+                const auto move = selectMove(rootMoveList, i);
+                const auto givesCheck = root.givesCheck(move) != 0;
+                const auto newDepth = depth - 1;
+                int score;
+
+                st.addNode();
+                --st.mNodesToTimeCheck;
+
+                Position newPosition(root);
+                newPosition.makeMove(move);
+                ss->mCurrentMove = move;
+                if (!i)
+                {
+                    score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck, ss + 1)
+                                         : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck, ss + 1);
+                }
+                else
+                {
+                    score = newDepth > 0 ? -search<false>(st, newPosition, newDepth, -alpha - 1, -alpha, givesCheck, ss + 1)
+                                         : -quiescenceSearch(st, newPosition, 0, -alpha - 1, -alpha, givesCheck, ss + 1);
+                    if (score > alpha)
+                    {
+                        score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck, ss + 1)
+                                             : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck, ss + 1);
+                    }
+                }
+
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    if (score > alpha)
+                    {
+                        alpha = score;
+                        bestMove = move;
+                    }
+                }
+            }
+        }
+        catch (const StopSearchException&)
+        {
+            break;
+        }
+
+        transpositionTable.save(root.getHashKey(), 
+                                bestMove, 
+                                realScoreToTtScore(bestScore, 0), 
+                                TranspositionTable::noStaticEval, 
+                                depth, 
+                                TranspositionTable::Flags::ExactScore);
+    }
 }
 
 #ifdef _MSC_VER
@@ -579,7 +965,7 @@ void Search::think(const Position& root, SearchParameters sp)
 #endif
 
 template <bool pvNode>
-int Search::search(const Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss)
+int Search::search(SearchThread& st, Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss)
 {
     assert(alpha < beta);
     assert(depth > 0);
@@ -593,44 +979,52 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
 
     // Small speed optimization, runs fine without it.
     transpositionTable.prefetch(pos.getHashKey());
+    st.count(SearchStatistics::MainSearchNodes);
 
     // Used for sending seldepth info.
-    if (ss->mPly > selDepth) {
-        selDepth = ss->mPly;
+    if (ss->mPly > st.mSelDepth) {
+        st.mSelDepth = ss->mPly;
     }
 
     // Don't go over max ply.
     if (ss->mPly >= maxPly) {
-        return evaluation.evaluate(pos);
+        return st.evaluate(pos);
     }
 
     // Time check things.
-    if (nodesToTimeCheck <= 0) {
-        nodesToTimeCheck = 10000;
-        const auto time = sw.elapsed<std::chrono::milliseconds>();
+    // Only the main thread keeps track of time, helpers just check whether they should stop.
+    if (st.mNodesToTimeCheck <= 0) {
+        st.mNodesToTimeCheck = 10000;
 
-        // Check if we have gone over the node limit.
-        if (nodeCount >= maxNodes) {
-            searching = false;
-        }
+        if (!st.mId) {
+            const auto time = sw.elapsed<std::chrono::milliseconds>();
+            const auto nodeCount = getNodeCount();
 
-        if (!infinite && !pondering) { // Can't stop search if ordered to run indefinitely
-            // First check hard cutoff, then check soft cutoff which depends on the current search situation.
-	    if (time > maxTime || time > (searchNeedsMoreTime ? 5 * targetTime : targetTime)) {
+            // Check if we have gone over the node limit.
+            if (nodeCount >= maxNodes) {
                 searching = false;
-            } else {
-                // TODO: Add easy move here.
+            }
+
+            if (!infinite && !pondering) { // Can't stop search if ordered to run indefinitely
+                // First check hard cutoff, then check soft cutoff which depends on the current search situation.
+                if (time > maxTime || time > (searchNeedsMoreTime ? 5 * targetTime : targetTime)) {
+                    searching = false;
+                } else {
+                    // TODO: Add easy move here.
+                }
+            }
+
+            traceEvent(SearchTrace::TimeCheck, 0, Move(), 0, 0, time, searching);
+
+            if (searching && time >= nextSendInfo) {
+                nextSendInfo += 1000;
+                listener.infoRegular(nodeCount, getTbHits(), time);
             }
         }
 
         if (!searching) {
             throw StopSearchException("allocated time has run out");
         }
-
-        if (time >= nextSendInfo) {
-            nextSendInfo += 1000;
-            listener.infoRegular(nodeCount, tbHits, time);
-        }
     }
 
     // Check for fifty move draws.
@@ -646,7 +1040,7 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     }
 
     // Check for repetition draws. Technically we are checking for 2-fold repetitions instead of 3-fold, but that is enough for game theoric correctness.
-    if (repetitionDraw(pos, ss->mPly)) {
+    if (repetitionDraw(st, pos, ss->mPly)) {
         return contempt[pos.getSideToMove()];
     }
 
@@ -657,15 +1051,20 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
         return alpha;
 
     // Probe the transposition table. 
-    const auto ttEntry = transpositionTable.probe(pos.getHashKey());
-    if (ttEntry) {
-        ttMove = ttEntry->getBestMove();
-        if (ttEntry->getDepth() >= depth) {
-            const auto ttScore = ttScoreToRealScore(ttEntry->getScore(), ss->mPly);
-            const auto ttFlags = ttEntry->getFlags();
+    TranspositionTable::TranspositionTableEntry ttEntry;
+    const auto ttHit = transpositionTable.probe(pos.getHashKey(), ttEntry);
+    st.count(ttHit ? SearchStatistics::TtHits : SearchStatistics::TtMisses);
+    if (ttHit) {
+        ttMove = ttEntry.getBestMove();
+        if (ttEntry.getDepth() >= depth) {
+            const auto ttScore = ttScoreToRealScore(ttEntry.getScore(), ss->mPly);
+            const auto ttFlags = ttEntry.getFlags();
             if (ttFlags == TranspositionTable::Flags::ExactScore
             || (ttFlags == TranspositionTable::Flags::UpperBoundScore && ttScore <= alpha)
 	    || (ttFlags == TranspositionTable::Flags::LowerBoundScore && ttScore >= beta)) {
+                st.count(ttFlags == TranspositionTable::Flags::ExactScore ? SearchStatistics::TtExactCutoffs
+                       : ttFlags == TranspositionTable::Flags::LowerBoundScore ? SearchStatistics::TtLowerBoundCutoffs
+                       : SearchStatistics::TtUpperBoundCutoffs);
                 return ttScore;
             }
         }
@@ -679,7 +1078,7 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
         score = Syzygy::probeWdl(pos, found);
 
         if (found) {
-            ++tbHits;
+            st.addTbHit();
             const auto drawScore = use50 ? 1 : 0;
             score = score < -drawScore ? -minMateScore + ss->mPly
                   : score > drawScore ? minMateScore - ss->mPly
@@ -689,11 +1088,15 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     }
 
     // Get the static evaluation of the position. Not needed in nodes where we are in check.
-    const auto staticEval = (inCheck ? -infinity : evaluation.evaluate(pos));
+    // If the position is in the TT the static evaluation is usually there as well, saving us from calling the evaluation function.
+    const auto staticEval = (inCheck ? -infinity 
+                           : (ttHit && ttEntry.getStaticEval() != TranspositionTable::noStaticEval) ? ttEntry.getStaticEval() 
+                           : st.evaluate(pos));
 
     // Reverse futility pruning / static null move pruning.
     // Not useful in PV-nodes as this tries to search for nodes where score >= beta but in PV-nodes score < beta.
     if (!pvNode && !inCheck && pos.getNonPawnPieceCount(pos.getSideToMove()) && depth <= reverseFutilityDepth && staticEval - reverseFutilityMargin(depth) >= beta) {
+        st.count(SearchStatistics::ReverseFutilityPrunes);
         return staticEval - reverseFutilityMargin(depth);
     }
 
@@ -701,8 +1104,9 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     // Not useful in PV-nodes as this tries to search for nodes where score <= alpha but in PV-nodes score > alpha.
     if (!pvNode && !inCheck && depth <= razoringDepth && staticEval + razoringMargin(depth) <= alpha) {
         const auto razoringAlpha = alpha - razoringMargin(depth);
-        score = quiescenceSearch(pos, 0, razoringAlpha, razoringAlpha + 1, false, ss);
+        score = quiescenceSearch(st, pos, 0, razoringAlpha, razoringAlpha + 1, false, ss);
         if (score <= razoringAlpha) {
+            st.count(SearchStatistics::RazoringPrunes);
             return score;
         }
     }
@@ -712,26 +1116,37 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     // I don't really like the staticEval >= beta condition but the gain in elo is significant so...
     if (!pvNode && ss->mAllowNullMove && !inCheck && depth > 1 && staticEval >= beta && pos.getNonPawnPieceCount(pos.getSideToMove())) {
         const auto R = baseNullReduction + depth / 6;
-        const auto likelyFailLow = ttEntry && ttEntry->getFlags() == TranspositionTable::Flags::UpperBoundScore
-                                && ttEntry->getDepth() >= depth - 1 - R && ttEntry->getScore() <= alpha;
+        const auto likelyFailLow = ttHit && ttEntry.getFlags() == TranspositionTable::Flags::UpperBoundScore
+                                && ttEntry.getDepth() >= depth - 1 - R && ttEntry.getScore() <= alpha;
         if (!likelyFailLow) {
-            repetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
+            st.count(SearchStatistics::NullMoveAttempts);
+            st.mRepetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
             ss->mCurrentMove = Move();
+#ifdef MAKE_UNMAKE
+            auto& newPosition = pos;
+            newPosition.makeNullMove(ss->mUndo);
+#else
             Position newPosition(pos);
             newPosition.makeNullMove();
-            ++nodeCount;
-            --nodesToTimeCheck;
+#endif
+            st.addNode();
+            --st.mNodesToTimeCheck;
             (ss + 1)->mAllowNullMove = false;
-            score = depth - 1 - R > 0 ? -search<false>(newPosition, depth - 1 - R, -beta, -beta + 1, false, ss + 1)
-                : -quiescenceSearch(newPosition, 0, -beta, -beta + 1, false, ss + 1);
+            score = depth - 1 - R > 0 ? -search<false>(st, newPosition, depth - 1 - R, -beta, -beta + 1, false, ss + 1)
+                : -quiescenceSearch(st, newPosition, 0, -beta, -beta + 1, false, ss + 1);
             (ss + 1)->mAllowNullMove = true;
+#ifdef MAKE_UNMAKE
+            pos.unmakeNullMove(ss->mUndo);
+#endif
             if (score >= beta) {
+                st.count(SearchStatistics::NullMoveCutoffs);
                 // Don't return unproven mate scores as they cause some instability.
                 if (isMateScore(score))
                     score = beta;
                 transpositionTable.save(pos.getHashKey(), 
                                         ttMove, 
                                         realScoreToTtScore(score, ss->mPly), 
+                                        staticEval, 
                                         depth, 
                                         TranspositionTable::Flags::LowerBoundScore);
                 return score;
@@ -742,14 +1157,15 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     // Internal iterative deepening.
     if (ttMove.empty() && (pvNode ? depth > 4 : depth > 7)) {
         // We can skip nullmove in IID since if it would have worked we wouldn't be here.
+        st.count(SearchStatistics::IidSearches);
         ss->mAllowNullMove = false;
-        score = search<pvNode>(pos, pvNode ? depth - 2 : depth / 2, alpha, beta, inCheck, ss);
+        score = search<pvNode>(st, pos, pvNode ? depth - 2 : depth / 2, alpha, beta, inCheck, ss);
         ss->mAllowNullMove = true;
 
         // Now probe the TT and get the best move.
-        const auto tte = transpositionTable.probe(pos.getHashKey());
-        if (tte) {
-            ttMove = tte->getBestMove();
+        TranspositionTable::TranspositionTableEntry tte;
+        if (transpositionTable.probe(pos.getHashKey(), tte)) {
+            ttMove = tte.getBestMove();
         }
     }
 
@@ -758,12 +1174,12 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
     const auto lmpNode = (!pvNode && !inCheck && depth <= lmpDepth);
     const auto lmrNode = (!inCheck && depth >= lmrDepthLimit);
     const auto seePruningNode = !pvNode && !inCheck && depth <= seePruningDepth;
-    const auto killers = killerTable.getKillers(ss->mPly);
-    const auto counter = counterMoveTable.getCounterMove(pos, (ss - 1)->mCurrentMove);
+    const auto killers = st.mKillerTable.getKillers(ss->mPly);
+    const auto counter = st.mCounterMoveTable.getCounterMove(pos, (ss - 1)->mCurrentMove);
 
-    MoveSort ms(pos, historyTable, ttMove, killers.first, killers.second, counter, inCheck);
+    MoveSort ms(pos, st.mHistoryTable, ttMove, killers.first, killers.second, counter, inCheck);
 
-    repetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
+    st.mRepetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
     for (auto i = 0;; ++i) {
         const auto move = ms.next();
         if (move.empty()) break;
@@ -776,24 +1192,27 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
                                                               && move != killers.first
                                                               && move != killers.second
                                                               && move != counter;
-        ++nodeCount;
-        --nodesToTimeCheck;
+        st.addNode();
+        --st.mNodesToTimeCheck;
 
         // Futility pruning and late move pruning. Oh, SEE pruning as well.
         if (nonCriticalMove) {
             if (futileNode) {
                 bestScore = std::max(bestScore, staticEval + futilityMargin(depth));
                 ++prunedMoves;
+                st.count(SearchStatistics::FutilityPrunes);
                 continue;
             }
 
             if (lmpNode && i >= lmpMoveCounts[depth]) {
                 ++prunedMoves;
+                st.count(SearchStatistics::LateMovePrunes);
                 continue;
             }
 
             if (seePruningNode && pos.SEE(move) < 0) {
                 ++prunedMoves;
+                st.count(SearchStatistics::SeePrunes);
                 continue;
             }
         }
@@ -802,54 +1221,71 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
             continue;
         }
 
+#ifdef MAKE_UNMAKE
+        auto& newPosition = pos;
+        newPosition.makeMove(move, ss->mUndo);
+#else
         Position newPosition(pos);
         newPosition.makeMove(move);
+#endif
         ss->mCurrentMove = move;
         if (!movesSearched) {
-            score = newDepth > 0 ? -search<pvNode>(newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
-                : -quiescenceSearch(newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
+            score = newDepth > 0 ? -search<pvNode>(st, newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
+                : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
         } else {
             const auto reduction = ((lmrNode && nonCriticalMove) ? lmrReductions[std::min(i, 63)][std::min(depth, 63)] : 0);
+            if (reduction) {
+                st.count(SearchStatistics::ReducedSearches);
+            }
 
-            score = newDepth - reduction > 0 ? -search<false>(newPosition, newDepth - reduction, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
-                                             : -quiescenceSearch(newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
+            score = newDepth - reduction > 0 ? -search<false>(st, newPosition, newDepth - reduction, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
+                                             : -quiescenceSearch(st, newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
 
             // The LMR'd move didn't fail low, drop the reduction because that most likely caused the fail high.
             // If we are in a PV-node the alternative is to open the window first. The more unstable the search the better doing that is.
             // Before the tuned evaluation opening the window was better, after the tuned eval it is worse. Why?
             if (reduction && score > alpha) {
-                score = newDepth > 0 ? -search<false>(newPosition, newDepth, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
-                                     : -quiescenceSearch(newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
+                st.count(SearchStatistics::LmrResearches);
+                score = newDepth > 0 ? -search<false>(st, newPosition, newDepth, -alpha - 1, -alpha, givesCheck != 0, ss + 1)
+                                     : -quiescenceSearch(st, newPosition, 0, -alpha - 1, -alpha, givesCheck != 0, ss + 1);
             }
 
             // If we are in a PV-node this is used to get the exact score for a new PV.
             // Since we used null window on the previous searches the score is only a bound, and this won't do for a PV.
             if (score > alpha && score < beta) {
-                score = newDepth > 0 ? -search<true>(newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
-                                     : -quiescenceSearch(newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
+                score = newDepth > 0 ? -search<true>(st, newPosition, newDepth, -beta, -alpha, givesCheck != 0, ss + 1)
+                                     : -quiescenceSearch(st, newPosition, 0, -beta, -alpha, givesCheck != 0, ss + 1);
             }
         }
+#ifdef MAKE_UNMAKE
+        pos.unmakeMove(move, ss->mUndo);
+#endif
         ++movesSearched;
 
         if (score > bestScore) {
 	  if (score > alpha) {
               if (score >= beta) {
+                  st.count(SearchStatistics::BetaCutoffs);
+                  if (movesSearched == 1) {
+                      st.count(SearchStatistics::FirstMoveBetaCutoffs);
+                  }
                   transpositionTable.save(pos.getHashKey(), 
                                             move, 
                                             realScoreToTtScore(score, ss->mPly), 
+                                            staticEval, 
                                             depth, 
                                             TranspositionTable::Flags::LowerBoundScore);
 
 		  // Updating move ordering heuristics while in check is not good, pollutes tables.
 		  if (!inCheck) {
 		      if (quietMove) {
-                            historyTable.addCutoff(pos, move, depth);
-                            killerTable.update(move, ss->mPly);
-                            counterMoveTable.update(pos, move, (ss - 1)->mCurrentMove);
+                            st.mHistoryTable.addCutoff(pos, move, depth);
+                            st.mKillerTable.update(move, ss->mPly);
+                            st.mCounterMoveTable.update(pos, move, (ss - 1)->mCurrentMove);
                        }
                         for (auto j = 0; j < quietsSearched.size() - 1; ++j)
                         {
-                            historyTable.addNotCutoff(pos, quietsSearched.getMove(j), depth);
+                            st.mHistoryTable.addNotCutoff(pos, quietsSearched.getMove(j), depth);
                         }
                     }
 
@@ -872,12 +1308,12 @@ int Search::search(const Position& pos, int depth, int alpha, int beta, bool inC
         return staticEval; 
     }
 
-    transpositionTable.save(pos.getHashKey(), bestMove, realScoreToTtScore(bestScore, ss->mPly), depth, ttFlag);
+    transpositionTable.save(pos.getHashKey(), bestMove, realScoreToTtScore(bestScore, ss->mPly), staticEval, depth, ttFlag);
 
     return bestScore;
 }
 
-int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss)
+int Search::quiescenceSearch(SearchThread& st, Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss)
 {
     assert(alpha < beta);
     assert(depth <= 0);
@@ -890,10 +1326,11 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
 
     // Small speed optimization, runs fine without it.
     transpositionTable.prefetch(pos.getHashKey());
+    st.count(SearchStatistics::QuiescenceNodes);
 
     // Don't go over max ply.
     if (ss->mPly >= maxPly) {
-        return evaluation.evaluate(pos);
+        return st.evaluate(pos);
     }
 
     // Check for fifty move draws.
@@ -908,7 +1345,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
     }
 
     // Check for repetition draws. 
-    if (repetitionDraw(pos, ss->mPly)) {
+    if (repetitionDraw(st, pos, ss->mPly)) {
         return contempt[pos.getSideToMove()];
     }
 
@@ -923,21 +1360,30 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
     // It seems that when this part was broken then not pruning checks below didn't work either for some reason.
     const auto ttDepth = (inCheck || depth >= 0) ? 0 : -1;
 
-    const auto ttEntry = transpositionTable.probe(pos.getHashKey());
-    if (ttEntry) {
-        bestMove = ttEntry->getBestMove();
-        if (ttEntry->getDepth() >= ttDepth) {
-            const auto ttScore = ttScoreToRealScore(ttEntry->getScore(), ss->mPly);
-            const auto ttFlags = ttEntry->getFlags();
+    TranspositionTable::TranspositionTableEntry ttEntry;
+    const auto ttHit = transpositionTable.probe(pos.getHashKey(), ttEntry);
+    st.count(ttHit ? SearchStatistics::TtHits : SearchStatistics::TtMisses);
+    if (ttHit) {
+        bestMove = ttEntry.getBestMove();
+        if (ttEntry.getDepth() >= ttDepth) {
+            const auto ttScore = ttScoreToRealScore(ttEntry.getScore(), ss->mPly);
+            const auto ttFlags = ttEntry.getFlags();
             if (ttFlags == TranspositionTable::Flags::ExactScore
             || (ttFlags == TranspositionTable::Flags::UpperBoundScore && ttScore <= alpha)
             || (ttFlags == TranspositionTable::Flags::LowerBoundScore && ttScore >= beta))
             {
+                st.count(ttFlags == TranspositionTable::Flags::ExactScore ? SearchStatistics::TtExactCutoffs
+                       : ttFlags == TranspositionTable::Flags::LowerBoundScore ? SearchStatistics::TtLowerBoundCutoffs
+                       : SearchStatistics::TtUpperBoundCutoffs);
                 return ttScore;
             }
         } 
    }
 
+    const auto staticEval = (inCheck ? -infinity 
+                           : (ttHit && ttEntry.getStaticEval() != TranspositionTable::noStaticEval) ? ttEntry.getStaticEval() 
+                           : st.evaluate(pos));
+
     if (inCheck) {
         bestScore = matedInPly(ss->mPly);
         delta = -infinity;
@@ -946,7 +1392,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
             return bestScore;
         }
     } else {
-        bestScore = evaluation.evaluate(pos);
+        bestScore = staticEval;
         if (bestScore > alpha) {
             if (bestScore >= beta) {
                 return bestScore;
@@ -958,13 +1404,13 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
                    : MoveGen::generatePseudoLegalCaptures(pos, moveList, false);
     }
 
-    orderCaptures(pos, moveList, bestMove);
-    repetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
+    orderCaptures(st, pos, moveList, bestMove);
+    st.mRepetitionHashes[rootPly + ss->mPly] = pos.getHashKey();
     for (auto i = 0; i < moveList.size(); ++i) {
         const auto move = selectMove(moveList, i);
         const auto givesCheck = pos.givesCheck(move);
-        ++nodeCount;
-        --nodesToTimeCheck;
+        st.addNode();
+        --st.mNodesToTimeCheck;
 
         // Only prune moves in quiescence search if we are not in check.
         if (!inCheck) {
@@ -973,6 +1419,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
             // SEE pruning. If the move seems to lose material prune it.
             // Since the SEE score is meaningless for discovered checks we don't prune them.
             if (seeScore < 0 && givesCheck != 2) {
+                st.count(SearchStatistics::QuiescenceSeePrunes);
                 continue;
             }
 
@@ -980,6 +1427,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
             // Pruning checks here is too dangerous.
             if (delta + seeScore <= alpha && !givesCheck) {
                 bestScore = std::max(bestScore, delta + seeScore);
+                st.count(SearchStatistics::DeltaPrunes);
                 continue;
             }
         }
@@ -988,9 +1436,15 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
             continue;
         }
 
+#ifdef MAKE_UNMAKE
+        pos.makeMove(move, ss->mUndo);
+        const auto score = -quiescenceSearch(st, pos, depth - 1, -beta, -alpha, givesCheck != 0, ss + 1);
+        pos.unmakeMove(move, ss->mUndo);
+#else
         Position newPosition(pos);
         newPosition.makeMove(move);
-        const auto score = -quiescenceSearch(newPosition, depth - 1, -beta, -alpha, givesCheck != 0, ss + 1);
+        const auto score = -quiescenceSearch(st, newPosition, depth - 1, -beta, -alpha, givesCheck != 0, ss + 1);
+#endif
 
         if (score > bestScore) {
             if (score > alpha) {
@@ -998,6 +1452,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
                     transpositionTable.save(pos.getHashKey(),
                                             move,
                                             realScoreToTtScore(score, ss->mPly),
+                                            staticEval,
                                             ttDepth,
                                             TranspositionTable::Flags::LowerBoundScore);
                     return score;
@@ -1013,6 +1468,7 @@ int Search::quiescenceSearch(const Position& pos, int depth, int alpha, int beta
     transpositionTable.save(pos.getHashKey(), 
                             bestMove, 
                             realScoreToTtScore(bestScore, ss->mPly), 
+                            staticEval, 
                             ttDepth, 
                             ttFlag);
 
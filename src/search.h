@@ -31,6 +31,29 @@ struct task_result {
   bool searchNeedsMoreTime;
 };
 
+/* A position packed into plain old data so that it can be copied to an accelerator as is.
+   Mirrors the piece bitboards of Position, everything else can be recalculated from these. */
+typedef struct packed_position PackedPosition;
+struct packed_position {
+  uint64_t bitboards[12];
+  uint8_t sideToMove;
+  uint8_t castlingRights;
+  uint8_t enPassant;
+  uint8_t fiftyMoveDistance;
+  int16_t gamePly;
+};
+
+/* A quiescence search of a single position. The score and the amount of nodes searched are filled in by the accelerator. */
+typedef struct qsearch_job QSearchJob;
+struct qsearch_job {
+  PackedPosition position;
+  int alpha;
+  int beta;
+  int ply;
+  int score;
+  uint64_t nodes;
+};
+
 int ttScoreToRealScore(int score, int ply);
 int realScoreToTtScore(int score, int ply);
 
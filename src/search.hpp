@@ -21,18 +21,26 @@
 #ifndef SEARCH_HPP_
 #define SEARCH_HPP_
 
+#include <cassert>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <future>
 #include <condition_variable>
 #include "tt.hpp"
 #include "history.hpp"
 #include "killer.hpp"
 #include "counter.hpp"
 #include "evaluation.hpp"
+#include "eval_cache.hpp"
 #include "pht.hpp"
 #include "utils/stopwatch.hpp"
+#include "utils/accelerator.hpp"
 #include "utils/threadpool.hpp"
 #include "search_listener.hpp"
 #include "search_parameters.hpp"
+#include "search_statistics.hpp"
+#include "search_trace.hpp"
 #include "movelist.hpp"
 #include "task.h"
 
@@ -48,8 +56,63 @@
         Move mCurrentMove;
         int mPly;
         bool mAllowNullMove;
+#ifdef MAKE_UNMAKE
+        // The state needed for unmaking the move made at this ply.
+        Position::UndoInfo mUndo;
+#endif
     };
 
+/// @brief Everything a single searcher thread needs for itself. 
+///
+/// Only the transposition table is shared between the searcher threads, everything else is private to the thread owning this.
+/// The node and tablebase hit counters are only written by the owning thread, other threads only read them for reporting.
+struct SearchThread
+{
+    /// @brief Default constructor.
+    /// @param id The id of the thread, the main thread always has id 0.
+    SearchThread(int id);
+
+    /// @brief Get the amount of nodes searched by this thread.
+    uint64_t getNodeCount() const;
+
+    /// @brief Get the amount of tablebase hits by this thread.
+    uint64_t getTbHits() const;
+
+    /// @brief Increment the amount of nodes searched by this thread.
+    void addNode();
+
+    /// @brief Increment the amount of tablebase hits by this thread.
+    void addTbHit();
+
+    /// @brief Reset the node and tablebase hit counters as well as the statistics of the evaluation cache.
+    void resetCounters();
+
+    /// @brief Increment a search statistics counter of this thread. Compiles to nothing unless compiled with SEARCH_STATISTICS.
+    /// @param counter The counter.
+    void count(SearchStatistics::Counter counter);
+
+    /// @brief Evaluate a position, going through the evaluation cache.
+    /// @param pos The position.
+    /// @return The score given by the evaluation function.
+    int evaluate(const Position& pos);
+
+    int mId;
+    Evaluation mEvaluation;
+    EvaluationCache mEvaluationCache;
+    KillerTable mKillerTable;
+    CounterMoveTable mCounterMoveTable;
+    HistoryTable mHistoryTable;
+    std::vector<SearchStack> mSearchStack;
+    std::vector<HashKey> mRepetitionHashes;
+    int mNodesToTimeCheck;
+    int mSelDepth;
+    std::atomic<uint64_t> mNodeCount;
+    std::atomic<uint64_t> mTbHits;
+#ifdef SEARCH_STATISTICS
+    SearchStatistics mStatistics;
+#endif
+};
+
 /// @brief The core of this program, the search function.
 class Search
 {
@@ -67,23 +130,88 @@ public:
     /// Usually the blocking time is very short, 5-10ms at most.
     void go(const Position& root, const SearchParameters& sp);
 
-    /// @brief Clears the TT, PHT, killer table, history table and the counter move table. 
+    /// @brief Clears the TT, PHT, evaluation cache, killer table, history table and the counter move table.
     ///
-    /// Can take a long time with very large TT and PHT.
+    /// The PHTs and evaluation caches of the accelerator workers are cleared as well.
+    /// The tables are zeroed in the background using all cores, so this returns immediately.
+    /// Everything which needs the tables (starting a search, resizing) waits for the clear to finish first.
     void clearSearch();
 
     /// @brief Used for setting the size of the TT. 
     /// @param sizeInMegaBytes The new size of the TT.
     ///
-    /// Can take a long time with a large value of sizeInMegaBytes.
+    /// The new table is zeroed using all cores, but this can still take a while with a large value of sizeInMegaBytes.
     void setTranspositionTableSize(size_t sizeInMegaBytes);
 
+    /// @brief Saves the TT into a snapshot file.
+    /// @param fileName The name of the file.
+    ///
+    /// Throws std::runtime_error on failure. Should not be called while searching.
+    void saveTranspositionTable(const std::string& fileName);
+
+    /// @brief Replaces the TT with the contents of a snapshot file created with saveTranspositionTable.
+    /// @param fileName The name of the file.
+    /// @param verifyChecksum Whether to verify the checksum of the whole table, which requires reading the whole file.
+    ///
+    /// Throws std::runtime_error on failure. Should not be called while searching.
+    void loadTranspositionTable(const std::string& fileName, bool verifyChecksum);
+
+    /// @brief Starts or stops writing a trace of the iterative deepening loop, see SearchTrace.
+    /// @param fileName The name of the trace file, an empty name stops tracing.
+    ///
+    /// Throws std::runtime_error if the file cannot be opened. Should not be called while searching.
+    void setTraceFile(const std::string& fileName);
+
+    /// @brief Used for getting a description of the memory pages backing the TT.
+    /// @return A human-readable description of the page size, e.g. whether huge pages are in use.
+    std::string getTranspositionTablePageInfo() const;
+
     /// @brief Used for setting the size of the PHT. 
     /// @param sizeInMegaBytes The new size of the PHT.
     ///
+    /// Every searcher thread has its own PHT of this size.
     /// Can take a long time with a large value of sizeInMegaBytes.
     void setPawnHashTableSize(size_t sizeInMegaBytes);
 
+    /// @brief Used for setting the size of the evaluation cache.
+    /// @param sizeInMegaBytes The new size, 0 disables the cache.
+    ///
+    /// Every searcher thread has its own cache of this size.
+    void setEvaluationCacheSize(size_t sizeInMegaBytes);
+
+    /// @brief Used for setting the amount of searcher threads.
+    /// @param amountOfThreads The new amount of threads, including the main thread.
+    ///
+    /// Every thread except the main thread is a helper which searches the same root position and communicates through the TT (i.e. Lazy SMP).
+    /// Should not be called while searching.
+    void setThreads(int amountOfThreads);
+
+    /// @brief Selects the accelerator backend jobs are offloaded to.
+    /// @param name The name of the backend, see Accelerator::availableBackends.
+    /// @return True if the backend exists.
+    ///
+    /// Should not be called while searching.
+    bool setAcceleratorBackend(const std::string& name);
+
+    /// @brief Enables or disables offloading the quiescence searches of the root moves at the first iteration to the accelerator.
+    /// @param enabled Whether to offload or not. Has no effect if the accelerator can't run quiescence searches.
+    ///
+    /// The search contexts of the accelerator workers are created when offloading is enabled and freed when it is disabled.
+    /// Should not be called while searching.
+    void setQuiescenceSearchOffload(bool enabled);
+
+    /// @brief Runs quiescence searches of all positions two plies from the root, either one after another on the host or in a batch on the accelerator.
+    /// @param root The root position.
+    /// @param offload Whether to use the accelerator.
+    /// @return A pair of the amount of nodes searched and the time it took, in microseconds.
+    ///
+    /// Used for comparing the NPS of offloading against host-only search. Clears the TT. Should not be called while searching.
+    std::pair<uint64_t, uint64_t> benchmarkQuiescenceSearchOffload(const Position& root, bool offload);
+
+    /// @brief Gets the accelerator jobs are offloaded to. It is shared by all Search objects, see Accelerator::instance.
+    /// @return The accelerator.
+    Accelerator& getAccelerator();
+
     /// @brief Checks if we are currently searching.
     /// @return True if we are searching.
     bool isSearching() const;
@@ -96,23 +224,53 @@ public:
     int extern_task_(int newDepth, Position newPosition, int givesCheck,
 		     void* ss, TaskResult *result);
 
+    // With MAKE_UNMAKE defined these make and unmake the moves on pos instead of copying it, so pos is modified during the call.
+    // It is always restored before returning though.
     template <bool pvNode>
-    int search(const Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss);
+    int search(SearchThread& st, Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss);
 
-    int quiescenceSearch(const Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss);
+    int quiescenceSearch(SearchThread& st, Position& pos, int depth, int alpha, int beta, bool inCheck, SearchStack* ss);
 
 private:
     // Different classes used by the search function.
     ThreadPool tp;
     TranspositionTable transpositionTable;
-    Evaluation evaluation;
-    KillerTable killerTable;
-    CounterMoveTable counterMoveTable;
-    HistoryTable historyTable;
     SearchListener& listener;
     Stopwatch sw;
-
-    void think(const Position& root, SearchParameters searchParameters);
+    SearchTrace trace;
+
+    // Adds an event to the trace if one is being written. Only called from the main thread.
+    void traceEvent(SearchTrace::EventType type, int depth, const Move& move = Move(), int moveNumber = 0, int score = 0, int64_t value1 = 0, int64_t value2 = 0);
+
+    // The searcher threads. The first one is the main thread, the rest are helpers.
+    std::vector<std::unique_ptr<SearchThread>> threads;
+    size_t pawnHashTableSize;
+    size_t evaluationCacheSize;
+
+    // Search contexts of the accelerator workers running quiescence search jobs, one per worker. Empty unless offloading is enabled.
+    std::vector<std::unique_ptr<SearchThread>> offloadThreads;
+    bool quiescenceSearchOffload;
+    void setupOffloadThreads(bool enabled);
+    void runQuiescenceSearchJob(QSearchJob& job, int workerId);
+    bool offloadRootQuiescenceSearch(SearchThread& st, const Position& pos, MoveList& rootMoveList, Move& bestMove, int& bestScore);
+
+    // Result of a clear running in the background. Declared after the tables so that it is destroyed (i.e. waited for) before them.
+    std::future<void> pendingClear;
+    void waitForClear();
+
+    // Takes the root as a packed position, a full Position with the attack maps and the accumulator doesn't fit in a thread pool job slot.
+    void think(PackedPosition packedRoot, SearchParameters searchParameters);
+
+    // The iterative deepening loop of the helper threads.
+    void helperThink(SearchThread& st, const Position& root, MoveList rootMoveList, int maxDepth);
+
+    // Sum the counters of all threads.
+    uint64_t getNodeCount() const;
+    uint64_t getTbHits() const;
+    std::pair<uint64_t, uint64_t> getEvaluationCacheStatistics() const;
+#ifdef SEARCH_STATISTICS
+    SearchStatistics getSearchStatistics() const;
+#endif
 
     // Time allocation variables.
     bool searchNeedsMoreTime;
@@ -122,14 +280,9 @@ private:
     uint64_t maxTime;
     uint64_t maxNodes;
 
-    // Search statistics
-    uint64_t tbHits;
-    uint64_t nodeCount;
-    int selDepth;
-
     // Flags related to stopping the search.
-    bool searching;
-    bool pondering;
+    std::atomic<bool> searching;
+    std::atomic<bool> pondering;
     bool infinite;
 
     // Information related to probing tablebases.
@@ -143,8 +296,7 @@ private:
     // Actually, we check for 2-fold repetitions instead of 3-fold repetitions like FIDE-rules require.
     // If you think about it for a while, you notice that 2-fold is all we need.
     int rootPly;
-    std::vector<HashKey> repetitionHashes;
-    bool repetitionDraw(const Position& pos, int ply) const;
+    bool repetitionDraw(const SearchThread& st, const Position& pos, int ply) const;
 
     // Used for changing the values of draws inside the search.
     std::array<int, 2> contempt;
@@ -160,32 +312,189 @@ private:
     std::condition_variable waitCv;
 
     // Used for ordering root moves.
-    void orderRootMoves(const Position& pos, MoveList& moveList, const Move& ttMove) const;
+    void orderRootMoves(const SearchThread& st, const Position& pos, MoveList& moveList, const Move& ttMove) const;
 
     // Used for ordering captures in the quiescence search.
-    void orderCaptures(const Position& pos, MoveList& moveList, const Move& ttMove) const;
+    void orderCaptures(const SearchThread& st, const Position& pos, MoveList& moveList, const Move& ttMove) const;
 
     // Used for getting the PV out of the TT:
     std::vector<Move> extractPv(const Position& root) const;
 };
 
+inline uint64_t SearchThread::getNodeCount() const
+{
+    return mNodeCount.load(std::memory_order_relaxed);
+}
+
+inline uint64_t SearchThread::getTbHits() const
+{
+    return mTbHits.load(std::memory_order_relaxed);
+}
+
+inline void SearchThread::addNode()
+{
+    // Only the owning thread writes the counter, so a relaxed load and store is enough and avoids a locked instruction.
+    mNodeCount.store(mNodeCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline void SearchThread::addTbHit()
+{
+    mTbHits.store(mTbHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline void SearchThread::resetCounters()
+{
+    mNodeCount.store(0, std::memory_order_relaxed);
+    mTbHits.store(0, std::memory_order_relaxed);
+    mEvaluationCache.resetStatistics();
+#ifdef SEARCH_STATISTICS
+    mStatistics = SearchStatistics();
+    mEvaluation.getPawnHashTable().resetStatistics();
+#endif
+}
+
+inline void SearchThread::count(SearchStatistics::Counter counter)
+{
+#ifdef SEARCH_STATISTICS
+    ++mStatistics.mCounters[counter];
+#else
+    (void)counter;
+#endif
+}
+
+inline int SearchThread::evaluate(const Position& pos)
+{
+    int score;
+
+    if (!mEvaluationCache.probe(pos.getHashKey(), score))
+    {
+        score = mEvaluation.evaluate(pos);
+        mEvaluationCache.save(pos.getHashKey(), score);
+    }
+    assert(score == mEvaluation.evaluate(pos));
+
+    return score;
+}
+
+inline void Search::waitForClear()
+{
+    if (pendingClear.valid())
+    {
+        pendingClear.get();
+    }
+}
+
 inline void Search::clearSearch() 
 { 
-    transpositionTable.clear();
-    evaluation.clearPawnHashTable(); 
-    killerTable.clear(); 
-    historyTable.clear();
-    counterMoveTable.clear();
+    waitForClear();
+    pendingClear = std::async(std::launch::async, [this]()
+    {
+        transpositionTable.clear();
+        for (auto& st : threads)
+        {
+            st->mEvaluation.clearPawnHashTable(); 
+            st->mEvaluationCache.clear();
+            st->mKillerTable.clear(); 
+            st->mHistoryTable.clear();
+            st->mCounterMoveTable.clear();
+        }
+        // The offloaded quiescence searches evaluate through caches of their own.
+        for (auto& st : offloadThreads)
+        {
+            st->mEvaluation.clearPawnHashTable();
+            st->mEvaluationCache.clear();
+        }
+    });
 }
 
 inline void Search::setTranspositionTableSize(size_t sizeInMegaBytes)
 {
+    waitForClear();
     transpositionTable.setSize(sizeInMegaBytes);
 }
 
+inline void Search::setTraceFile(const std::string& fileName)
+{
+    if (fileName.empty())
+    {
+        trace.close();
+    }
+    else
+    {
+        trace.open(fileName);
+    }
+}
+
+inline void Search::traceEvent(SearchTrace::EventType type, int depth, const Move& move, int moveNumber, int score, int64_t value1, int64_t value2)
+{
+    if (trace.isOpen())
+    {
+        trace.record(type, sw.elapsed<std::chrono::microseconds>(), getNodeCount(), depth, move, moveNumber, score, value1, value2);
+    }
+}
+
+inline bool Search::setAcceleratorBackend(const std::string& name)
+{
+    const auto result = Accelerator::select(name);
+    // The new backend can have a different amount of workers.
+    setupOffloadThreads(quiescenceSearchOffload);
+    return result;
+}
+
+inline void Search::setQuiescenceSearchOffload(bool enabled)
+{
+    quiescenceSearchOffload = enabled;
+    setupOffloadThreads(enabled);
+}
+
+inline Accelerator& Search::getAccelerator()
+{
+    return Accelerator::instance();
+}
+
+inline void Search::saveTranspositionTable(const std::string& fileName)
+{
+    waitForClear();
+    transpositionTable.saveToFile(fileName);
+}
+
+inline void Search::loadTranspositionTable(const std::string& fileName, bool verifyChecksum)
+{
+    waitForClear();
+    transpositionTable.loadFromFile(fileName, verifyChecksum);
+}
+
+inline std::string Search::getTranspositionTablePageInfo() const
+{
+    return transpositionTable.getPageInfo();
+}
+
 inline void Search::setPawnHashTableSize(size_t sizeInMegaBytes)
 { 
-    evaluation.setPawnHashTableSize(sizeInMegaBytes);
+    waitForClear();
+    pawnHashTableSize = sizeInMegaBytes;
+    for (auto& st : threads)
+    {
+        st->mEvaluation.setPawnHashTableSize(sizeInMegaBytes);
+    }
+    for (auto& st : offloadThreads)
+    {
+        st->mEvaluation.setPawnHashTableSize(sizeInMegaBytes);
+    }
+}
+
+inline void Search::setEvaluationCacheSize(size_t sizeInMegaBytes)
+{ 
+    waitForClear();
+    evaluationCacheSize = sizeInMegaBytes;
+    for (auto& st : threads)
+    {
+        st->mEvaluationCache.setSize(sizeInMegaBytes);
+    }
+    for (auto& st : offloadThreads)
+    {
+        st->mEvaluationCache.setSize(sizeInMegaBytes);
+    }
 }
 
 inline bool Search::isSearching() const
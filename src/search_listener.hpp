@@ -23,6 +23,7 @@
 
 #include <vector>
 #include "move.hpp"
+#include "search_statistics.hpp"
 
 /// @brief An interface for outputting info during the search.
 class SearchListener
@@ -60,6 +61,17 @@ public:
     /// @param tbHits The current amount of tablebase probes done.
     virtual void infoBestMove(const std::vector<Move>& pv, uint64_t searchTime,
                               uint64_t nodeCount, uint64_t tbHits) = 0;
+
+    /// @brief When we are finishing the search send statistics of the evaluation caches of all threads. Sent right before the best move.
+    /// @param probes The amount of evaluation cache probes done.
+    /// @param hits The amount of probes which found the position in the cache.
+    virtual void infoEvaluationCache(uint64_t probes, uint64_t hits) = 0;
+
+    /// @brief When we are finishing the search send the search statistics summed over all threads. Sent right before the best move.
+    /// @param statistics The statistics.
+    ///
+    /// Only sent when compiled with SEARCH_STATISTICS.
+    virtual void infoSearchStatistics(const SearchStatistics& statistics) = 0;
 };
 
 
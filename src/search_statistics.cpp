@@ -0,0 +1,73 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "search_statistics.hpp"
+#include <sstream>
+
+SearchStatistics::SearchStatistics()
+{
+    mCounters.fill(0);
+}
+
+void SearchStatistics::add(const SearchStatistics& statistics)
+{
+    for (auto i = 0; i < CounterCount; ++i)
+    {
+        mCounters[i] += statistics.mCounters[i];
+    }
+}
+
+const char* SearchStatistics::getName(Counter counter)
+{
+    static const std::array<const char*, CounterCount> names = { {
+        "main_search_nodes", "quiescence_nodes",
+        "tt_hits", "tt_misses", "tt_exact_cutoffs", "tt_lower_bound_cutoffs", "tt_upper_bound_cutoffs",
+        "reverse_futility_prunes", "razoring_prunes", "null_move_attempts", "null_move_cutoffs", "iid_searches",
+        "futility_prunes", "late_move_prunes", "see_prunes", "reduced_searches", "lmr_researches",
+        "beta_cutoffs", "first_move_beta_cutoffs", "quiescence_see_prunes", "delta_prunes",
+        "evaluation_cache_probes", "evaluation_cache_hits", "pawn_hash_table_probes", "pawn_hash_table_hits"
+    } };
+
+    return names[counter];
+}
+
+std::string SearchStatistics::toJson() const
+{
+    // A rate of something which never happened is reported as zero.
+    const auto rate = [](uint64_t part, uint64_t total)
+    {
+        return total ? static_cast<double>(part) / total : 0.0;
+    };
+    std::ostringstream ss;
+
+    ss << "{\"counters\": {";
+    for (auto i = 0; i < CounterCount; ++i)
+    {
+        ss << (i ? ", " : "") << "\"" << getName(static_cast<Counter>(i)) << "\": " << mCounters[i];
+    }
+    ss << "}, \"rates\": {"
+       << "\"tt_hit_rate\": " << rate(mCounters[TtHits], mCounters[TtHits] + mCounters[TtMisses])
+       << ", \"null_move_success_rate\": " << rate(mCounters[NullMoveCutoffs], mCounters[NullMoveAttempts])
+       << ", \"lmr_research_rate\": " << rate(mCounters[LmrResearches], mCounters[ReducedSearches])
+       << ", \"first_move_cutoff_rate\": " << rate(mCounters[FirstMoveBetaCutoffs], mCounters[BetaCutoffs])
+       << ", \"quiescence_node_share\": " << rate(mCounters[QuiescenceNodes], mCounters[MainSearchNodes] + mCounters[QuiescenceNodes])
+       << ", \"evaluation_cache_hit_rate\": " << rate(mCounters[EvaluationCacheHits], mCounters[EvaluationCacheProbes])
+       << ", \"pawn_hash_table_hit_rate\": " << rate(mCounters[PawnHashTableHits], mCounters[PawnHashTableProbes])
+       << "}}";
+
+    return ss.str();
+}
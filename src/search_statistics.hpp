@@ -0,0 +1,84 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file search_statistics.hpp
+/// @author Mikko Aarnos
+
+#ifndef SEARCH_STATISTICS_HPP_
+#define SEARCH_STATISTICS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/// @brief Counters of what happens inside the search, used for finding out why the NPS or the depth reached changes between versions.
+///
+/// Only collected when compiled with SEARCH_STATISTICS, otherwise counting compiles to nothing, see SearchThread::count.
+/// Every searcher thread has its own counters, they are summed when the search ends.
+struct SearchStatistics
+{
+    /// @brief The things counted.
+    enum Counter
+    {
+        MainSearchNodes, ///< Calls to the main search, excluding the root.
+        QuiescenceNodes, ///< Calls to the quiescence search.
+        TtHits, ///< TT probes which found the position, both in the main search and the quiescence search.
+        TtMisses, ///< TT probes which didn't find the position.
+        TtExactCutoffs, ///< Nodes cut off by an exact score from the TT.
+        TtLowerBoundCutoffs, ///< Nodes cut off by a lower bound from the TT.
+        TtUpperBoundCutoffs, ///< Nodes cut off by an upper bound from the TT.
+        ReverseFutilityPrunes, ///< Nodes pruned by reverse futility pruning.
+        RazoringPrunes, ///< Nodes pruned by razoring.
+        NullMoveAttempts, ///< Null move searches done.
+        NullMoveCutoffs, ///< Null move searches which failed high.
+        IidSearches, ///< Internal iterative deepening searches done.
+        FutilityPrunes, ///< Moves pruned by futility pruning.
+        LateMovePrunes, ///< Moves pruned by late move pruning.
+        SeePrunes, ///< Moves pruned by SEE pruning in the main search.
+        ReducedSearches, ///< Moves searched with a late move reduction.
+        LmrResearches, ///< Reduced searches which didn't fail low and were searched again without the reduction.
+        BetaCutoffs, ///< Fail highs in the main search.
+        FirstMoveBetaCutoffs, ///< Fail highs in the main search caused by the first move searched.
+        QuiescenceSeePrunes, ///< Moves pruned by SEE pruning in the quiescence search.
+        DeltaPrunes, ///< Moves pruned by delta pruning in the quiescence search.
+        EvaluationCacheProbes, ///< Evaluation cache probes, taken from the caches when the search ends.
+        EvaluationCacheHits, ///< Evaluation cache hits, taken from the caches when the search ends.
+        PawnHashTableProbes, ///< Pawn hash table probes, taken from the tables when the search ends.
+        PawnHashTableHits, ///< Pawn hash table hits, taken from the tables when the search ends.
+        CounterCount
+    };
+
+    /// @brief Default constructor. Sets all counters to zero.
+    SearchStatistics();
+
+    /// @brief Adds the counters of another set of statistics to these.
+    /// @param statistics The other statistics.
+    void add(const SearchStatistics& statistics);
+
+    /// @brief Get the name of a counter.
+    /// @param counter The counter.
+    /// @return The name in snake case, used as the key in the JSON dump.
+    static const char* getName(Counter counter);
+
+    /// @brief Formats the counters and some rates derived from them, like the TT hit rate and the share of quiescence search nodes, as JSON.
+    /// @return A JSON object on a single line.
+    std::string toJson() const;
+
+    std::array<uint64_t, CounterCount> mCounters;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "search_trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    const char traceMagic[4] = { 'H', 'K', 'T', 'R' };
+    const uint32_t traceVersion = 1;
+
+    // 512kB of records, a search records far less than that in the time it takes the writer to wake up.
+    const size_t bufferCapacity = 16384;
+
+    // How long the writer sleeps when nobody asks it to flush. Waking up more often only costs the search time.
+    const std::chrono::milliseconds writeInterval(50);
+
+    // Saturates instead of wrapping around, the trace is for humans and a wrapped value would only mislead.
+    template <class T>
+    T saturate(int64_t value)
+    {
+        return static_cast<T>(std::max<int64_t>(std::numeric_limits<T>::min(), std::min<int64_t>(value, std::numeric_limits<T>::max())));
+    }
+}
+
+SearchTrace::SearchTrace() : mBuffer(bufferCapacity), mOpen(false), mStop(false), mRecorded(0), mWritten(0), mDropped(0), mFlushRequested(false)
+{
+}
+
+SearchTrace::~SearchTrace()
+{
+    close();
+}
+
+void SearchTrace::open(const std::string& fileName)
+{
+    close();
+
+    mFile.open(fileName, std::ios::binary | std::ios::trunc);
+    const uint32_t header[3] = { traceVersion, static_cast<uint32_t>(sizeof(Record)), 0 };
+    mFile.write(traceMagic, sizeof(traceMagic));
+    mFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+    mFile.flush();
+    if (!mFile)
+    {
+        mFile.close();
+        mFile.clear();
+        throw std::runtime_error("cannot write " + fileName);
+    }
+
+    mRecorded = mWritten = mDropped = 0;
+    mStop = false;
+    mFlushRequested = false;
+    mWriter = std::thread(&SearchTrace::write, this);
+    mOpen = true;
+}
+
+void SearchTrace::close()
+{
+    if (!mWriter.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mOpen = false;
+        mStop = true;
+    }
+    mWake.notify_one();
+    mFlushed.notify_all();
+    mWriter.join();
+    mFile.close();
+    mFile.clear();
+}
+
+void SearchTrace::record(EventType type, uint64_t time, uint64_t nodes, int depth, const Move& move, int moveNumber, int score, int64_t value1, int64_t value2)
+{
+    Record record;
+
+    record.mTime = time;
+    record.mNodes = nodes;
+    record.mValue1 = saturate<int32_t>(value1);
+    record.mValue2 = saturate<int32_t>(value2);
+    record.mMove = move.getRawMove();
+    record.mMoveNumber = saturate<uint16_t>(moveNumber);
+    record.mScore = saturate<int16_t>(score);
+    record.mType = type;
+    record.mDepth = saturate<uint8_t>(depth);
+
+    if (mBuffer.push(record))
+    {
+        mRecorded.store(mRecorded.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    else
+    {
+        mDropped.store(mDropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void SearchTrace::flush()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    mFlushRequested = true;
+    mWake.notify_one();
+    mFlushed.wait(lock, [this] { return !isOpen() || mWritten.load(std::memory_order_acquire) >= mRecorded.load(std::memory_order_relaxed); });
+}
+
+void SearchTrace::write()
+{
+    std::vector<Record> records;
+    Record record;
+
+    records.reserve(bufferCapacity);
+    for (;;)
+    {
+        // Read the flag before draining, so that nothing recorded before close() can be left behind.
+        const auto stop = mStop.load(std::memory_order_acquire);
+
+        while (mBuffer.pop(record))
+        {
+            records.push_back(record);
+        }
+
+        if (!records.empty())
+        {
+            mFile.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+            mFile.flush();
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mWritten.store(mWritten.load(std::memory_order_relaxed) + records.size(), std::memory_order_release);
+            }
+            mFlushed.notify_all();
+            records.clear();
+        }
+        else if (stop)
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait_for(lock, writeInterval, [this] { return mStop.load(std::memory_order_relaxed) || mFlushRequested; });
+        mFlushRequested = false;
+    }
+}
@@ -0,0 +1,140 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file search_trace.hpp
+/// @author Mikko Aarnos
+
+#ifndef SEARCH_TRACE_HPP_
+#define SEARCH_TRACE_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "move.hpp"
+#include "utils/ring_buffer.hpp"
+
+/// @brief A binary trace of what the iterative deepening loop does, used for finding out where the time of a search goes.
+///
+/// The main search thread records fixed-size events into a lock-free ring buffer and a background thread writes them to a file,
+/// so the search never waits for the disk. The writer wakes up every 50 milliseconds or when flushed, whichever comes first. If the writer can't keep up the events which don't fit are dropped and counted.
+/// The file starts with a 16-byte header: the magic "HKTR", the version and the size of a record as 32-bit integers and four reserved bytes.
+/// After that it is nothing but records, see decode_trace.py for turning them into CSV or a Chrome trace.
+class SearchTrace
+{
+public:
+    /// @brief The events recorded. The meaning of the score and the two values depends on the event.
+    enum EventType : uint8_t
+    {
+        SearchStart, ///< A search was started. Values: target time and maximum time in milliseconds.
+        IterationStart, ///< An iteration was started. Values: alpha and beta.
+        RootMove, ///< A root move was searched. Values: the time spent in microseconds and the nodes searched by the main thread.
+        FailHigh, ///< The aspiration window was widened after a fail high. Values: the new alpha and beta.
+        FailLow, ///< The aspiration window was widened after a fail low. Values: the new alpha and beta.
+        BestMoveChange, ///< A new best move was found at the root. Values: none.
+        IterationEnd, ///< An iteration was finished. Values: the selective depth and the amount of root moves searched.
+        TimeCheck, ///< The main thread checked the time limits. Values: the elapsed time in milliseconds and whether the search continues.
+        SearchEnd ///< The search ended. Values: the amount of events dropped since the trace was opened.
+    };
+
+    /// @brief A single event, exactly 32 bytes.
+    struct Record
+    {
+        uint64_t mTime; ///< Microseconds since the start of the search.
+        uint64_t mNodes; ///< The nodes searched by all threads so far.
+        int32_t mValue1;
+        int32_t mValue2;
+        uint16_t mMove; ///< The raw move, 0 if none.
+        uint16_t mMoveNumber; ///< The index of the move in the root move list.
+        int16_t mScore;
+        uint8_t mType; ///< The EventType.
+        uint8_t mDepth;
+    };
+
+    /// @brief Default constructor.
+    SearchTrace();
+
+    /// @brief Destructor, closes the trace.
+    ~SearchTrace();
+
+    /// @brief Starts writing the trace into a file, replacing its contents.
+    /// @param fileName The name of the file.
+    ///
+    /// Throws std::runtime_error if the file cannot be opened. Should not be called while searching.
+    void open(const std::string& fileName);
+
+    /// @brief Writes out the remaining records and closes the file. Does nothing if the trace isn't open.
+    void close();
+
+    /// @brief Checks if the trace is being written.
+    /// @return True if it is.
+    bool isOpen() const;
+
+    /// @brief Adds an event to the trace. Must only be called from one thread at a time.
+    /// @param type The type of the event.
+    /// @param time Microseconds since the start of the search.
+    /// @param nodes The nodes searched so far.
+    /// @param depth The depth of the current iteration.
+    /// @param move The move related to the event.
+    /// @param moveNumber The index of the move in the root move list.
+    /// @param score The score related to the event.
+    /// @param value1 The first event-specific value.
+    /// @param value2 The second event-specific value.
+    void record(EventType type, uint64_t time, uint64_t nodes, int depth, const Move& move, int moveNumber, int score, int64_t value1, int64_t value2);
+
+    /// @brief Blocks until every event recorded so far has been written to the file.
+    void flush();
+
+    /// @brief Get the amount of events dropped because the buffer was full since the trace was opened.
+    /// @return The amount of dropped events.
+    uint64_t getDroppedRecords() const;
+
+private:
+    RingBuffer<Record> mBuffer;
+    std::ofstream mFile;
+    std::thread mWriter;
+    std::atomic<bool> mOpen;
+    std::atomic<bool> mStop;
+    std::atomic<uint64_t> mRecorded;
+    std::atomic<uint64_t> mWritten;
+    std::atomic<uint64_t> mDropped;
+    // Only used for waking up the writer and for waiting for it, the records themselves never take the lock.
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mFlushed;
+    bool mFlushRequested;
+
+    // The loop run by the writer thread.
+    void write();
+};
+
+static_assert(sizeof(SearchTrace::Record) == 32, "the trace file format depends on the size of a record");
+
+inline bool SearchTrace::isOpen() const
+{
+    return mOpen.load(std::memory_order_relaxed);
+}
+
+inline uint64_t SearchTrace::getDroppedRecords() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+#endif
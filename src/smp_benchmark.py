@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+
+# Time-to-depth benchmark for the Lazy SMP search.
+# Searches a fixed set of positions to a fixed depth with 1, 2, 4, 8, 16 and 32 threads
+# and reports the average time to depth and the speedup compared to a single thread.
+# Thread counts above the amount of hardware threads of the machine are skipped,
+# the threads would just take turns on the same cores and the speedups would say nothing about the search.
+#
+# Usage: ./smp_benchmark.py [depth] [hash]
+
+from __future__ import print_function
+
+import multiprocessing
+import subprocess
+import sys
+
+positions = [
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqk2r/2p1bppp/p1np1n2/1p2p3/4P3/1BP2N2/PP1P1PPP/RNBQR1K1 b kq - 0 8",
+    "r4rk1/1q1bbppp/2np1n2/1p2p3/p2PP3/4BN1P/PPBN1PP1/2RQR1K1 w - - 0 18",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+]
+
+threads = [1, 2, 4, 8, 16, 32]
+
+def send(p, command):
+    p.stdin.write((command + "\n").encode())
+    p.stdin.flush()
+
+def wait_for(p, token):
+    while True:
+        line = p.stdout.readline().decode()
+        if not line:
+            raise RuntimeError("engine quit unexpectedly")
+        if line.startswith(token):
+            return line
+
+def time_to_depth(p, fen, depth):
+    send(p, "ucinewgame")
+    send(p, "position fen " + fen)
+    send(p, "go depth " + str(depth))
+    # The line before bestmove contains the total time and nodes of the search.
+    words = wait_for(p, "info time").split()
+    wait_for(p, "bestmove")
+    return int(words[words.index("time") + 1]), int(words[words.index("nodes") + 1])
+
+def main():
+    depth = int(sys.argv[1]) if len(sys.argv) > 1 else 16
+    hash_size = int(sys.argv[2]) if len(sys.argv) > 2 else 256
+
+    p = subprocess.Popen(["./Hakkapeliitta"], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    send(p, "uci")
+    wait_for(p, "uciok")
+    send(p, "setoption name Hash value " + str(hash_size))
+
+    cores = multiprocessing.cpu_count()
+    usable = [t for t in threads if t <= cores]
+    if len(usable) < len(threads):
+        print("only %d hardware threads, skipping %s threads" % (cores, ", ".join(str(t) for t in threads if t > cores)))
+
+    print("threads      time(ms)       nodes     speedup")
+    base = None
+    for t in usable:
+        send(p, "setoption name Threads value " + str(t))
+        send(p, "isready")
+        wait_for(p, "readyok")
+        total_time, total_nodes = 0, 0
+        for fen in positions:
+            time, nodes = time_to_depth(p, fen, depth)
+            total_time += time
+            total_nodes += nodes
+        average = total_time / float(len(positions))
+        base = base or average
+        print("%7d %13.0f %11d %11.2f" % (t, average, total_nodes // len(positions), base / max(average, 1.0)))
+
+    send(p, "quit")
+    p.wait()
+
+if __name__ == "__main__":
+    main()
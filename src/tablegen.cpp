@@ -0,0 +1,143 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Calculates the lookup tables of Bitboards, Zobrist and Evaluation and writes them into a C++ file as constant data.
+// Run at build time, see precomputed_tables.hpp and the Makefile.
+//
+// Usage: tablegen <output file>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "evaluation.hpp"
+
+class TableGenerator
+{
+public:
+    static void write(std::ostream& out)
+    {
+        out << "// Generated by tablegen, do not edit.\n\n"
+            << "#include \"bitboards.hpp\"\n"
+            << "#include \"zobrist.hpp\"\n"
+            << "#include \"evaluation.hpp\"\n\n"
+            << "#ifndef PRECOMPUTED_TABLES\n"
+            << "#error \"precomputed_tables.cpp must be compiled with PRECOMPUTED_TABLES defined\"\n"
+            << "#endif\n\n";
+#ifdef USE_PEXT
+        // The layout of the slider attack tables depends on the backend.
+        out << "#ifndef USE_PEXT\n#error \"precomputed_tables.cpp was generated for the PEXT backend\"\n#endif\n\n";
+#else
+        out << "#ifdef USE_PEXT\n#error \"precomputed_tables.cpp was generated for the magic backend\"\n#endif\n\n";
+#endif
+
+        writeTable(out, "Bitboards::mBits", Bitboards::mBits);
+        writeTable(out, "Bitboards::mKingAttacks", Bitboards::mKingAttacks);
+        writeTable(out, "Bitboards::mKnightAttacks", Bitboards::mKnightAttacks);
+        writeTable(out, "Bitboards::mPawnAttacks", Bitboards::mPawnAttacks);
+        writeTable(out, "Bitboards::mRays", Bitboards::mRays);
+        writeTable(out, "Bitboards::mBetween", Bitboards::mBetween);
+        writeTable(out, "Bitboards::mLines", Bitboards::mLines);
+        writeTable(out, "Bitboards::mPassed", Bitboards::mPassed);
+        writeTable(out, "Bitboards::mBackward", Bitboards::mBackward);
+        writeTable(out, "Bitboards::mIsolated", Bitboards::mIsolated);
+        writeTable(out, "Bitboards::mKingZone", Bitboards::mKingZone);
+        writeTable(out, "Bitboards::mBishopMagics", Bitboards::mBishopMagics);
+        writeTable(out, "Bitboards::mRookMagics", Bitboards::mRookMagics);
+        writeTable(out, "Bitboards::mLookupTable", Bitboards::mLookupTable);
+
+        writeTable(out, "Zobrist::mPieceHashKeys", Zobrist::mPieceHashKeys);
+        writeTable(out, "Zobrist::mMaterialHashKeys", Zobrist::mMaterialHashKeys);
+        writeTable(out, "Zobrist::mCastlingHashKeys", Zobrist::mCastlingHashKeys);
+        writeTable(out, "Zobrist::mEnPassantHashKeys", Zobrist::mEnPassantHashKeys);
+        writeTable(out, "Zobrist::mTurnHashKey", Zobrist::mTurnHashKey);
+        writeTable(out, "Zobrist::mManglingHashKey", Zobrist::mManglingHashKey);
+
+        writeTable(out, "Evaluation::mPieceSquareTableOpening", Evaluation::mPieceSquareTableOpening);
+        writeTable(out, "Evaluation::mPieceSquareTableEnding", Evaluation::mPieceSquareTableEnding);
+    }
+
+private:
+    // decltype keeps the generated definitions in sync with the declarations, including the const added by PRECOMPUTED_TABLE.
+    template <class T>
+    static void writeTable(std::ostream& out, const std::string& name, const T& table)
+    {
+        out << "decltype(" << name << ") " << name << " = ";
+        writeValue(out, table);
+        out << ";\n\n";
+    }
+
+    static void writeValue(std::ostream& out, uint64_t value)
+    {
+        out << "0x" << std::hex << value << std::dec << "ULL";
+    }
+
+    static void writeValue(std::ostream& out, short value)
+    {
+        out << value;
+    }
+
+    // The data pointer is written as an address in the lookup table, which the linker can resolve.
+    static void writeValue(std::ostream& out, const Bitboards::Magic& magic)
+    {
+        out << "{ &Bitboards::mLookupTable[" << (magic.mData - Bitboards::mLookupTable.data()) << "], ";
+        writeValue(out, magic.mMask);
+        out << ", ";
+        writeValue(out, magic.mMagic);
+        out << " }";
+    }
+
+    template <class T, size_t N>
+    static void writeValue(std::ostream& out, const std::array<T, N>& values)
+    {
+        // Eight numbers per line, everything else on lines of their own.
+        const auto perLine = std::is_arithmetic<T>::value ? 8 : 1;
+
+        out << "{ {\n";
+        for (auto i = 0u; i < N; ++i)
+        {
+            writeValue(out, values[i]);
+            out << (i + 1 == N ? "\n" : ((i + 1) % perLine ? ", " : ",\n"));
+        }
+        out << "} }";
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: tablegen <output file>" << std::endl;
+        return 1;
+    }
+
+    Bitboards::staticInitialize();
+    Zobrist::staticInitialize();
+    Evaluation::staticInitialize();
+
+    std::ofstream out(argv[1]);
+    TableGenerator::write(out);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
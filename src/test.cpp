@@ -16,7 +16,9 @@
 */
 
 #include "test.hpp"
+#include <algorithm>
 #include <cctype>
+#include <limits>
 #include <sstream>
 #include "position.hpp"
 #include "evaluation.hpp"
@@ -26,12 +28,21 @@
 Testing::Testing(const std::string& fileName)
 {
     std::ifstream file(fileName);
+
+    readPositions(file, std::numeric_limits<size_t>::max(), positions);
+}
+
+bool Testing::readPositions(std::istream& file, size_t maxPositions, std::vector<std::string>& positions)
+{
     std::string s;
 
-    while (std::getline(file, s))
+    positions.clear();
+    while (positions.size() < maxPositions && std::getline(file, s))
     {
         positions.push_back(s);
     }
+
+    return !positions.empty();
 }
 
 char switchCase(unsigned char c)
@@ -22,6 +22,7 @@
 #define TEST_HPP_
 
 #include <fstream>
+#include <string>
 #include <vector>
 
 /// @brief Contains tests which take a long time to run even in release mode and as such cannot be included in the unit tests.
@@ -31,6 +32,15 @@ public:
     /// @brief Default constructor.
     Testing(const std::string& fileName);
 
+    /// @brief Reads the next positions from a file with one position per line.
+    /// @param file The file.
+    /// @param maxPositions The maximum amount of positions to read.
+    /// @param positions The lines read are put here, replacing its previous contents.
+    /// @return True if anything was read, false at the end of the file.
+    ///
+    /// Used for reading files too large to keep in memory as text in chunks.
+    static bool readPositions(std::istream& file, size_t maxPositions, std::vector<std::string>& positions);
+
     /// @brief Used for checking that the eval is okay even with colors flipped.
     /// @return True if everything is okay, false otherwise.
     bool testReversedEval() const;
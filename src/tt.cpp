@@ -19,13 +19,59 @@
 #include "bitboards.hpp"
 #include <cassert>
 #include <cmath>
-#include <unordered_set>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <vector>
 
-TranspositionTable::TranspositionTable()
+namespace
+{
+    // Layout of a snapshot file: this header, padded to a full page so that the clusters can be mapped directly, followed by the clusters.
+    struct SnapshotHeader
+    {
+        char mMagic[8];
+        uint32_t mVersion;
+        uint16_t mGeneration;
+        uint16_t mPadding;
+        uint64_t mTableSize;
+        uint64_t mZobristFingerprint;
+        uint64_t mChecksum;
+    };
+
+    const char snapshotMagic[8] = { 'H', 'A', 'K', 'K', 'A', 'T', 'T', '\0' };
+    const uint32_t snapshotVersion = 2;
+    const size_t snapshotHeaderSize = 4096;
+    static_assert(sizeof(SnapshotHeader) <= snapshotHeaderSize, "The snapshot header doesn't fit into its page.");
+}
+
+TranspositionTable::TranspositionTable() : 
+mTable(nullptr), mTableSize(0), mMapping(nullptr), mMappingSize(0)
 {
     setSize(32); 
 }
 
+TranspositionTable::~TranspositionTable()
+{
+    freeTable();
+}
+
+void TranspositionTable::freeTable() noexcept
+{
+    if (mMapping)
+    {
+        LargePages::unmapFile(mMapping, mMappingSize);
+    }
+    else
+    {
+        LargePages::deallocate(mTable, mTableSize * sizeof(Cluster));
+    }
+    mTable = nullptr;
+    mTableSize = 0;
+    mMapping = nullptr;
+    mMappingSize = 0;
+}
+
 void TranspositionTable::setSize(size_t sizeInMegaBytes)
 {
     // If size is not a power of two make it the biggest power of two smaller than size.
@@ -34,24 +80,130 @@ void TranspositionTable::setSize(size_t sizeInMegaBytes)
         sizeInMegaBytes = static_cast<size_t>(std::pow(2, std::floor(log2(sizeInMegaBytes))));
     }
 
-    const auto tableSize = ((sizeInMegaBytes * 1024 * 1024) / sizeof(std::array<TranspositionTableEntry, 4>));
-    mTable.clear();
-    mTable.resize(tableSize);
-    mTable.shrink_to_fit();
-    mGeneration = 1;
+    // Free the old table before allocating the new one, both to avoid having two huge tables in memory at once
+    // and to make sure that changes to the page settings take effect even if the size stays the same.
+    const auto oldTableSize = mTableSize;
+    const auto tableSize = ((sizeInMegaBytes * 1024 * 1024) / sizeof(Cluster));
+    freeTable();
+    try
+    {
+        mTable = static_cast<Cluster*>(LargePages::allocate(tableSize * sizeof(Cluster)));
+        mTableSize = tableSize;
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Never leave the search without a table. The memory of the old one was just released, so getting the same amount back should work.
+        mTable = static_cast<Cluster*>(LargePages::allocate(oldTableSize * sizeof(Cluster)));
+        mTableSize = oldTableSize;
+        clear();
+        throw std::runtime_error("not enough memory for a " + std::to_string(sizeInMegaBytes) + " MB hash table, keeping the old size of "
+                               + std::to_string(oldTableSize * sizeof(Cluster) / (1024 * 1024)) + " MB");
+    }
+    clear();
 }
 
 void TranspositionTable::clear()
 {
-    const auto tableSize = mTable.size();
-    mTable.clear();
-    mTable.resize(tableSize);
+    LargePages::zero(mTable, mTableSize * sizeof(Cluster));
     mGeneration = 1;
 }
 
+std::string TranspositionTable::getPageInfo() const
+{
+    return LargePages::describe(mTable);
+}
+
+uint64_t TranspositionTable::checksum(const Cluster* table, size_t tableSize)
+{
+    auto result = 0ULL;
+
+    for (size_t i = 0; i < tableSize; ++i)
+    {
+        for (const auto& entry : table[i])
+        {
+            result = (result ^ entry.getHash()) * 1099511628211ULL;
+            result = (result ^ entry.getData()) * 1099511628211ULL;
+        }
+    }
+
+    return result;
+}
+
+void TranspositionTable::saveToFile(const std::string& fileName) const
+{
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    std::vector<char> headerPage(snapshotHeaderSize, 0);
+    SnapshotHeader header;
+
+    std::memcpy(header.mMagic, snapshotMagic, sizeof(snapshotMagic));
+    header.mVersion = snapshotVersion;
+    header.mGeneration = mGeneration;
+    header.mPadding = 0;
+    header.mTableSize = mTableSize;
+    header.mZobristFingerprint = Zobrist::fingerprint();
+    header.mChecksum = checksum(mTable, mTableSize);
+    std::memcpy(headerPage.data(), &header, sizeof(header));
+
+    file.write(headerPage.data(), headerPage.size());
+    file.write(reinterpret_cast<const char*>(mTable), mTableSize * sizeof(Cluster));
+    if (!file)
+    {
+        throw std::runtime_error("cannot write " + fileName);
+    }
+}
+
+void TranspositionTable::loadFromFile(const std::string& fileName, bool verifyChecksum)
+{
+    size_t fileSize;
+    auto* mapping = static_cast<char*>(LargePages::mapFile(fileName, fileSize));
+    auto* table = reinterpret_cast<Cluster*>(mapping + snapshotHeaderSize);
+    SnapshotHeader header;
+    std::string error;
+
+    if (fileSize >= snapshotHeaderSize)
+    {
+        std::memcpy(&header, mapping, sizeof(header));
+    }
+
+    if (fileSize < snapshotHeaderSize || std::memcmp(header.mMagic, snapshotMagic, sizeof(snapshotMagic)))
+    {
+        error = "not a hash table snapshot";
+    }
+    else if (header.mVersion != snapshotVersion)
+    {
+        error = "unsupported snapshot version " + std::to_string(header.mVersion);
+    }
+    else if (!header.mTableSize || Bitboards::moreThanOneBitSet(header.mTableSize)
+          || fileSize != snapshotHeaderSize + header.mTableSize * sizeof(Cluster))
+    {
+        error = "snapshot size is invalid";
+    }
+    else if (header.mZobristFingerprint != Zobrist::fingerprint())
+    {
+        error = "snapshot was created with different zobrist keys";
+    }
+    else if (verifyChecksum && header.mChecksum != checksum(table, header.mTableSize))
+    {
+        error = "snapshot checksum mismatch";
+    }
+
+    if (!error.empty())
+    {
+        LargePages::unmapFile(mapping, fileSize);
+        throw std::runtime_error(fileName + ": " + error);
+    }
+
+    freeTable();
+    mTable = table;
+    mTableSize = header.mTableSize;
+    mMapping = mapping;
+    mMappingSize = fileSize;
+    mGeneration = header.mGeneration;
+}
+
 void TranspositionTable::prefetch(HashKey hk) const
 {
-    const auto* address = reinterpret_cast<const char*>(&mTable[hk & (mTable.size() - 1)]);
+    const auto* address = reinterpret_cast<const char*>(&mTable[hk & (mTableSize - 1)]);
 #if defined (_MSC_VER) || defined(__INTEL_COMPILER)
     _mm_prefetch(address, _MM_HINT_T0);
 #else
@@ -59,71 +211,96 @@ void TranspositionTable::prefetch(HashKey hk) const
 #endif
 }
 
-void TranspositionTable::save(HashKey hk, const Move& move, int score, int depth, int flags)
+void TranspositionTable::save(HashKey hk, const Move& move, int score, int staticEval, int depth, int flags)
 {
+    const auto generation = static_cast<uint8_t>(mGeneration & 0x3f);
     auto best = move;
-    auto hashEntry = &mTable[hk & (mTable.size() - 1)][0];
+    auto hashEntry = &mTable[hk & (mTableSize - 1)][0];
     auto replace = hashEntry;
+    // Other threads may be writing to the cluster at the same time, so do all decisions on snapshots.
+    TranspositionTableEntry replaceEntry(*replace);
 
     // Determine the least valuable entry to replace.
     for (auto i = 0; i < 4; ++i, ++hashEntry)
     {
+        const TranspositionTableEntry entry(*hashEntry);
+
         // If there already is an entry for this hashkey, replace it immediately.
         // If that entry was any good we wouldn't have gotten here.
-        if ((hashEntry->getHash() ^ hashEntry->getData()) == hk)
+        if ((entry.getHash() ^ entry.getData()) == hk)
         {
             replace = hashEntry;
             if (best.empty())
             {
-                best = hashEntry->getBestMove();
+                best = entry.getBestMove();
+            }
+            if (staticEval == noStaticEval)
+            {
+                staticEval = entry.getStaticEval();
             }
             break;
         }
 
         // First replace entries which are from an older search, if that doesn't work consider depth.
-        if ((hashEntry->getGeneration() == mGeneration)
-          - (replace->getGeneration() == mGeneration)
-          - (hashEntry->getDepth() < replace->getDepth()) < 0)
+        if ((entry.getGeneration() == generation)
+          - (replaceEntry.getGeneration() == generation)
+          - (entry.getDepth() < replaceEntry.getDepth()) < 0)
         {
             replace = hashEntry;
+            replaceEntry = entry;
         }
     }
 
-    replace->setData((static_cast<uint64_t>(best.getRawMove()) | 
-                      static_cast<uint64_t>(mGeneration) << 16 | 
-                      static_cast<uint64_t>(score & 0xffff) << 32 | 
-                      static_cast<uint64_t>(depth & 0xff) << 48) | 
-                      static_cast<uint64_t>(flags) << 56);
+    const auto data = (static_cast<uint64_t>(best.getRawMove()) | 
+                       static_cast<uint64_t>(staticEval & 0xffff) << 16 | 
+                       static_cast<uint64_t>(score & 0xffff) << 32 | 
+                       static_cast<uint64_t>(depth & 0xff) << 48) | 
+                       static_cast<uint64_t>(flags) << 56 |
+                       static_cast<uint64_t>(generation) << 58;
     // Use Dr. Hyatt's lockless hashing to make sure that there are no corrupted TT entries which remain undetected.
-    // Not really necessary until we have multithreading.
-    replace->setHash(hk ^ replace->getData());
-
-    // In multithreaded mode these could potetially fail. Think about that someday, even though we don't HAVE multithreading yet.
-    assert(replace->getBestMove() == best);
-    assert(replace->getGeneration() == mGeneration);
-    assert(replace->getScore() == score);
-    assert(replace->getDepth() == depth);
-    assert(replace->getFlags() == flags);
+    // If another thread writes to the same entry concurrently the hash and data might end up coming from different writes.
+    // In that case the XOR of the two won't match any real hash key and probes will simply miss.
+    replace->setData(data);
+    replace->setHash(hk ^ data);
+
+    TranspositionTableEntry written;
+    written.setData(data);
+    assert(written.getBestMove() == best);
+    assert(written.getGeneration() == generation);
+    assert(written.getStaticEval() == staticEval);
+    assert(written.getScore() == score);
+    assert(written.getDepth() == depth);
+    assert(written.getFlags() == flags);
 }
 
-const TranspositionTable::TranspositionTableEntry* TranspositionTable::probe(HashKey hk) const
+bool TranspositionTable::probe(HashKey hk, TranspositionTableEntry& ttEntry) const
 {
-    const auto* hashEntry = &mTable[hk & (mTable.size() - 1)][0];
+    const auto* hashEntry = &mTable[hk & (mTableSize - 1)][0];
 
     for (auto i = 0; i < 4; ++i, ++hashEntry)
     {
-        if ((hashEntry->getHash() ^ hashEntry->getData()) == hk)
+        // Read both words exactly once, so that the entry we return is the one we validated.
+        const auto hash = hashEntry->getHash();
+        const auto data = hashEntry->getData();
+        if ((hash ^ data) == hk)
         {
-            return hashEntry;
+            ttEntry.setHash(hash);
+            ttEntry.setData(data);
+            return true;
         }
     }
 
-    return nullptr;
+    return false;
 }
 
 void TranspositionTable::startNewSearch() noexcept
 { 
     ++mGeneration; 
+    // Only the lowest six bits are stored and empty entries are all zeroes, so skip the generations which would make them look current.
+    if (!(mGeneration & 0x3f))
+    {
+        ++mGeneration;
+    }
 }
 
 
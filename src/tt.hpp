@@ -23,9 +23,11 @@
 
 #include <cstdint>
 #include <array>
-#include <vector>
+#include <atomic>
+#include <string>
 #include "move.hpp"
 #include "zobrist.hpp"
+#include "utils/large_pages.hpp"
 
 /// @brief Transposition table used for storing previous results of the search function.
 ///
@@ -43,9 +45,16 @@ public:
         Empty = 0, ExactScore = 1, UpperBoundScore = 2, LowerBoundScore = 3
     };
 
+    /// @brief The static evaluation stored for positions which have none, e.g. positions where the side to move is in check.
+    /// Equal to -infinity, which the search uses as the static evaluation of such positions anyway.
+    static const int noStaticEval = -32768;
+
     /// @brief A single entry in the transposition table.
     ///
-    /// Contains the best move, score, generation, depth and flags for a single position encountered in the search.
+    /// Contains the best move, static evaluation, score, depth, flags and generation for a single position encountered in the search.
+    /// Both words are relaxed atomics as several search threads access the same table without locking.
+    /// On x86 relaxed loads and stores compile to plain moves, so this costs nothing in single-threaded mode.
+    /// Torn entries (hash from one write, data from another) are detected with Dr. Hyatt's XOR trick.
     class TranspositionTableEntry
     {
     public:
@@ -54,87 +63,117 @@ public:
         {
         }
 
+        /// @brief Copy constructor. Takes a snapshot of both words, the snapshot might be torn if another thread is writing.
+        TranspositionTableEntry(const TranspositionTableEntry& other) noexcept : mHash(other.getHash()), mData(other.getData())
+        {
+        }
+
+        /// @brief Copy assignment operator. Same caveats as with the copy constructor.
+        TranspositionTableEntry& operator=(const TranspositionTableEntry& other) noexcept
+        {
+            setHash(other.getHash());
+            setData(other.getData());
+            return *this;
+        }
+
         /// @brief Set the hash key of this TT entry.
         void setHash(uint64_t newHash) noexcept 
         { 
-            mHash = newHash; 
+            mHash.store(newHash, std::memory_order_relaxed); 
         }
 
         /// @brief Set the data of this TT entry. This data should be in a packed format.
         void setData(uint64_t newData) noexcept 
         {
-            mData = newData; 
+            mData.store(newData, std::memory_order_relaxed); 
         }
 
         /// @brief Get the hash key of this TT entry.
         /// @return The hash key.
         uint64_t getHash() const noexcept 
         {
-            return mHash; 
+            return mHash.load(std::memory_order_relaxed); 
         }
 
         /// @brief Get the packed data of this TT entry. Not really used as is except for validation of TT entry integrity.
         /// @return The packed data.
         uint64_t getData() const noexcept 
         { 
-            return mData; 
+            return mData.load(std::memory_order_relaxed); 
         }
 
         /// @brief Get the saved best move of this TT entry.
         /// @return The best move. Note that ALL-nodes have no best move.
         Move getBestMove() const noexcept 
         { 
-            return static_cast<uint16_t>(mData); 
+            return static_cast<uint16_t>(getData()); 
         }
 
-        /// @brief Get the generation of this TT entry. Used for TT replacement policy.
-        /// @return The generation.
-        uint16_t getGeneration() const noexcept 
+        /// @brief Get the static evaluation of the position of this TT entry.
+        /// @return The static evaluation, noStaticEval if it is not known.
+        int16_t getStaticEval() const noexcept 
         { 
-            return static_cast<uint16_t>(mData >> 16); 
+            return static_cast<int16_t>(getData() >> 16); 
         }
 
         /// @brief Get the score of this TT entry.
         /// @return The score. Mate scores need to be adjusted.
         int16_t getScore() const noexcept 
         { 
-            return static_cast<int16_t>(mData >> 32); 
+            return static_cast<int16_t>(getData() >> 32); 
         }
 
         /// @brief Get the depth of this TT entry.
         /// @return The depth.
         int8_t getDepth() const noexcept 
         { 
-            return static_cast<int8_t>(mData >> 48);
+            return static_cast<int8_t>(getData() >> 48);
         }
 
         /// @brief Get the flags of this TT entry. 
         /// @return The flags. 
         uint8_t getFlags() const noexcept 
         {
-            return mData >> 56; 
+            return (getData() >> 56) & 3; 
         };
 
+        /// @brief Get the generation of this TT entry. Used for TT replacement policy.
+        /// @return The generation, only the lowest six bits of the generation counter are stored.
+        uint8_t getGeneration() const noexcept 
+        { 
+            return static_cast<uint8_t>(getData() >> 58); 
+        }
+
     private:
-        uint64_t mHash;
-        uint64_t mData; // 16 bits for the best move, 16 bits for the generation (only 4 or so are actually necessary), 16 bits for the score, 8 bits for the depth and 8 bits for the flags (only 2 bits necessary).
+        std::atomic<uint64_t> mHash;
+        std::atomic<uint64_t> mData; // 16 bits for the best move, 16 bits for the static evaluation, 16 bits for the score, 8 bits for the depth, 2 bits for the flags and 6 bits for the generation.
     };
 
     /// @brief Default constructor.
     TranspositionTable();
 
+    /// @brief Destructor.
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
     /// @brief Save some information to the transposition table.
     /// @param hk The hash key for the position the information is for.
     /// @param move The best move in the position. Note that ALL-nodes have no best move by definition.
     /// @param score The score of the position.
+    /// @param staticEval The static evaluation of the position, noStaticEval if not known. An already known static evaluation is kept in that case.
     /// @param depth The depth the position was searched to.
     /// @param flags Flags indicating whether the position is a PV, CUT, or an ALL node.
-    void save(HashKey hk, const Move& move, int score, int depth, int flags);
+    void save(HashKey hk, const Move& move, int score, int staticEval, int depth, int flags);
 
     /// @brief Get the transposition table entry for a given hash key.
     /// @param hk The hash key for the position we want the entry for.
-    /// @return A valid const pointer to the entry if the probe is succesful, a nullptr otherwise. 
-    const TranspositionTableEntry* probe(HashKey hk) const;
+    /// @param ttEntry On a succesful probe a consistent copy of the entry is put here. 
+    /// @return True on a succesful probe, false otherwise.
+    ///
+    /// A copy is returned instead of a pointer so that other threads overwriting the entry cannot change it under our feet.
+    bool probe(HashKey hk, TranspositionTableEntry& ttEntry) const;
 
     /// @brief Load a part of the transposition table into L1/L2 cache. Used as a speed optimization.
     /// @param hk The hash key for the part of the transposition table we want to load to the cache.
@@ -142,11 +181,34 @@ public:
 
     /// @brief Sets the size of the transposition table.
     /// @param sizeInMegaBytes Obviously, the new size of the hash table in megabytes.
+    ///
+    /// Throws std::runtime_error if there is not enough memory. In that case the table keeps its old size but is cleared.
     void setSize(size_t sizeInMegaBytes);
 
     /// @brief Clears the transposition table. Can potentially be an expensive operation.
     void clear();
 
+    /// @brief Describes the kind of memory pages backing the transposition table.
+    /// @return A human-readable description of the page size.
+    std::string getPageInfo() const;
+
+    /// @brief Writes the transposition table into a snapshot file which can later be loaded with loadFromFile.
+    /// @param fileName The name of the file.
+    ///
+    /// Throws std::runtime_error if writing fails. Must not be called while searching.
+    void saveToFile(const std::string& fileName) const;
+
+    /// @brief Replaces the transposition table with the contents of a snapshot file.
+    /// @param fileName The name of the file.
+    /// @param verifyChecksum If true, the checksum of the whole table is verified. This reads the whole file.
+    ///
+    /// The file is memory-mapped and used as the table directly, so loading doesn't copy anything.
+    /// Pages are read from disk lazily as the search touches them and writes go to private copies, the file itself is never modified.
+    /// The size of the table becomes the size of the snapshot.
+    /// Throws std::runtime_error if the file is invalid, e.g. created by a version of the program with different Zobrist keys.
+    /// In that case the old table is left untouched.
+    void loadFromFile(const std::string& fileName, bool verifyChecksum);
+
     /// @brief Used for notifying the TT that we are starting a new search. That information is used in the replacement policy.
     void startNewSearch() noexcept;
 
@@ -156,8 +218,20 @@ private:
     // Also, we have four entries because the common cache line size nowadays is 64 bytes.
     // uint64_t hash * 4 + uint64_t data * 4 = 8 * uint64_t = 64 bytes.
     // Basically this means that a single cluster fits perfectly into the cacheline.
-    std::vector<std::array<TranspositionTableEntry, 4>> mTable;
+    using Cluster = std::array<TranspositionTableEntry, 4>;
+
+    // The table is allocated from huge pages if possible, at large sizes TLB misses dominate the cost of a probe otherwise.
+    // Alternatively the table can live inside a memory-mapped snapshot file, in which case mMapping points to the start of the file.
+    Cluster* mTable;
+    size_t mTableSize;
+    void* mMapping;
+    size_t mMappingSize;
     uint16_t mGeneration;
+
+    void freeTable() noexcept;
+    static uint64_t checksum(const Cluster* table, size_t tableSize);
+
+    static_assert(sizeof(Cluster) == 64, "A TT cluster must fit exactly into a 64 byte cache line.");
 };
 
 #endif
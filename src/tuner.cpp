@@ -0,0 +1,517 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Texel tuning of the evaluation parameters: minimizes the mean squared error between the game results and the results predicted by the evaluation.
+// The positions are resolved with a quiescence search once when they are loaded, after that the loss is only the static evaluation of the resolved positions.
+// The loss is evaluated on all cores, and the parameters of Evaluation::getParameterTables are tuned with local search, one step at a time.
+// The progress is written to stderr and the tuned tables to stdout after every pass, in the format of evaluation.cpp.
+//
+// Usage: tuner <labelled positions> [threads] [passes] [tables to tune, separated by commas]
+//
+// The file of labelled positions has one position per line: a FEN followed by the result of the game, 
+// either as "1-0", "0-1" or "1/2-1/2" or as 1.0, 0.5 or 0.0, in brackets or not.
+// Build with "make tuner".
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bitboards.hpp"
+#include "constants.hpp"
+#include "evaluation.hpp"
+#include "movegen.hpp"
+#include "position.hpp"
+#include "test.hpp"
+#include "zobrist.hpp"
+#include "utils/stopwatch.hpp"
+
+// A resolved position and the result of its game. 34 bytes, so that millions of them fit in memory.
+struct TuningPosition
+{
+    std::array<uint8_t, 32> mBoard; // Two squares per byte, the even square in the lower four bits.
+    uint8_t mSideToMove;
+    uint8_t mResult; // From the point of view of white: 0 for a loss, 1 for a draw and 2 for a win.
+};
+
+TuningPosition compress(const Position& pos, uint8_t result)
+{
+    TuningPosition tp = {};
+
+    for (Square sq = Square::A1; sq <= Square::H8; ++sq)
+    {
+        tp.mBoard[sq / 2] |= static_cast<uint8_t>(pos.getBoard(sq) << (4 * (sq % 2)));
+    }
+    tp.mSideToMove = static_cast<uint8_t>(pos.getSideToMove());
+    tp.mResult = result;
+
+    return tp;
+}
+
+Position decompress(const TuningPosition& tp)
+{
+    PackedPosition packed = {};
+
+    for (auto sq = 0; sq < 64; ++sq)
+    {
+        const auto piece = (tp.mBoard[sq / 2] >> (4 * (sq % 2))) & 15;
+        if (piece != Piece::Empty)
+        {
+            packed.bitboards[piece] |= 1ULL << sq;
+        }
+    }
+    packed.sideToMove = tp.mSideToMove;
+    packed.enPassant = Square::NoSquare;
+
+    return Position(packed);
+}
+
+// Splits a line of the positions file into the FEN and the result. Returns false if the line is not a labelled position.
+bool parseLine(const std::string& line, std::string& fen, uint8_t& result)
+{
+    std::istringstream iss(line);
+    std::string s, label;
+
+    // The board, the side to move, the castling rights and the en passant square. The move counters don't matter for the evaluation.
+    for (auto i = 0; i < 4 && iss >> s; ++i)
+    {
+        fen += std::string(" ", !fen.empty()) + s;
+    }
+    if (std::count(fen.begin(), fen.end(), 'K') != 1 || std::count(fen.begin(), fen.end(), 'k') != 1)
+    {
+        return false;
+    }
+
+    std::getline(iss, label);
+    if (label.find("1-0") != std::string::npos)
+    {
+        result = 2;
+        return true;
+    }
+    if (label.find("0-1") != std::string::npos)
+    {
+        result = 0;
+        return true;
+    }
+    if (label.find("1/2") != std::string::npos)
+    {
+        result = 1;
+        return true;
+    }
+
+    // A number as the last token. Without brackets it must have a decimal point, otherwise it could be a move counter.
+    std::istringstream labelStream(label);
+    while (labelStream >> s);
+    const auto bracketed = s.size() > 2 && s.front() == '[' && s.back() == ']';
+    if (bracketed)
+    {
+        s = s.substr(1, s.size() - 2);
+    }
+    if (bracketed || s.find('.') != std::string::npos)
+    {
+        std::istringstream valueStream(s);
+        double value;
+        if (valueStream >> value && (value == 0.0 || value == 0.5 || value == 1.0))
+        {
+            result = static_cast<uint8_t>(value * 2);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const int maxResolvePly = 16;
+
+// A quiescence search which also returns its principal variation, the moves leading to the quiet position the tuner evaluates.
+// Only winning and equal captures are searched and positions in check are treated as quiet, which is good enough for this.
+int resolve(Evaluation& evaluation, const Position& pos, int alpha, int beta, int ply, std::vector<Move>& pv)
+{
+    auto bestScore = evaluation.evaluate(pos);
+    pv.clear();
+    if (bestScore >= beta || ply >= maxResolvePly || pos.inCheck())
+    {
+        return bestScore;
+    }
+    alpha = std::max(alpha, bestScore);
+
+    MoveList moveList;
+    std::vector<Move> childPv;
+    MoveGen::generatePseudoLegalCaptures(pos, moveList, false);
+    for (auto i = 0; i < moveList.size(); ++i)
+    {
+        const auto move = moveList.getMove(i);
+        if (!pos.legal(move, false) || pos.SEE(move) < 0)
+        {
+            continue;
+        }
+
+        Position newPosition(pos);
+        newPosition.makeMove(move);
+        const auto score = -resolve(evaluation, newPosition, -beta, -alpha, ply + 1, childPv);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            if (score > alpha)
+            {
+                alpha = score;
+                pv.assign(1, move);
+                pv.insert(pv.end(), childPv.begin(), childPv.end());
+                if (score >= beta)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    return bestScore;
+}
+
+class Tuner
+{
+public:
+    Tuner(int threads) :
+    mEvaluatedPositions(0), mEvaluationTime(0)
+    {
+        for (auto i = 0; i < threads; ++i)
+        {
+            mEvaluations.emplace_back(new Evaluation);
+        }
+    }
+
+    // Reads the labelled positions in chunks, resolving every chunk on all threads before reading the next one.
+    void load(const std::string& fileName)
+    {
+        const size_t chunkSize = 65536;
+        std::ifstream file(fileName);
+        std::vector<std::string> lines;
+        uint64_t lineCount = 0;
+        Stopwatch sw;
+
+        if (!file)
+        {
+            throw std::runtime_error("cannot read " + fileName);
+        }
+
+        sw.start();
+        while (Testing::readPositions(file, chunkSize, lines))
+        {
+            std::vector<std::future<std::vector<TuningPosition>>> results;
+            for (size_t i = 0; i < mEvaluations.size(); ++i)
+            {
+                results.push_back(std::async(std::launch::async, &Tuner::resolveLines, std::ref(*mEvaluations[i]), std::cref(lines),
+                                             lines.size() * i / mEvaluations.size(), lines.size() * (i + 1) / mEvaluations.size()));
+            }
+            for (auto& result : results)
+            {
+                const auto positions = result.get();
+                mPositions.insert(mPositions.end(), positions.begin(), positions.end());
+            }
+            lineCount += lines.size();
+        }
+        sw.stop();
+
+        if (mPositions.empty())
+        {
+            throw std::runtime_error(fileName + ": no labelled positions");
+        }
+        std::cerr << "loaded " << mPositions.size() << " positions (" << lineCount - mPositions.size() << " lines skipped) in " 
+                  << sw.elapsed<std::chrono::milliseconds>() << " ms, " << mPositions.size() * sizeof(TuningPosition) / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    // The mean squared error of the predictions of the evaluation with a given scaling constant, calculated on all threads.
+    double loss(double k)
+    {
+        std::vector<std::future<double>> errors;
+        auto sum = 0.0;
+        Stopwatch sw;
+
+        sw.start();
+        for (size_t i = 0; i < mEvaluations.size(); ++i)
+        {
+            errors.push_back(std::async(std::launch::async, &Tuner::errorSum, this, std::ref(*mEvaluations[i]), k,
+                                        mPositions.size() * i / mEvaluations.size(), mPositions.size() * (i + 1) / mEvaluations.size()));
+        }
+        for (auto& error : errors)
+        {
+            sum += error.get();
+        }
+        sw.stop();
+
+        mEvaluatedPositions += mPositions.size();
+        mEvaluationTime += sw.elapsed<std::chrono::microseconds>();
+        return sum / mPositions.size();
+    }
+
+    // Finds the scaling constant which minimizes the loss with the current parameters using golden section search.
+    double findScalingConstant()
+    {
+        const auto ratio = (std::sqrt(5.0) - 1) / 2;
+        auto a = 0.0, b = 4.0;
+        auto c = b - ratio * (b - a), d = a + ratio * (b - a);
+        auto lossC = loss(c), lossD = loss(d);
+
+        for (auto i = 0; i < 25; ++i)
+        {
+            if (lossC < lossD)
+            {
+                b = d;
+                d = c;
+                lossD = lossC;
+                c = b - ratio * (b - a);
+                lossC = loss(c);
+            }
+            else
+            {
+                a = c;
+                c = d;
+                lossC = lossD;
+                d = a + ratio * (b - a);
+                lossD = loss(d);
+            }
+        }
+
+        return (a + b) / 2;
+    }
+
+    // Local search: every parameter is moved by one in both directions and the change is kept if the loss decreases.
+    // Stops after the given amount of passes or when a pass doesn't improve anything.
+    void tune(int passes, const std::vector<std::string>& tableNames)
+    {
+        const auto tables = Evaluation::getParameterTables();
+        std::vector<Evaluation::ParameterTable> tunedTables;
+        std::vector<std::pair<int*, const Evaluation::ParameterTable*>> parameters;
+
+        tunedTables.reserve(tables.size()); // The parameters point into the vector.
+        for (auto& table : tables)
+        {
+            if (tableNames.empty() || std::find(tableNames.begin(), tableNames.end(), table.mName) != tableNames.end())
+            {
+                tunedTables.push_back(table);
+                for (auto& row : table.mRows)
+                {
+                    for (auto value : row)
+                    {
+                        parameters.emplace_back(value, &tunedTables.back());
+                    }
+                }
+            }
+        }
+        if (parameters.empty())
+        {
+            throw std::runtime_error("no such tables");
+        }
+
+        const auto k = findScalingConstant();
+        auto bestLoss = loss(k);
+        std::cerr << "tuning " << parameters.size() << " parameters in " << tunedTables.size() << " tables, k " << k << " loss " << bestLoss << std::endl;
+
+        for (auto pass = 1; pass <= passes; ++pass)
+        {
+            auto changes = 0;
+            for (auto& parameter : parameters)
+            {
+                const auto value = *parameter.first;
+                for (auto step : { 1, -1 })
+                {
+                    if (value + step < parameter.second->mMinimum || value + step > parameter.second->mMaximum)
+                    {
+                        continue;
+                    }
+
+                    *parameter.first = value + step;
+                    Evaluation::parametersChanged();
+                    const auto newLoss = loss(k);
+                    if (newLoss < bestLoss)
+                    {
+                        bestLoss = newLoss;
+                        ++changes;
+                        break;
+                    }
+                    *parameter.first = value;
+                    Evaluation::parametersChanged();
+                }
+            }
+
+            std::cerr << "pass " << pass << " loss " << bestLoss << " changes " << changes 
+                      << " positions/s " << static_cast<uint64_t>(mEvaluatedPositions * 1000000.0 / std::max<uint64_t>(mEvaluationTime, 1)) << std::endl;
+            std::cout << "// Pass " << pass << ", loss " << bestLoss << std::endl;
+            writeTables(std::cout, tunedTables);
+            if (!changes)
+            {
+                break;
+            }
+        }
+    }
+
+private:
+    std::vector<TuningPosition> mPositions;
+    // One per thread, for the material and pawn hash tables.
+    std::vector<std::unique_ptr<Evaluation>> mEvaluations;
+    uint64_t mEvaluatedPositions;
+    uint64_t mEvaluationTime;
+
+    static std::vector<TuningPosition> resolveLines(Evaluation& evaluation, const std::vector<std::string>& lines, size_t begin, size_t end)
+    {
+        std::vector<TuningPosition> positions;
+        std::vector<Move> pv;
+
+        for (auto i = begin; i < end; ++i)
+        {
+            std::string fen;
+            uint8_t result;
+            if (!parseLine(lines[i], fen, result))
+            {
+                continue;
+            }
+
+            Position pos(fen);
+            if (pos.inCheck())
+            {
+                continue;
+            }
+            resolve(evaluation, pos, -mateScore, mateScore, 0, pv);
+            for (auto& move : pv)
+            {
+                pos.makeMove(move);
+            }
+            positions.push_back(compress(pos, result));
+        }
+
+        return positions;
+    }
+
+    // The sum of the squared errors of the positions in [begin, end).
+    // The positions are evaluated in batches, and the errors of a batch are calculated in a branchless loop over arrays, which the compiler vectorizes with -Ofast.
+    double errorSum(Evaluation& evaluation, double k, size_t begin, size_t end)
+    {
+        const size_t batchSize = 256;
+        // The sigmoid is 1 / (1 + 10^(-k * score / 400)), with the base changed to e.
+        const auto scale = static_cast<float>(-k * std::log(10.0) / 400);
+        std::array<float, batchSize> scores, results;
+        auto sum = 0.0;
+
+        // The hash tables contain scores calculated with the old parameters.
+        evaluation.clearMaterialHashTable();
+        evaluation.clearPawnHashTable();
+        for (auto i = begin; i < end; i += batchSize)
+        {
+            const auto count = std::min(batchSize, end - i);
+            for (size_t j = 0; j < count; ++j)
+            {
+                const auto& tp = mPositions[i + j];
+                const auto score = evaluation.evaluate(decompress(tp));
+                scores[j] = static_cast<float>(tp.mSideToMove ? -score : score);
+                results[j] = tp.mResult * 0.5f;
+            }
+
+            auto batchSum = 0.0f;
+            for (size_t j = 0; j < count; ++j)
+            {
+                const auto error = results[j] - 1.0f / (1.0f + std::exp(scale * scores[j]));
+                batchSum += error * error;
+            }
+            sum += batchSum;
+        }
+
+        return sum;
+    }
+
+    static void writeTables(std::ostream& out, const std::vector<Evaluation::ParameterTable>& tables)
+    {
+        for (auto& table : tables)
+        {
+            out << table.mName << " = ";
+            if (table.mDimensions == 0)
+            {
+                out << *table.mRows[0][0] << ";" << std::endl;
+                continue;
+            }
+
+            out << (table.mDimensions == 2 ? "{{" : "{") << std::endl;
+            for (size_t i = 0; i < table.mRows.size(); ++i)
+            {
+                const auto& row = table.mRows[i];
+                const std::string indent(table.mDimensions == 2 ? 8 : 4, ' ');
+                if (table.mDimensions == 2)
+                {
+                    out << "    {" << (row.empty() ? "" : "\n");
+                }
+                for (size_t j = 0; j < row.size(); ++j)
+                {
+                    out << (j ? ", " : indent) << *row[j];
+                }
+                if (table.mDimensions == 2)
+                {
+                    out << (row.empty() ? "}" : "\n    }") << (i + 1 < table.mRows.size() ? "," : "");
+                }
+                out << std::endl;
+            }
+            out << (table.mDimensions == 2 ? "}};" : "};") << std::endl;
+        }
+        out << std::endl;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    Bitboards::staticInitialize();
+    Zobrist::staticInitialize();
+    Evaluation::staticInitialize();
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    auto passes = 100;
+    std::vector<std::string> tableNames;
+    if (argc < 2 
+        || (argc > 2 && (!(std::istringstream(argv[2]) >> threads) || threads < 1))
+        || (argc > 3 && (!(std::istringstream(argv[3]) >> passes) || passes < 1)))
+    {
+        std::cerr << "Usage: tuner <labelled positions> [threads] [passes] [tables to tune, separated by commas]" << std::endl;
+        return 1;
+    }
+    if (argc > 4)
+    {
+        std::istringstream iss(argv[4]);
+        std::string s;
+        while (std::getline(iss, s, ','))
+        {
+            tableNames.push_back(s);
+        }
+    }
+
+    try
+    {
+        Tuner tuner(threads);
+        tuner.load(argv[1]);
+        tuner.tune(passes, tableNames);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -23,13 +23,15 @@
 #include "textio.hpp"
 #include "syzygy/tbprobe.hpp"
 #include "utils/threadpool.hpp"
+#include "utils/large_pages.hpp"
+#include "utils/stopwatch.hpp"
 #include "score.h"
-#include "utils/epiphany.h"
+#include "utils/accelerator.hpp"
 
 UCI::UCI() :
 search(*this), sync_cout(std::cout), ponder(true),
-contempt(0), pawnHashTableSize(4), transpositionTableSize(32), syzygyProbeDepth(1), 
-syzygyProbeLimit(6), syzygy50MoveRule(true), rootPly(0)
+contempt(0), pawnHashTableSize(4), evaluationCacheSize(1), transpositionTableSize(32), largePages(true), numaInterleave(false), quiescenceSearchOffload(false), threads(1), syzygyProbeDepth(1), 
+syzygyProbeLimit(6), syzygy50MoveRule(true), useNetwork(false), rootPly(0)
 {
     addCommand("uci", &UCI::sendInformation);
     addCommand("isready", &UCI::isReady);
@@ -42,6 +44,17 @@ syzygyProbeLimit(6), syzygy50MoveRule(true), rootPly(0)
     addCommand("ponderhit", &UCI::ponderhit);
     addCommand("displayboard", &UCI::displayBoard);
     addCommand("perft", &UCI::perft);
+    addCommand("ttbench", &UCI::ttBenchmark);
+    addCommand("savehash", &UCI::saveHash);
+    addCommand("accelbench", &UCI::acceleratorBenchmark);
+    addCommand("offloadbench", &UCI::offloadBenchmark);
+    addCommand("loadhash", &UCI::loadHash);
+    addCommand("poolbench", &UCI::threadPoolBenchmark);
+    addCommand("sliderbench", &UCI::sliderAttackBenchmark);
+    addCommand("materialbench", &UCI::materialBenchmark);
+    addCommand("pawnbench", &UCI::pawnBenchmark);
+    addCommand("evalbench", &UCI::evaluationBenchmark);
+    addCommand("bench", &UCI::bench);
 
     repetitionHashKeys.assign(1024, 0);
 }
@@ -102,13 +115,27 @@ void UCI::sendInformation(Position&, std::istringstream&)
     // Send all possible options the engine has that can be modified.
     sync_cout << "option name Hash type spin default 32 min 1 max 65536" << std::endl;
     sync_cout << "option name Pawn Hash type spin default 4 min 1 max 8192" << std::endl;
+    sync_cout << "option name Eval Cache type spin default 1 min 0 max 1024" << std::endl;
     sync_cout << "option name Clear Hash type button" << std::endl;
+    sync_cout << "option name Large Pages type check default true" << std::endl;
+    sync_cout << "option name NUMA Interleave type check default false" << std::endl;
+    std::string backends;
+    for (auto& backend : Accelerator::availableBackends())
+    {
+        backends += " var " + backend;
+    }
+    sync_cout << "option name Accelerator type combo default " << Accelerator::availableBackends().front() << backends << std::endl;
+    sync_cout << "option name QSearch Offload type check default false" << std::endl;
+    sync_cout << "option name Threads type spin default 1 min 1 max 128" << std::endl;
     sync_cout << "option name Contempt type spin default 0 min -75 max 75" << std::endl;
     sync_cout << "option name Ponder type check default true" << std::endl;
     sync_cout << "option name SyzygyPath type string default <empty>" << std::endl;
     sync_cout << "option name SyzygyProbeDepth type spin default 1 min 1 max 100" << std::endl;
     sync_cout << "option name SyzygyProbeLimit type spin default 6 min 0 max 6" << std::endl;
     sync_cout << "option name Syzygy50MoveRule type check default true" << std::endl;
+    sync_cout << "option name Eval Engine type combo default Classical var Classical var NNUE" << std::endl;
+    sync_cout << "option name EvalFile type string default <empty>" << std::endl;
+    sync_cout << "option name Trace File type string default <empty>" << std::endl;
 
     // Send a response telling the listener that we are ready in UCI-mode.
     sync_cout << "uciok" << std::endl;
@@ -133,7 +160,7 @@ void UCI::quit(Position&, std::istringstream&)
     exit(0);
 }
 
-void UCI::setOption(Position&, std::istringstream& iss) 
+void UCI::setOption(Position& pos, std::istringstream& iss) 
 {
     std::string name, s;
     
@@ -154,17 +181,81 @@ void UCI::setOption(Position&, std::istringstream& iss)
     else if (name == "Hash")
     {
         iss >> transpositionTableSize;
-        search.setTranspositionTableSize(transpositionTableSize);
+        try
+        {
+            search.setTranspositionTableSize(transpositionTableSize);
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+        sync_cout << "info string hash uses " << search.getTranspositionTablePageInfo() << std::endl;
     }
     else if (name == "Pawn Hash")
     {
         iss >> pawnHashTableSize;
-        search.setPawnHashTableSize(pawnHashTableSize);
+        try
+        {
+            search.setPawnHashTableSize(pawnHashTableSize);
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+    }
+    else if (name == "Eval Cache")
+    {
+        iss >> evaluationCacheSize;
+        try
+        {
+            search.setEvaluationCacheSize(evaluationCacheSize);
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+    }
+    else if (name == "Large Pages" || name == "NUMA Interleave")
+    {
+        iss >> std::boolalpha >> (name == "Large Pages" ? largePages : numaInterleave);
+        LargePages::setEnabled(largePages);
+        LargePages::setNumaInterleave(numaInterleave);
+        // The tables have to be reallocated for the change to have any effect.
+        try
+        {
+            search.setTranspositionTableSize(transpositionTableSize);
+            search.setPawnHashTableSize(pawnHashTableSize);
+            search.setEvaluationCacheSize(evaluationCacheSize);
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+        sync_cout << "info string hash uses " << search.getTranspositionTablePageInfo() << std::endl;
     }
     else if (name == "Clear Hash")
     {
         search.clearSearch();
     }
+    else if (name == "Threads")
+    {
+        iss >> threads;
+        threads = clamp(threads, 1, 128);
+        search.setThreads(threads);
+    }
+    else if (name == "Accelerator")
+    {
+        iss >> s;
+        if (!search.setAcceleratorBackend(s))
+        {
+            sync_cout << "info string no such accelerator backend" << std::endl;
+        }
+    }
+    else if (name == "QSearch Offload")
+    {
+        iss >> std::boolalpha >> quiescenceSearchOffload;
+        search.setQuiescenceSearchOffload(quiescenceSearchOffload);
+    }
     else if (name == "Ponder")
     {
         iss >> ponder;
@@ -192,6 +283,65 @@ void UCI::setOption(Position&, std::istringstream& iss)
     {
         iss >> std::boolalpha >> syzygy50MoveRule;
     }
+    else if (name == "Eval Engine" || name == "EvalFile")
+    {
+        if (name == "Eval Engine")
+        {
+            iss >> s;
+            useNetwork = (s == "NNUE");
+        }
+        else
+        {
+            std::string fileName;
+            while (iss >> s)
+            {
+                fileName += std::string(" ", !fileName.empty()) + s;
+            }
+
+            try
+            {
+                if (fileName.empty() || fileName == "<empty>")
+                {
+                    Nnue::unload();
+                }
+                else
+                {
+                    Nnue::load(fileName);
+                    sync_cout << "info string network loaded from " << fileName << std::endl;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                sync_cout << "info string " << e.what() << std::endl;
+            }
+        }
+
+        if (useNetwork && !Nnue::isLoaded())
+        {
+            sync_cout << "info string no network loaded, using the classical evaluation" << std::endl;
+        }
+        Nnue::setActive(useNetwork && Nnue::isLoaded());
+        pos.refreshAccumulator();
+        // The hash tables contain scores given by the other evaluation function.
+        search.clearSearch();
+    }
+    else if (name == "Trace File")
+    {
+        std::string fileName;
+        while (iss >> s)
+        {
+            fileName += std::string(" ", !fileName.empty()) + s;
+        }
+
+        try
+        {
+            search.setTraceFile(fileName == "<empty>" ? "" : fileName);
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+    }
     else
     {
         sync_cout << "info string no such option exists" << std::endl;
@@ -304,18 +454,368 @@ void UCI::displayBoard(Position& pos, std::istringstream&)
 
 void UCI::perft(Position& pos, std::istringstream& iss)
 {
-    int depth;
+    // Usage: perft <depth> [threads] [hash size in MB]
+    //        perft test [threads] [hash size in MB]
+    // By default as many threads as the Threads option says are used and the perft hash table is off.
+    std::string argument;
+    int depth, threadCount;
+    size_t hashSize;
+
+    if (!(iss >> argument))
+    {
+        sync_cout << "info string argument invalid" << std::endl;
+        return;
+    }
+    if (!(iss >> threadCount))
+    {
+        threadCount = threads;
+    }
+    if (!(iss >> hashSize))
+    {
+        hashSize = 0;
+    }
+    threadCount = clamp(threadCount, 1, 128);
+    hashSize = std::min(hashSize, static_cast<size_t>(65536));
 
-    if (iss >> depth)
+    try
     {
-        const auto result = Benchmark::runPerft(pos, depth);
+        std::pair<uint64_t, uint64_t> result;
+        if (argument == "test")
+        {
+            result = Benchmark::testPerft(threadCount, hashSize);
+        }
+        else if (std::istringstream(argument) >> depth && depth > 0)
+        {
+            result = Benchmark::runPerft(pos, depth, threadCount, hashSize);
+        }
+        else
+        {
+            sync_cout << "info string argument invalid" << std::endl;
+            return;
+        }
+
         sync_cout << "info string nodes " << result.first
                   << " time " << result.second
                   << " nps " << (result.first / (result.second + 1)) * 1000 << std::endl;
     }
-    else
+    catch (const std::exception& e)
+    {
+        sync_cout << "info string " << e.what() << std::endl;
+    }
+}
+
+void UCI::ttBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: ttbench [max threads] [hash size in MB]
+    int maxThreads;
+    size_t hashSize;
+
+    if (!(iss >> maxThreads))
+    {
+        maxThreads = 32;
+    }
+    if (!(iss >> hashSize))
+    {
+        hashSize = 256;
+    }
+    maxThreads = clamp(maxThreads, 1, 128);
+    hashSize = clamp(hashSize, static_cast<size_t>(1), static_cast<size_t>(65536));
+
+    for (auto t = 1; t <= maxThreads; t *= 2)
+    {
+        const auto result = Benchmark::runTranspositionTableBenchmark(t, hashSize, 10000000);
+        sync_cout << "info string threads " << t
+                  << " operations " << result.first
+                  << " time " << result.second
+                  << " ops " << (result.first / (result.second + 1)) * 1000 
+                  << " opsperthread " << (result.first / (result.second + 1)) * 1000 / t << std::endl;
+    }
+}
+
+void UCI::saveHash(Position&, std::istringstream& iss)
+{
+    // Usage: savehash <file>
+    std::string fileName;
+
+    if (search.isSearching() || !(iss >> fileName))
     {
         sync_cout << "info string argument invalid" << std::endl;
+        return;
+    }
+
+    try
+    {
+        Stopwatch sw;
+        sw.start();
+        search.saveTranspositionTable(fileName);
+        sw.stop();
+        sync_cout << "info string hash saved to " << fileName << " time " << sw.elapsed<std::chrono::milliseconds>() << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        sync_cout << "info string " << e.what() << std::endl;
+    }
+}
+
+void UCI::loadHash(Position&, std::istringstream& iss)
+{
+    // Usage: loadhash <file> [verify]
+    std::string fileName, verify;
+
+    if (search.isSearching() || !(iss >> fileName))
+    {
+        sync_cout << "info string argument invalid" << std::endl;
+        return;
+    }
+    iss >> verify;
+
+    try
+    {
+        Stopwatch sw;
+        sw.start();
+        search.loadTranspositionTable(fileName, verify == "verify");
+        sw.stop();
+        sync_cout << "info string hash loaded from " << fileName << " time " << sw.elapsed<std::chrono::milliseconds>() << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        sync_cout << "info string " << e.what() << std::endl;
+    }
+}
+
+void UCI::acceleratorBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: accelbench [jobs]
+    // Measures the backend selected with the Accelerator option.
+    int jobs;
+
+    if (search.isSearching())
+    {
+        sync_cout << "info string cannot benchmark while searching" << std::endl;
+        return;
+    }
+    if (!(iss >> jobs) || jobs <= 0)
+    {
+        jobs = 100000;
+    }
+
+    auto& accelerator = search.getAccelerator();
+    for (auto batchSize : { 1, 4, 16, 64 })
+    {
+        try
+        {
+            sync_cout << "info string accelerator " << accelerator.getName()
+                      << " batch " << batchSize
+                      << " roundtrip " << Benchmark::runAcceleratorBenchmark(accelerator, jobs, batchSize) << " ns/job" << std::endl;
+        }
+        catch (const std::exception& e)
+        {
+            sync_cout << "info string " << e.what() << std::endl;
+        }
+    }
+}
+
+void UCI::threadPoolBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: poolbench [threads] [jobs]
+    int threadCount, jobs;
+
+    if (!(iss >> threadCount))
+    {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if (!(iss >> jobs) || jobs <= 0)
+    {
+        jobs = 1000000;
+    }
+    threadCount = clamp(threadCount, 1, 128);
+
+    for (auto workStealing : { false, true })
+    {
+        const auto result = Benchmark::runThreadPoolBenchmark(workStealing, threadCount, jobs);
+        sync_cout << "info string pool " << (workStealing ? "workstealing" : "mutexqueue")
+                  << " threads " << threadCount
+                  << " latency " << result.mLatency << " ns"
+                  << " external " << result.mExternalThroughput << " jobs/s"
+                  << " nested " << result.mNestedThroughput << " jobs/s" << std::endl;
+    }
+}
+
+void UCI::sliderAttackBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: sliderbench [iterations]
+    uint64_t iterations;
+
+    if (!(iss >> iterations) || !iterations)
+    {
+        iterations = 10000000;
+    }
+
+    const auto result = Benchmark::runSliderAttackBenchmark(iterations);
+#ifdef USE_PEXT
+    const auto backend = "pext";
+#else
+    const auto backend = "magic";
+#endif
+    sync_cout << "info string slider attacks " << backend
+              << " lookups " << result.first
+              << " time " << result.second
+              << " lookupspersecond " << (result.first / (result.second + 1)) * 1000 << std::endl;
+}
+
+void UCI::materialBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: materialbench [iterations]
+    int iterations;
+
+    if (!(iss >> iterations) || iterations <= 0)
+    {
+        iterations = 100;
+    }
+
+    const auto result = Benchmark::runMaterialBenchmark(iterations);
+    sync_cout << "info string material positions " << result.mPositions
+              << " unorderedset " << result.mUnorderedSetRate << " lookups/s"
+              << " materialhash " << result.mMaterialHashTableRate << " probes/s"
+              << " evaluation " << result.mEvaluationRate << " evals/s" << std::endl;
+}
+
+void UCI::pawnBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: pawnbench [depth] [iterations]
+    int depth, iterations;
+
+    if (!(iss >> depth) || depth <= 0)
+    {
+        depth = 3;
+    }
+    if (!(iss >> iterations) || iterations <= 0)
+    {
+        iterations = 100;
+    }
+
+    const auto result = Benchmark::runPawnBenchmark(depth, iterations);
+    sync_cout << "info string pawn positions " << result.mPositions
+              << " probes " << result.mProbes
+              << " hits " << result.mHits
+              << " hitrate " << (result.mHits * 1000 / std::max<uint64_t>(result.mProbes, 1)) / 10.0 << "%"
+              << " firstpass " << result.mFirstPassTime << " ns/eval"
+              << " allhits " << result.mHitTime << " ns/eval" << std::endl;
+}
+
+void UCI::evaluationBenchmark(Position&, std::istringstream& iss)
+{
+    // Usage: evalbench [iterations]
+    static const std::array<std::string, 3> names = { "generic", "sse4.2", "avx2" };
+    int iterations;
+
+    if (!(iss >> iterations) || iterations <= 0)
+    {
+        iterations = 100;
+    }
+
+    for (auto& result : Benchmark::runEvaluationBenchmark(iterations))
+    {
+        sync_cout << "info string evaluation " << names[static_cast<int>(result.mInstructionSet)]
+                  << " cycles/eval " << result.mCyclesPerEvaluation
+                  << " checksum " << result.mChecksum << std::endl;
+    }
+
+    for (auto& result : Benchmark::runNnueBenchmark(iterations))
+    {
+        sync_cout << "info string nnue " << (result.mVectorized ? "avx2" : "generic")
+                  << " evals/s " << result.mEvaluationsPerSecond
+                  << " refresh " << result.mRefreshTime << " ns"
+                  << " checksum " << result.mChecksum << std::endl;
+    }
+}
+
+void UCI::bench(Position&, std::istringstream& iss)
+{
+    runBenchmark(iss);
+}
+
+int UCI::runBenchmark(std::istringstream& iss)
+{
+    // Usage: bench [hash size in MB] [threads] [depth] [expected node count]
+    // Defaults are 16 MB, 1 thread and depth 12. The node count is the signature of the search, which only changes when the search or evaluation does.
+    // If the expected node count is given and differs from the actual one we return 2, so that scripts can catch unintended changes.
+    size_t hashSize;
+    int threadCount, depth;
+    uint64_t expectedNodes;
+
+    if (!(iss >> hashSize))
+    {
+        hashSize = 16;
+    }
+    if (!(iss >> threadCount))
+    {
+        threadCount = 1;
+    }
+    if (!(iss >> depth))
+    {
+        depth = 12;
+    }
+    if (!(iss >> expectedNodes))
+    {
+        expectedNodes = 0;
+    }
+    if (hashSize < 1 || hashSize > 65536 || threadCount < 1 || threadCount > 128 || depth < 1 || depth > 100)
+    {
+        sync_cout << "info string usage: bench [hash size in MB] [threads] [depth] [expected node count]" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const auto result = Benchmark::runSearchBenchmark(hashSize, threadCount, depth);
+        sync_cout << "info string bench positions " << result.mPositions
+                  << " depth " << depth
+                  << " hash " << hashSize
+                  << " threads " << threadCount
+                  << " evaluation " << (Nnue::isActive() ? "nnue" : "classical") << std::endl;
+        sync_cout << "info string bench nodes " << result.mNodes
+                  << " time " << result.mTime
+                  << " nps " << result.mNodes * 1000 / (result.mTime + 1) << std::endl;
+
+        if (expectedNodes && result.mNodes != expectedNodes)
+        {
+            sync_cout << "info string bench signature mismatch: expected " << expectedNodes << " nodes" << std::endl;
+            return 2;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        sync_cout << "info string " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+void UCI::offloadBenchmark(Position& pos, std::istringstream&)
+{
+    // Usage: offloadbench
+    // Compares quiescence searching all positions two plies from the current position on the host against doing it on the accelerator.
+    if (search.isSearching())
+    {
+        sync_cout << "info string cannot benchmark while searching" << std::endl;
+        return;
+    }
+
+    const auto canOffload = search.getAccelerator().supportsQuiescenceSearch();
+    if (!canOffload)
+    {
+        sync_cout << "info string accelerator " << search.getAccelerator().getName() << " cannot run quiescence searches" << std::endl;
+    }
+
+    for (auto offload : { false, canOffload })
+    {
+        const auto result = search.benchmarkQuiescenceSearchOffload(pos, offload);
+        sync_cout << "info string " << (offload ? search.getAccelerator().getName() : std::string("host-only"))
+                  << " nodes " << result.first
+                  << " time " << result.second / 1000
+                  << " nps " << result.first * 1000000 / (result.second + 1) << std::endl;
     }
 }
 
@@ -379,3 +879,17 @@ void UCI::infoBestMove(const std::vector<Move>& pv, uint64_t searchTime,
               << "bestmove " << moveToUciFormat(pv[0])
               << " ponder " << (pv.size() > 1 ? moveToUciFormat(pv[1]) : "(none)") << std::endl;
 }
+
+void UCI::infoEvaluationCache(uint64_t probes, uint64_t hits)
+{
+    sync_cout << "info string evalcache probes " << probes
+              << " hits " << hits
+              << " hitrate " << (hits * 1000 / (probes + 1)) / 10.0 << "%" << std::endl;
+}
+
+void UCI::infoSearchStatistics(const SearchStatistics& statistics)
+{
+    // A single line so that scripts can pick it up with grep and feed everything after "statistics" to a JSON parser.
+    sync_cout << "info string statistics " << statistics.toJson() << std::endl;
+}
+
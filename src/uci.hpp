@@ -38,6 +38,13 @@ public:
     /// @brief Enter the event loop. There is no way to return from this function.
     void mainLoop();
 
+    /// @brief Runs the search benchmark and reports its results.
+    /// @param iss The arguments: [hash size in MB] [threads] [depth] [expected node count].
+    /// @return The exit code for the program: 0 on success, 1 on invalid arguments or errors, 2 if the node count differs from the expected one.
+    ///
+    /// Used both by the bench command and when the program is started with "bench" as the first argument.
+    int runBenchmark(std::istringstream& iss);
+
 private:
     using FunctionPointer = void(UCI::*)(Position& pos, std::istringstream& iss);
 
@@ -57,6 +64,17 @@ private:
     void ponderhit(Position& pos, std::istringstream& iss);
     void displayBoard(Position& pos, std::istringstream& iss);
     void perft(Position& pos, std::istringstream& iss);
+    void ttBenchmark(Position& pos, std::istringstream& iss);
+    void saveHash(Position& pos, std::istringstream& iss);
+    void acceleratorBenchmark(Position& pos, std::istringstream& iss);
+    void offloadBenchmark(Position& pos, std::istringstream& iss);
+    void loadHash(Position& pos, std::istringstream& iss);
+    void threadPoolBenchmark(Position& pos, std::istringstream& iss);
+    void sliderAttackBenchmark(Position& pos, std::istringstream& iss);
+    void materialBenchmark(Position& pos, std::istringstream& iss);
+    void pawnBenchmark(Position& pos, std::istringstream& iss);
+    void evaluationBenchmark(Position& pos, std::istringstream& iss);
+    void bench(Position& pos, std::istringstream& iss);
 
     Search search;
     synchronized_ostream sync_cout;
@@ -65,10 +83,16 @@ private:
     bool ponder;
     int contempt;
     size_t pawnHashTableSize;
+    size_t evaluationCacheSize;
     size_t transpositionTableSize;
+    bool largePages;
+    bool numaInterleave;
+    bool quiescenceSearchOffload;
+    int threads;
     int syzygyProbeDepth;
     int syzygyProbeLimit;
     bool syzygy50MoveRule;
+    bool useNetwork;
 
     // History of the current position, if any.
     int rootPly;
@@ -82,6 +106,8 @@ private:
                         int depth, int score, int flags, int selDepth);
     virtual void infoBestMove(const std::vector<Move>& pv, uint64_t searchTime, 
                               uint64_t nodeCount, uint64_t tbHits);
+    virtual void infoEvaluationCache(uint64_t probes, uint64_t hits);
+    virtual void infoSearchStatistics(const SearchStatistics& statistics);
 };
 
 #endif
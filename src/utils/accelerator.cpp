@@ -0,0 +1,377 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "accelerator.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "../task.h"
+#ifdef HAS_EPIPHANY
+#include "epiphany.h"
+#endif
+
+void Accelerator::submitBatch(const TaskResult* jobs, int count, int* coreIds)
+{
+    for (auto i = 0; i < count; ++i)
+    {
+        coreIds[i] = submit(jobs[i]);
+    }
+}
+
+namespace
+{
+    // Emulates the accelerator on the host by running task() on a pool of worker threads.
+    // Every emulated core has a mailbox like the real cores have in their local memory: a done flag and the job.
+    // The workers also run quiescence search jobs, which the real hardware has no kernel for.
+    class HostAccelerator : public Accelerator
+    {
+    public:
+        HostAccelerator() :
+        mTerminate(false), mNextCore(0), mPendingQuiescenceSearches(0)
+        {
+            for (auto& core : mCores)
+            {
+                core.mDone = true;
+            }
+
+            const auto workerCount = std::max(1u, std::min(static_cast<unsigned int>(coreCount), std::thread::hardware_concurrency()));
+            for (auto i = 0u; i < workerCount; ++i)
+            {
+                mWorkers.emplace_back(&HostAccelerator::loop, this, i);
+            }
+        }
+
+        ~HostAccelerator()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mQueueMutex);
+                mTerminate = true;
+            }
+            mCv.notify_all();
+            for (auto& worker : mWorkers)
+            {
+                worker.join();
+            }
+        }
+
+        std::string getName() const override
+        {
+            return "Host";
+        }
+
+        int getCoreCount() const override
+        {
+            return coreCount;
+        }
+
+        int submit(const TaskResult& job) override
+        {
+            int coreId;
+            submitBatch(&job, 1, &coreId);
+            return coreId;
+        }
+
+        // Fill all mailboxes first and wake up the workers only once, that is where batching saves time.
+        void submitBatch(const TaskResult* jobs, int count, int* coreIds) override
+        {
+            for (auto i = 0; i < count; ++i)
+            {
+                const auto coreId = mNextCore;
+                mNextCore = (mNextCore + 1) % coreCount;
+                auto& core = mCores[coreId];
+
+                if (!core.mDone.load(std::memory_order_acquire))
+                {
+                    // The batch is bigger than the amount of cores, let the workers get going before waiting on them.
+                    mCv.notify_all();
+                    waitOnDone(core);
+                }
+                core.mJob = jobs[i];
+                core.mDone.store(false, std::memory_order_relaxed);
+                {
+                    std::lock_guard<std::mutex> lock(mQueueMutex);
+                    mQueue.push(coreId);
+                }
+                coreIds[i] = coreId;
+            }
+            count == 1 ? mCv.notify_one() : mCv.notify_all();
+        }
+
+        bool poll(int coreId) override
+        {
+            return mCores[coreId].mDone.load(std::memory_order_acquire);
+        }
+
+        TaskResult join(int coreId) override
+        {
+            auto& core = mCores[coreId];
+            waitOnDone(core);
+            return core.mJob;
+        }
+
+        bool supportsQuiescenceSearch() const override
+        {
+            return true;
+        }
+
+        int getWorkerCount() const override
+        {
+            return static_cast<int>(mWorkers.size());
+        }
+
+        void setQuiescenceSearchHandler(QuiescenceSearchHandler handler) override
+        {
+            mQuiescenceSearchHandler = handler;
+        }
+
+        void submitQuiescenceSearchBatch(QSearchJob* jobs, int count) override
+        {
+            mPendingQuiescenceSearches.store(count, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mQueueMutex);
+                for (auto i = 0; i < count; ++i)
+                {
+                    mQuiescenceSearchQueue.push(&jobs[i]);
+                }
+            }
+            mCv.notify_all();
+        }
+
+        bool pollQuiescenceSearchBatch() override
+        {
+            return !mPendingQuiescenceSearches.load(std::memory_order_acquire);
+        }
+
+        void joinQuiescenceSearchBatch() override
+        {
+            while (!pollQuiescenceSearchBatch())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        static const int coreCount = 16;
+
+        struct Core
+        {
+            TaskResult mJob;
+            std::atomic<bool> mDone;
+        };
+
+        std::array<Core, coreCount> mCores;
+        std::vector<std::thread> mWorkers;
+        std::queue<int> mQueue;
+        std::mutex mQueueMutex;
+        std::condition_variable mCv;
+        bool mTerminate;
+        int mNextCore;
+        std::queue<QSearchJob*> mQuiescenceSearchQueue;
+        std::atomic<int> mPendingQuiescenceSearches;
+        QuiescenceSearchHandler mQuiescenceSearchHandler;
+
+        static void waitOnDone(const Core& core)
+        {
+            while (!core.mDone.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void loop(int workerId)
+        {
+            for (;;)
+            {
+                auto coreId = -1;
+                QSearchJob* quiescenceSearchJob = nullptr;
+
+                {
+                    std::unique_lock<std::mutex> lock(mQueueMutex);
+                    while (!mTerminate && mQueue.empty() && mQuiescenceSearchQueue.empty())
+                    {
+                        mCv.wait(lock);
+                    }
+
+                    if (mTerminate)
+                    {
+                        return;
+                    }
+
+                    if (!mQueue.empty())
+                    {
+                        coreId = mQueue.front();
+                        mQueue.pop();
+                    }
+                    else
+                    {
+                        quiescenceSearchJob = mQuiescenceSearchQueue.front();
+                        mQuiescenceSearchQueue.pop();
+                    }
+                }
+
+                if (quiescenceSearchJob)
+                {
+                    mQuiescenceSearchHandler(*quiescenceSearchJob, workerId);
+                    mPendingQuiescenceSearches.fetch_sub(1, std::memory_order_release);
+                    continue;
+                }
+
+                auto& core = mCores[coreId];
+                task(&core.mJob);
+                core.mDone.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+#ifdef HAS_EPIPHANY
+    // The real thing, runs e_task.elf on the cores of an Epiphany chip through e-hal.
+    class EpiphanyAccelerator : public Accelerator
+    {
+    public:
+        EpiphanyAccelerator() :
+        mDev(init_epiphany_threadpool()), mNextCore(0)
+        {
+        }
+
+        ~EpiphanyAccelerator()
+        {
+            cleanup_epiphany_threadpool(mDev);
+        }
+
+        std::string getName() const override
+        {
+            return "Epiphany";
+        }
+
+        int getCoreCount() const override
+        {
+            return coreCount;
+        }
+
+        int submit(const TaskResult& job) override
+        {
+            const auto coreId = mNextCore;
+            const auto row = coreId / 4;
+            const auto col = coreId % 4;
+            const auto done = 0;
+
+            mNextCore = (mNextCore + 1) % coreCount;
+            waitOnDone(row, col);
+            e_write(mDev, row, col, DONE_ADDR, &done, sizeof(done));
+            e_write(mDev, row, col, CORE_ADDR, &job, sizeof(TaskResult));
+            e_start(mDev, row, col);
+
+            return coreId;
+        }
+
+        bool poll(int coreId) override
+        {
+            int done;
+            e_read(mDev, coreId / 4, coreId % 4, DONE_ADDR, &done, sizeof(done));
+            return done != 0;
+        }
+
+        TaskResult join(int coreId) override
+        {
+            TaskResult tr;
+
+            waitOnDone(coreId / 4, coreId % 4);
+            e_read(mDev, coreId / 4, coreId % 4, CORE_ADDR, &tr, sizeof(tr));
+            return tr;
+        }
+
+    private:
+        static const int coreCount = 16;
+
+        e_epiphany_t* mDev;
+        int mNextCore;
+
+        void waitOnDone(int row, int col)
+        {
+            int done;
+
+            do
+            {
+                e_read(mDev, row, col, DONE_ADDR, &done, sizeof(done));
+            } while (!done);
+        }
+    };
+#endif
+}
+
+std::vector<std::string> Accelerator::availableBackends()
+{
+#ifdef HAS_EPIPHANY
+    return { "Epiphany", "Host" };
+#else
+    return { "Host" };
+#endif
+}
+
+std::unique_ptr<Accelerator> Accelerator::create(const std::string& name)
+{
+#ifdef HAS_EPIPHANY
+    if (name == "Epiphany")
+    {
+        return std::unique_ptr<Accelerator>(new EpiphanyAccelerator());
+    }
+#endif
+    if (name == "Host")
+    {
+        return std::unique_ptr<Accelerator>(new HostAccelerator());
+    }
+    return nullptr;
+}
+
+namespace
+{
+    std::unique_ptr<Accelerator> currentAccelerator;
+    std::mutex currentAcceleratorMutex;
+}
+
+Accelerator& Accelerator::instance()
+{
+    std::lock_guard<std::mutex> lock(currentAcceleratorMutex);
+    if (!currentAccelerator)
+    {
+        currentAccelerator = create(availableBackends().front());
+    }
+    return *currentAccelerator;
+}
+
+bool Accelerator::select(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(currentAcceleratorMutex);
+    if (currentAccelerator && currentAccelerator->getName() == name)
+    {
+        return true;
+    }
+
+    // The old backend can stay open while creating the new one, only one of the two can be using the hardware.
+    auto newAccelerator = create(name);
+    if (!newAccelerator)
+    {
+        return false;
+    }
+    currentAccelerator = std::move(newAccelerator);
+    return true;
+}
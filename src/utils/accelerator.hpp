@@ -0,0 +1,142 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file accelerator.hpp
+/// @author Mikko Aarnos
+
+#ifndef ACCELERATOR_HPP_
+#define ACCELERATOR_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../search.h"
+
+/// @brief Interface for the accelerators jobs of type TaskResult can be offloaded to.
+///
+/// An accelerator consists of a fixed amount of cores which each can run one job at a time.
+/// Submitting a job returns the id of the core running it, the result can then be collected with join.
+/// Submission only blocks if the core next in turn is still busy with an earlier job.
+/// A core can be given a new job without joining the old one, in which case the old result is lost.
+class Accelerator
+{
+public:
+    virtual ~Accelerator()
+    {
+    }
+
+    /// @brief Creates an accelerator backend.
+    /// @param name The name of the backend, one of the names returned by availableBackends.
+    /// @return The backend, or nullptr if no backend by that name exists.
+    static std::unique_ptr<Accelerator> create(const std::string& name);
+
+    /// @brief Gets the names of all backends compiled into the program. The first one is the default.
+    /// @return The names.
+    static std::vector<std::string> availableBackends();
+
+    /// @brief Gets the accelerator of the program, the default backend is created on first use.
+    ///
+    /// The hardware behind a backend can only be initialized once, so everything offloading jobs shares this accelerator instead of creating its own.
+    /// @return The accelerator.
+    static Accelerator& instance();
+
+    /// @brief Replaces the accelerator of the program with another backend.
+    /// @param name The name of the backend, one of the names returned by availableBackends.
+    /// @return True if the backend exists, false otherwise. In that case the old backend is kept.
+    ///
+    /// Must not be called while accelerator jobs are in flight. References returned by instance before the call become invalid.
+    static bool select(const std::string& name);
+
+    /// @brief Gets the name of this backend.
+    /// @return The name.
+    virtual std::string getName() const = 0;
+
+    /// @brief Gets the amount of cores of this accelerator, i.e. the amount of jobs which can be in flight at once.
+    /// @return The amount of cores.
+    virtual int getCoreCount() const = 0;
+
+    /// @brief Starts a job on the next core.
+    /// @param job The job.
+    /// @return The id of the core the job runs on.
+    virtual int submit(const TaskResult& job) = 0;
+
+    /// @brief Starts several jobs on consecutive cores without waiting for any of them.
+    /// @param jobs The jobs.
+    /// @param count The amount of jobs.
+    /// @param coreIds The core ids of the jobs are put here, this must have room for count integers.
+    virtual void submitBatch(const TaskResult* jobs, int count, int* coreIds);
+
+    /// @brief Checks whether the job on a given core is done, without blocking.
+    /// @param coreId The id of the core.
+    /// @return True if the job is done.
+    virtual bool poll(int coreId) = 0;
+
+    /// @brief Waits until the job on a given core is done and gets the result.
+    /// @param coreId The id of the core.
+    /// @return The result.
+    virtual TaskResult join(int coreId) = 0;
+
+    /// @brief The function which runs a quiescence search job. The second parameter is the id of the worker running the job.
+    using QuiescenceSearchHandler = std::function<void(QSearchJob&, int)>;
+
+    /// @brief Checks whether this backend can run quiescence search jobs.
+    /// @return True if it can.
+    virtual bool supportsQuiescenceSearch() const
+    {
+        return false;
+    }
+
+    /// @brief Gets the amount of workers running quiescence search jobs, every worker needs its own search context.
+    /// @return The amount of workers.
+    virtual int getWorkerCount() const
+    {
+        return 0;
+    }
+
+    /// @brief Sets the function which runs the quiescence search jobs. Must be called before submitting any.
+    /// @param handler The function. Called concurrently from all workers.
+    ///
+    /// The accelerator is shared, so the handler should be set again before every batch.
+    virtual void setQuiescenceSearchHandler(QuiescenceSearchHandler)
+    {
+    }
+
+    /// @brief Starts a batch of quiescence searches without waiting for them.
+    /// @param jobs The jobs. The results are written into the jobs, so they must stay alive until the batch is joined.
+    /// @param count The amount of jobs.
+    ///
+    /// Only one batch can be in flight at a time. Only call this if supportsQuiescenceSearch returns true.
+    virtual void submitQuiescenceSearchBatch(QSearchJob*, int)
+    {
+    }
+
+    /// @brief Checks whether every job of the current quiescence search batch is done, without blocking.
+    /// @return True if they are.
+    virtual bool pollQuiescenceSearchBatch()
+    {
+        return true;
+    }
+
+    /// @brief Waits until every job of the current quiescence search batch is done.
+    virtual void joinQuiescenceSearchBatch()
+    {
+    }
+};
+
+#endif
@@ -0,0 +1,320 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "large_pages.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(_MSC_VER)
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool LargePages::enabled = true;
+bool LargePages::numaInterleave = false;
+
+void LargePages::setEnabled(bool e) noexcept
+{
+    enabled = e;
+}
+
+void LargePages::setNumaInterleave(bool e) noexcept
+{
+    numaInterleave = e;
+}
+
+void LargePages::zero(void* p, size_t size)
+{
+    // Starting threads costs more than zeroing a few megabytes, so only bother with larger tables.
+    const size_t minimumParallelSize = 64 * 1024 * 1024;
+    const size_t chunkAlignment = 2 * 1024 * 1024;
+    const auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+    auto* begin = static_cast<char*>(p);
+
+    if (size < minimumParallelSize || threadCount == 1)
+    {
+        std::memset(begin, 0, size);
+        return;
+    }
+
+    // Keep the chunks aligned to huge pages so that no page is touched by two threads.
+    const auto chunk = ((size / threadCount) + chunkAlignment - 1) & ~(chunkAlignment - 1);
+    std::vector<std::thread> threads;
+    for (size_t offset = 0; offset < size; offset += chunk)
+    {
+        threads.emplace_back([begin, offset, chunk, size]()
+        {
+            std::memset(begin + offset, 0, std::min(chunk, size - offset));
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+#if defined(_MSC_VER)
+
+void* LargePages::mapFile(const std::string&, size_t&)
+{
+    throw std::runtime_error("memory-mapped files are not supported on this platform");
+}
+
+void LargePages::unmapFile(void*, size_t) noexcept
+{
+}
+
+#else
+
+void* LargePages::mapFile(const std::string& fileName, size_t& size)
+{
+    const auto fd = open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        throw std::runtime_error("cannot open " + fileName);
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    auto p = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    // The mapping stays valid after closing the descriptor.
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map " + fileName);
+    }
+
+    // Start reading the file in the background, the search will touch all of it fairly soon anyway.
+    madvise(p, size, MADV_WILLNEED);
+    return p;
+}
+
+void LargePages::unmapFile(void* p, size_t size) noexcept
+{
+    if (p)
+    {
+        munmap(p, size);
+    }
+}
+
+#endif
+
+#if defined(__linux__)
+
+namespace
+{
+    const size_t hugePageSize = 2 * 1024 * 1024;
+
+    size_t roundToHugePages(size_t size)
+    {
+        return (size + hugePageSize - 1) & ~(hugePageSize - 1);
+    }
+
+    // Ask the kernel to spread the pages of the mapping round-robin over all online NUMA nodes.
+    // We use the raw system call so that we don't have to link against libnuma.
+    // Failure is not a problem, we just get the default first-touch policy.
+    void interleave(void* p, size_t size)
+    {
+        const auto mpolInterleave = 3;
+        unsigned long nodeMask = 0;
+        struct stat st;
+
+        for (auto node = 0; node < 64; ++node)
+        {
+            const auto path = "/sys/devices/system/node/node" + std::to_string(node);
+            if (stat(path.c_str(), &st) == 0)
+            {
+                nodeMask |= 1UL << node;
+            }
+        }
+
+        if (nodeMask & (nodeMask - 1))
+        {
+            syscall(SYS_mbind, p, size, mpolInterleave, &nodeMask, 64, 0);
+        }
+    }
+}
+
+void* LargePages::allocate(size_t size)
+{
+    const auto rounded = roundToHugePages(size);
+    void* p = MAP_FAILED;
+
+    // Explicit huge pages are only available if the administrator has reserved some, so this fails most of the time.
+    if (enabled)
+    {
+        p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (p == MAP_FAILED)
+    {
+        // Transparent huge pages are only used for 2MB-aligned regions, so over-allocate and trim the excess.
+        auto raw = mmap(nullptr, rounded + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        const auto address = reinterpret_cast<uintptr_t>(raw);
+        const auto aligned = (address + hugePageSize - 1) & ~(hugePageSize - 1);
+        if (aligned > address)
+        {
+            munmap(raw, aligned - address);
+        }
+        munmap(reinterpret_cast<void*>(aligned + rounded), address + hugePageSize - aligned);
+        p = reinterpret_cast<void*>(aligned);
+
+        // Explicitly ask for small pages when huge pages are disabled so that the two can be compared even if THP is set to "always".
+        madvise(p, rounded, enabled ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    }
+
+    if (numaInterleave)
+    {
+        interleave(p, rounded);
+    }
+
+    return p;
+}
+
+void LargePages::deallocate(void* p, size_t size) noexcept
+{
+    if (p)
+    {
+        munmap(p, roundToHugePages(size));
+    }
+}
+
+std::string LargePages::describe(const void* p)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    const auto address = reinterpret_cast<uintptr_t>(p);
+    auto found = false;
+    uint64_t sizeKb = 0, kernelPageSizeKb = 4, anonHugeKb = 0;
+
+    // smaps consists of a header line per mapping ("start-end perms ...") followed by "Key: value kB" lines.
+    while (std::getline(smaps, line))
+    {
+        std::istringstream iss(line);
+        std::string key;
+        uint64_t value;
+
+        const auto dash = line.find('-');
+        if (dash != std::string::npos && line.find(':') > line.find(' '))
+        {
+            if (found)
+            {
+                break;
+            }
+            const auto start = std::stoull(line.substr(0, dash), nullptr, 16);
+            const auto end = std::stoull(line.substr(dash + 1, line.find(' ') - dash - 1), nullptr, 16);
+            found = (address >= start && address < end);
+            continue;
+        }
+
+        if (found && (iss >> key >> value))
+        {
+            if (key == "Size:")
+            {
+                sizeKb = value;
+            }
+            else if (key == "KernelPageSize:")
+            {
+                kernelPageSizeKb = value;
+            }
+            else if (key == "AnonHugePages:")
+            {
+                anonHugeKb = value;
+            }
+        }
+    }
+
+    std::ostringstream result;
+    if (!found)
+    {
+        result << "unknown page size";
+    }
+    else if (kernelPageSizeKb > 4)
+    {
+        result << kernelPageSizeKb << " kB explicit huge pages for " << sizeKb / 1024 << " MB";
+    }
+    else if (anonHugeKb > 0)
+    {
+        result << hugePageSize / 1024 << " kB transparent huge pages for " << anonHugeKb / 1024 << " of " << sizeKb / 1024 << " MB";
+    }
+    else
+    {
+        result << "4 kB pages for " << sizeKb / 1024 << " MB";
+    }
+    return result.str() + (numaInterleave ? ", interleaved across NUMA nodes" : "");
+}
+
+#else
+
+void* LargePages::allocate(size_t size)
+{
+    void* p;
+#if defined(_MSC_VER)
+    p = _aligned_malloc(size, 64);
+#else
+    if (posix_memalign(&p, 64, size))
+    {
+        p = nullptr;
+    }
+#endif
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void LargePages::deallocate(void* p, size_t) noexcept
+{
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+std::string LargePages::describe(const void*)
+{
+    return "default pages";
+}
+
+#endif
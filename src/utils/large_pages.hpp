@@ -0,0 +1,140 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file large_pages.hpp
+/// @author Mikko Aarnos
+
+#ifndef LARGE_PAGES_HPP_
+#define LARGE_PAGES_HPP_
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+
+/// @brief Memory allocation for the big hash tables.
+///
+/// With hash tables of several gigabytes TLB misses start to dominate the cost of a probe.
+/// On Linux the memory is therefore taken from explicit huge pages (MAP_HUGETLB) if any are reserved,
+/// otherwise a 2MB-aligned mapping is made and transparent huge pages are requested for it.
+/// Elsewhere we simply fall back to cache-line-aligned memory from the C runtime.
+/// Everything is static for convenience reasons.
+class LargePages
+{
+public:
+    /// @brief Allocate memory for a hash table. The memory is aligned to at least a cache line.
+    /// @param size The amount of memory needed, in bytes.
+    /// @return Pointer to the memory. Throws std::bad_alloc on failure.
+    static void* allocate(size_t size);
+
+    /// @brief Free memory allocated with allocate.
+    /// @param p Pointer returned by allocate.
+    /// @param size The same size which was given to allocate.
+    static void deallocate(void* p, size_t size) noexcept;
+
+    /// @brief Zero memory using all cores of the machine. 
+    /// @param p Pointer to the memory.
+    /// @param size The amount of memory to zero, in bytes.
+    ///
+    /// Zeroing a table of several gigabytes takes seconds with a single thread.
+    /// Also, as the first thread touching a page decides the NUMA node it lives on, this spreads fresh tables over all nodes.
+    static void zero(void* p, size_t size);
+
+    /// @brief Map a file into memory privately, i.e. writes to the memory are not written back to the file.
+    /// @param fileName The name of the file.
+    /// @param size The size of the file is put here.
+    /// @return Pointer to the start of the file. Throws std::runtime_error on failure.
+    static void* mapFile(const std::string& fileName, size_t& size);
+
+    /// @brief Unmap a file mapped with mapFile.
+    /// @param p Pointer returned by mapFile.
+    /// @param size The size returned by mapFile.
+    static void unmapFile(void* p, size_t size) noexcept;
+
+    /// @brief Enable or disable the usage of huge pages. Only affects allocations done after the call.
+    /// @param enabled Whether huge pages should be used or not.
+    static void setEnabled(bool enabled) noexcept;
+
+    /// @brief Enable or disable interleaving of the memory across all NUMA nodes. Only affects allocations done after the call.
+    /// @param enabled Whether to interleave or not.
+    static void setNumaInterleave(bool enabled) noexcept;
+
+    /// @brief Describes what kind of pages actually back a given allocation.
+    /// @param p Pointer returned by allocate.
+    /// @return A human-readable description, e.g. "2048 kB transparent huge pages for 256 of 256 MB".
+    static std::string describe(const void* p);
+
+private:
+    static bool enabled;
+    static bool numaInterleave;
+};
+
+/// @brief A std::allocator compatible allocator which gets its memory from LargePages.
+///
+/// Default construction of elements is skipped, the owner must zero the memory with LargePages::zero instead.
+/// This lets us zero big tables in parallel instead of having std::vector::resize construct them one element at a time.
+/// Only use this with types for which all-bits-zero is a valid default state.
+template <class T>
+class LargePageAllocator
+{
+public:
+    using value_type = T;
+
+    LargePageAllocator() noexcept
+    {
+    }
+
+    template <class U>
+    LargePageAllocator(const LargePageAllocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(LargePages::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        LargePages::deallocate(p, n * sizeof(T));
+    }
+
+    template <class U>
+    void construct(U*) noexcept
+    {
+    }
+
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <class T, class U>
+bool operator==(const LargePageAllocator<T>&, const LargePageAllocator<U>&) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const LargePageAllocator<T>&, const LargePageAllocator<U>&) noexcept
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file ring_buffer.hpp
+/// @author Mikko Aarnos
+
+#ifndef RING_BUFFER_HPP_
+#define RING_BUFFER_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/// @brief A lock-free bounded FIFO queue for exactly one producer thread and one consumer thread.
+/// @tparam T The type of the elements, must be default constructible and copy assignable.
+///
+/// The producer only writes the tail and the consumer only writes the head, so neither ever waits for the other.
+/// A push into a full buffer fails instead of blocking, which is what we want when the producer is the search.
+template <class T>
+class RingBuffer
+{
+public:
+    /// @brief Default constructor.
+    /// @param capacity The maximum amount of elements in the buffer, must be a power of two.
+    RingBuffer(size_t capacity);
+
+    /// @brief Adds an element to the buffer. Must only be called from the producer thread.
+    /// @param element The element.
+    /// @return True if the element was added, false if the buffer was full.
+    bool push(const T& element);
+
+    /// @brief Removes the oldest element from the buffer. Must only be called from the consumer thread.
+    /// @param element On success the element is put here.
+    /// @return True if an element was removed, false if the buffer was empty.
+    bool pop(T& element);
+
+    /// @brief Checks if the buffer is empty. Exact only when called from the consumer thread with the producer idle.
+    /// @return True if the buffer is empty.
+    bool empty() const;
+
+    /// @return The maximum amount of elements in the buffer.
+    size_t capacity() const;
+
+private:
+    std::vector<T> mElements;
+    size_t mMask;
+    // Kept on separate cache lines so that the producer and the consumer don't keep stealing the line from each other.
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+};
+
+template <class T>
+RingBuffer<T>::RingBuffer(size_t capacity) : mElements(capacity), mMask(capacity - 1), mHead(0), mTail(0)
+{
+    assert(capacity > 0 && !(capacity & (capacity - 1)));
+}
+
+template <class T>
+bool RingBuffer<T>::push(const T& element)
+{
+    const auto tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) > mMask)
+    {
+        return false;
+    }
+    mElements[tail & mMask] = element;
+    mTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <class T>
+bool RingBuffer<T>::pop(T& element)
+{
+    const auto head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    element = mElements[head & mMask];
+    mHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <class T>
+bool RingBuffer<T>::empty() const
+{
+    return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+}
+
+template <class T>
+size_t RingBuffer<T>::capacity() const
+{
+    return mElements.size();
+}
+
+#endif
@@ -1,58 +1,262 @@
-#include "../search.h"
 #include "threadpool.hpp"
-#include "epiphany.h"
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local int ThreadPool::currentWorker = -1;
 
 ThreadPool::ThreadPool(int amountOfThreads) :
-  terminateFlag(false),
-  core_id(0)
+  jobs(new Job[jobCapacity]),
+  nextJob(0),
+  sharedQueue(jobCapacity),
+  sharedQueueHead(0),
+  sharedQueueTail(0),
+  sharedQueueSize(0),
+  pendingJobs(0),
+  sleepingWorkers(0),
+  terminateFlag(false)
 {
+    for (auto i = 0; i < jobCapacity; ++i)
+    {
+        jobs[i].mReferences = 0;
+        jobs[i].mDone = true;
+        jobs[i].mDestroy = nullptr;
+    }
+
+    // Create all workers before starting any, the workers steal from each other.
     for (auto i = 0; i < amountOfThreads; ++i)
     {
-        threads.emplace_back(&ThreadPool::loop, this);
+        workers.emplace_back(new Worker());
+    }
+    for (auto i = 0; i < amountOfThreads; ++i)
+    {
+        workers[i]->mThread = std::thread(&ThreadPool::loop, this, i);
     }
-    dev = init_epiphany_threadpool();
 }
 
 ThreadPool::~ThreadPool()
 {
-    terminateFlag = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        terminateFlag = true;
+    }
     cv.notify_all();
-    for (auto& thread : threads)
+    for (auto& worker : workers)
     {
-        thread.join();
+        worker->mThread.join();
     }
-    cleanup_epiphany_threadpool(dev);
+
+    for (auto i = 0; i < jobCapacity; ++i)
+    {
+        if (jobs[i].mDestroy)
+        {
+            jobs[i].mDestroy(&jobs[i].mStorage);
+        }
+    }
+}
+
+ThreadPool::Handle::Handle() noexcept :
+mPool(nullptr), mJob(nullptr)
+{
+}
+
+ThreadPool::Handle::Handle(ThreadPool* pool, Job* job) noexcept :
+mPool(pool), mJob(job)
+{
+}
+
+ThreadPool::Handle::Handle(Handle&& other) noexcept :
+mPool(other.mPool), mJob(other.mJob)
+{
+    other.mJob = nullptr;
 }
 
-static void waitOnDone(e_epiphany_t *dev, int r, int c) {
-  int done;
+ThreadPool::Handle& ThreadPool::Handle::operator=(Handle&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        mPool = other.mPool;
+        mJob = other.mJob;
+        other.mJob = nullptr;
+    }
+    return *this;
+}
 
-  do {
-    e_read(dev, r, c, DONE_ADDR, &done, sizeof(done));
-  } while (!done);
+ThreadPool::Handle::~Handle()
+{
+    release();
 }
 
-TaskResult ThreadPool::joinEpiphanyJob(int c_id) {
-  TaskResult tr;
+void ThreadPool::Handle::release() noexcept
+{
+    if (mJob)
+    {
+        mPool->releaseJob(mJob);
+        mJob = nullptr;
+    }
+}
 
-  waitOnDone(dev, c_id/4, c_id%4);
-  e_read(dev, c_id/4, c_id%4, CORE_ADDR, &tr, sizeof(tr));
-  return tr;
+bool ThreadPool::Handle::done() const
+{
+    return !mJob || mJob->mDone.load(std::memory_order_acquire);
 }
 
-int ThreadPool::addEpiphanyJob(TaskResult result) {
-  int row, col, done, c_id;
-  c_id = core_id;
-  core_id = (core_id+1)%16;
-  row = c_id/4;
-  col = c_id%4;
+void ThreadPool::Handle::wait()
+{
+    // Instead of blocking help with the work, the job we are waiting for might be sitting in our own deque anyway.
+    while (!done())
+    {
+        if (!mPool->runPendingJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
 
-  waitOnDone(dev, row, col);
+void ThreadPool::Job::run()
+{
+    mInvoke(&mStorage);
+    mDestroy(&mStorage);
+    mDestroy = nullptr;
+    mDone.store(true, std::memory_order_release);
+}
 
-  done = 0;
-  e_write(dev, row, col, DONE_ADDR, &done, sizeof(done));
-  e_write(dev, row, col, CORE_ADDR, &result, sizeof(TaskResult));
-  e_start(dev, row, col);
+ThreadPool::Job* ThreadPool::acquireJob(int references)
+{
+    // Start the search where the previous one ended, the slots before it are most likely still in use.
+    const auto start = nextJob.fetch_add(1, std::memory_order_relaxed);
+    for (auto i = 0u; i < jobCapacity; ++i)
+    {
+        auto& job = jobs[(start + i) % jobCapacity];
+        auto expected = 0;
+        if (job.mReferences.load(std::memory_order_relaxed) == 0
+            && job.mReferences.compare_exchange_strong(expected, references, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return &job;
+        }
+    }
+    return nullptr;
+}
 
-  return c_id;
+void ThreadPool::releaseJob(Job* job)
+{
+    job->mReferences.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ThreadPool::schedule(Job* job)
+{
+    pendingJobs.fetch_add(1);
+
+    if (currentPool == this)
+    {
+        const auto pushed = workers[currentWorker]->mDeque.push(job);
+        assert(pushed);
+        (void)pushed;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(sharedQueueMutex);
+        sharedQueue[sharedQueueTail] = job;
+        sharedQueueTail = (sharedQueueTail + 1) % jobCapacity;
+        sharedQueueSize.fetch_add(1, std::memory_order_release);
+    }
+
+    // Pairs with the check of pendingJobs in loop, either we see the sleeping worker or it sees the new job.
+    if (sleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        cv.notify_one();
+    }
+}
+
+ThreadPool::Job* ThreadPool::findJob()
+{
+    const auto workerId = (currentPool == this ? currentWorker : -1);
+    const auto workerCount = static_cast<int>(workers.size());
+    Job* job = nullptr;
+
+    if (workerId >= 0 && workers[workerId]->mDeque.pop(job))
+    {
+        pendingJobs.fetch_sub(1);
+        return job;
+    }
+
+    if (sharedQueueSize.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> lock(sharedQueueMutex);
+        if (sharedQueueSize.load(std::memory_order_relaxed) > 0)
+        {
+            job = sharedQueue[sharedQueueHead];
+            sharedQueueHead = (sharedQueueHead + 1) % jobCapacity;
+            sharedQueueSize.fetch_sub(1, std::memory_order_relaxed);
+            pendingJobs.fetch_sub(1);
+            return job;
+        }
+    }
+
+    for (auto i = 1; i <= workerCount; ++i)
+    {
+        const auto victim = (workerId + i + workerCount) % workerCount;
+        if (victim != workerId && workers[victim]->mDeque.steal(job))
+        {
+            pendingJobs.fetch_sub(1);
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+void ThreadPool::runJob(Job* job)
+{
+    job->run();
+    releaseJob(job);
+}
+
+bool ThreadPool::runPendingJob()
+{
+    const auto job = findJob();
+    if (job)
+    {
+        runJob(job);
+    }
+    return job != nullptr;
+}
+
+void ThreadPool::loop(int workerId)
+{
+    // Spinning for a moment before sleeping saves a system call to wake up when jobs come in quick succession.
+    const auto spinCount = 64;
+
+    currentPool = this;
+    currentWorker = workerId;
+
+    for (;;)
+    {
+        auto found = false;
+        for (auto i = 0; i < spinCount && !found; ++i)
+        {
+            found = runPendingJob();
+            if (!found)
+            {
+                std::this_thread::yield();
+            }
+        }
+        if (found)
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        while (!terminateFlag && !pendingJobs.load())
+        {
+            cv.wait(lock);
+        }
+        sleepingWorkers.fetch_sub(1);
+
+        if (terminateFlag)
+        {
+            return;
+        }
+    }
 }
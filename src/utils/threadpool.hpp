@@ -21,85 +21,304 @@
 #ifndef THREADPOOL_HPP_
 #define THREADPOOL_HPP_
 
-#include <mutex>
-#include <vector>
-#include <thread>
+#include <algorithm>
 #include <atomic>
-#include <queue>
-#include <functional>
+#include <cassert>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include "../search.h"
-#include "epiphany.h"
+/// @brief A bounded Chase-Lev work-stealing deque.
+///
+/// The owning thread pushes and pops at the bottom, any other thread can steal from the top.
+/// Only the steals and the pop of the last element need a CAS, everything else is plain loads and stores.
+/// See "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê et al. for the memory orderings.
+template <class T, int Capacity>
+class WorkStealingDeque
+{
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "the capacity of a work-stealing deque must be a power of two");
 
-/// @brief A simple thread pool implementation.
+    WorkStealingDeque() :
+    mTop(0), mBottom(0)
+    {
+    }
+
+    /// @brief Pushes an element to the bottom. Only the owner may call this.
+    /// @param element The element.
+    /// @return False if the deque is full.
+    bool push(T element)
+    {
+        const auto b = mBottom.load(std::memory_order_relaxed);
+        const auto t = mTop.load(std::memory_order_acquire);
+
+        if (b - t >= Capacity)
+        {
+            return false;
+        }
+        mBuffer[b & (Capacity - 1)].store(element, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// @brief Pops the element pushed last. Only the owner may call this.
+    /// @param element The element is put here.
+    /// @return False if the deque was empty.
+    bool pop(T& element)
+    {
+        const auto b = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = mTop.load(std::memory_order_relaxed);
+        auto success = false;
+
+        if (t <= b)
+        {
+            element = mBuffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+            success = true;
+            if (t == b)
+            {
+                // Last element, race against the thieves for it.
+                success = mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                mBottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            mBottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return success;
+    }
+
+    /// @brief Steals the element pushed first. Any thread may call this.
+    /// @param element The element is put here.
+    /// @return False if the deque was empty or another thread won the race for the element.
+    bool steal(T& element)
+    {
+        auto t = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto b = mBottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+        {
+            return false;
+        }
+        element = mBuffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+        return mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+private:
+    // Keep the end the thieves fight over and the end the owner works on in different cache lines.
+    std::atomic<int64_t> mTop;
+    char mPadding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> mBottom;
+    std::atomic<T> mBuffer[Capacity];
+};
+
+/// @brief A work-stealing thread pool.
 ///
-/// Most likely contains bugs. Haven't found them so far, if they exist.
+/// Every worker has its own deque of jobs. Jobs added by a worker go to its own deque, jobs added by other threads to a shared queue.
+/// Idle workers first look at their own deque, then at the shared queue and then steal from the other workers.
+/// The jobs are stored in a fixed array of slots allocated at construction, so adding a job never allocates memory.
+/// A job and its arguments must fit into Job::storageSize bytes, this is checked at compile time.
 /// All functions given as jobs must return nothing (i.e. be void).
 class ThreadPool
 {
+    class Job;
+
 public:
+    /// @brief A handle to a job added with submit, used for waiting until the job is done.
+    ///
+    /// Destroying the handle does not wait for the job.
+    class Handle
+    {
+    public:
+        Handle() noexcept;
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        ~Handle();
+
+        /// @brief Checks whether the job is done, without blocking.
+        /// @return True if it is.
+        bool done() const;
+
+        /// @brief Waits until the job is done. Runs other jobs of the pool while waiting.
+        void wait();
+
+    private:
+        friend class ThreadPool;
+
+        Handle(ThreadPool* pool, Job* job) noexcept;
+        void release() noexcept;
+
+        ThreadPool* mPool;
+        Job* mJob;
+    };
+
     /// @brief Constructs a new threadpool.
     /// @param amountOfThreads The amount of threads that the thread pool should have.
     ThreadPool(int amountOfThreads);
 
     /// @brief Destructor, terminates all running threads after they have finished their work.
+    ///
+    /// Jobs which haven't been started yet are dropped.
     ~ThreadPool();
 
-    /// @brief Adds a new job into the queue of the thread pool.
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @brief Adds a new job into the thread pool.
     template<class Fn, class... Args>
     void addJob(Fn&& fn, Args&&... args);
-    TaskResult joinEpiphanyJob(int c_id);
-    int addEpiphanyJob(TaskResult result);
+
+    /// @brief Adds a new job into the thread pool.
+    /// @return A handle which can be used to wait for the job.
+    template<class Fn, class... Args>
+    Handle submit(Fn&& fn, Args&&... args);
+
+    /// @brief Calls fn(i) for every i in [begin, end[ using the threads of the pool and the calling thread. Returns when all calls are done.
+    /// @param begin The first index.
+    /// @param end One past the last index.
+    /// @param fn The function.
+    /// @param grainSize Ranges of at most this many indices are not split further.
+    template<class Fn>
+    void parallelFor(int begin, int end, const Fn& fn, int grainSize = 1);
+
+    /// @brief Gets the amount of threads of the pool.
+    /// @return The amount of threads.
+    int getThreadCount() const;
 
 private:
-    void loop();
+    // The amount of job slots. As there can never be more jobs than slots the deques can't overflow either.
+    static const int jobCapacity = 1024;
 
-    std::vector<std::thread> threads;
-    std::queue<std::function<void()>> jobQueue;
+    // A job slot. Big enough to hold Search::think and its arguments bound together (248 bytes with GCC on x86-64), the biggest job there is.
+    // The root position is passed packed to keep it small, the slots of a pool take 1024 times this much memory.
+    class Job
+    {
+    public:
+        static const size_t storageSize = 256;
+
+        // 0 means that the slot is free. The pool holds one reference until the job has run, a handle the other.
+        std::atomic<int> mReferences;
+        std::atomic<bool> mDone;
+        void (*mInvoke)(void*);
+        void (*mDestroy)(void*);
+        typename std::aligned_storage<storageSize, alignof(std::max_align_t)>::type mStorage;
+
+        template<class Callable>
+        void store(Callable&& callable);
+
+        void run();
+    };
+
+    struct Worker
+    {
+        WorkStealingDeque<Job*, jobCapacity> mDeque;
+        std::thread mThread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::unique_ptr<Job[]> jobs;
+    std::atomic<unsigned int> nextJob;
+
+    // The queue for jobs added by threads outside the pool. A ring buffer as big as the amount of slots, so it can't overflow either.
+    // When it is full head and tail are equal, so the size is what tells whether it is empty.
+    std::vector<Job*> sharedQueue;
+    int sharedQueueHead, sharedQueueTail;
+    std::atomic<int> sharedQueueSize;
+    std::mutex sharedQueueMutex;
 
-    std::mutex jobQueueMutex;
+    // Jobs in some queue but not yet taken by any thread. Used for deciding when the workers can go to sleep.
+    std::atomic<int> pendingJobs;
+    std::atomic<int> sleepingWorkers;
+    std::mutex sleepMutex;
     std::condition_variable cv;
     std::atomic<bool> terminateFlag;
 
-    e_epiphany_t* dev;
-    int core_id;
+    // Which pool and worker the current thread belongs to, if any.
+    static thread_local ThreadPool* currentPool;
+    static thread_local int currentWorker;
+
+    Job* acquireJob(int references);
+    void releaseJob(Job* job);
+    void schedule(Job* job);
+    Job* findJob();
+    void runJob(Job* job);
+    bool runPendingJob();
+    void loop(int workerId);
 };
 
+template<class Callable>
+void ThreadPool::Job::store(Callable&& callable)
+{
+    using Type = typename std::decay<Callable>::type;
+    static_assert(sizeof(Type) <= storageSize, "job is too big for the storage of a thread pool job slot");
+    static_assert(alignof(Type) <= alignof(std::max_align_t), "job is over-aligned");
+
+    ::new(static_cast<void*>(&mStorage)) Type(std::forward<Callable>(callable));
+    mInvoke = [](void* p) { (*static_cast<Type*>(p))(); };
+    mDestroy = [](void* p) { static_cast<Type*>(p)->~Type(); };
+    mDone.store(false, std::memory_order_relaxed);
+}
 
 template<class Fn, class... Args>
 void ThreadPool::addJob(Fn&& fn, Args&&... args)
 {
-    const auto job = std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...);
-    std::unique_lock<std::mutex> lock(jobQueueMutex);
-    jobQueue.push(job);
-    cv.notify_one();
+    submit(std::forward<Fn>(fn), std::forward<Args>(args)...);
 }
 
-inline void ThreadPool::loop()
+template<class Fn, class... Args>
+ThreadPool::Handle ThreadPool::submit(Fn&& fn, Args&&... args)
 {
-    for (;;)
-    {
-        std::function<void()> job;
+    auto job = acquireJob(2);
 
-        {
-            std::unique_lock<std::mutex> lock(jobQueueMutex);
-            while (!terminateFlag && jobQueue.empty())
-            {
-                cv.wait(lock);
-            }
+    // All slots are taken, so just run the job right here. 
+    if (!job)
+    {
+        std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...)();
+        return Handle();
+    }
 
-            if (terminateFlag)
-            {
-                return;
-            }
+    job->store(std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...));
+    schedule(job);
+    return Handle(this, job);
+}
 
-            job = jobQueue.front();
-            jobQueue.pop();
+template<class Fn>
+void ThreadPool::parallelFor(int begin, int end, const Fn& fn, int grainSize)
+{
+    if (end - begin <= std::max(grainSize, 1))
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            fn(i);
         }
-
-        job();
+        return;
     }
+
+    // Hand the upper half to the pool and recurse on the lower half. 
+    // Thieves take from the top of the deque, so idle workers steal the biggest remaining chunks first.
+    const auto middle = begin + (end - begin) / 2;
+    auto upper = submit([this, &fn, middle, end, grainSize]() 
+    { 
+        parallelFor(middle, end, fn, grainSize); 
+    });
+    parallelFor(begin, middle, fn, grainSize);
+    upper.wait();
+}
+
+inline int ThreadPool::getThreadCount() const
+{
+    return static_cast<int>(workers.size());
 }
 
 #endif
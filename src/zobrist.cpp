@@ -21,15 +21,19 @@
 #include "piece.hpp"
 #include "bitboards.hpp"
 
+// With precomputed tables these are defined in precomputed_tables.cpp instead.
+#ifndef PRECOMPUTED_TABLES
 std::array<std::array<HashKey, 64>, 12> Zobrist::mPieceHashKeys;
 std::array<std::array<HashKey, 8>, 12> Zobrist::mMaterialHashKeys;
 std::array<HashKey, 16> Zobrist::mCastlingHashKeys;
 std::array<HashKey, 64> Zobrist::mEnPassantHashKeys;
 HashKey Zobrist::mTurnHashKey;
 HashKey Zobrist::mManglingHashKey;
+#endif
 
 void Zobrist::staticInitialize()
 {
+#ifndef PRECOMPUTED_TABLES
     std::mt19937_64 rng(123456789); // TODO: use std::random_device?
 
     for (Piece p = Piece::WhitePawn; p <= Piece::BlackKing; ++p)
@@ -61,4 +65,37 @@ void Zobrist::staticInitialize()
 
     mTurnHashKey = rng();
     mManglingHashKey = rng();
+#endif
+}
+
+HashKey Zobrist::fingerprint()
+{
+    auto result = 0ULL;
+    const auto combine = [&result](HashKey key) { result = (result ^ key) * 1099511628211ULL; };
+
+    for (Piece p = Piece::WhitePawn; p <= Piece::BlackKing; ++p)
+    {
+        for (Square sq = Square::A1; sq <= Square::H8; ++sq)
+        {
+            combine(mPieceHashKeys[p][sq]);
+        }
+        for (auto j = 0; j < 8; ++j)
+        {
+            combine(mMaterialHashKeys[p][j]);
+        }
+    }
+
+    for (Square sq = Square::A1; sq <= Square::H8; ++sq)
+    {
+        combine(mEnPassantHashKeys[sq]);
+    }
+
+    for (auto cr = 0; cr <= 15; ++cr)
+    {
+        combine(mCastlingHashKeys[cr]);
+    }
+
+    combine(mTurnHashKey);
+    combine(mManglingHashKey);
+    return result;
 }
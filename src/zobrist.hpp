@@ -25,6 +25,7 @@
 #include <array>
 #include "piece.hpp"
 #include "square.hpp"
+#include "precomputed_tables.hpp"
 
 /// @brief A hashkey, just like a bitboard, is just a quadword, so let's do a simple typedef for convenience. Again, why am I even commenting this?
 using HashKey = uint64_t;
@@ -68,13 +69,19 @@ public:
     /// @return The mangling hash key.
     static HashKey manglingHashKey() noexcept;
 
+    /// @brief Gets a fingerprint of all zobrist keys. Used for checking that saved hash tables are compatible with the current keys.
+    /// @return The fingerprint.
+    static HashKey fingerprint();
+
 private:
-    static std::array<std::array<HashKey, 64>, 12> mPieceHashKeys;
-    static std::array<std::array<HashKey, 8>, 12> mMaterialHashKeys;
-    static std::array<HashKey, 16> mCastlingHashKeys;
-    static std::array<HashKey, 64> mEnPassantHashKeys;
-    static HashKey mTurnHashKey;
-    static HashKey mManglingHashKey;
+    friend class TableGenerator;
+
+    static PRECOMPUTED_TABLE std::array<std::array<HashKey, 64>, 12> mPieceHashKeys;
+    static PRECOMPUTED_TABLE std::array<std::array<HashKey, 8>, 12> mMaterialHashKeys;
+    static PRECOMPUTED_TABLE std::array<HashKey, 16> mCastlingHashKeys;
+    static PRECOMPUTED_TABLE std::array<HashKey, 64> mEnPassantHashKeys;
+    static PRECOMPUTED_TABLE HashKey mTurnHashKey;
+    static PRECOMPUTED_TABLE HashKey mManglingHashKey;
 };
 
 inline HashKey Zobrist::pieceHashKey(Piece p, Square sq) 
@@ -28,5 +28,7 @@ BOOST_AUTO_TEST_CASE(EndgameModuleTest)
     BOOST_CHECK(endgameModule.drawnEndgame(kk));
     BOOST_CHECK(endgameModule.drawnEndgame(knk));
     BOOST_CHECK(!endgameModule.drawnEndgame(kbnk));
+    BOOST_CHECK(endgameModule.fideDrawnEndgame(knk));
+    BOOST_CHECK(!endgameModule.fideDrawnEndgame(kbnk));
 }
 
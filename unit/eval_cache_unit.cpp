@@ -0,0 +1,47 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "..\src\eval_cache.hpp"
+#include <boost\test\unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(AllCasesEvaluationCache)
+{
+    EvaluationCache cache;
+    const HashKey hk = 5270488176186631498;
+    auto score = 0;
+
+    BOOST_CHECK(!cache.probe(hk, score));
+
+    cache.save(hk, -123);
+    BOOST_CHECK(cache.probe(hk, score));
+    BOOST_CHECK(score == -123);
+    // Same index, different key.
+    BOOST_CHECK(!cache.probe(hk ^ (1ULL << 63), score));
+    BOOST_CHECK(cache.getProbes() == 3);
+    BOOST_CHECK(cache.getHits() == 1);
+
+    cache.resetStatistics();
+    BOOST_CHECK(cache.getProbes() == 0);
+    BOOST_CHECK(cache.getHits() == 0);
+
+    cache.clear();
+    BOOST_CHECK(!cache.probe(hk, score));
+
+    cache.setSize(0);
+    cache.save(hk, 50);
+    BOOST_CHECK(!cache.probe(hk, score));
+}
@@ -0,0 +1,41 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "..\src\mht.hpp"
+#include <boost\test\unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(AllCasesMHT)
+{
+    MaterialHashTable mht;
+    const HashKey mhk = 5270488176186631498;
+
+    auto& entry = mht.getEntry(mhk);
+    BOOST_CHECK(entry.mHash != mhk);
+
+    entry.mHash = mhk;
+    entry.mImbalance = -42;
+    entry.mPhase = 64;
+    entry.mEndgame = MaterialHashTable::DrawishEndgame;
+    entry.mScaleFactors.fill(0);
+
+    BOOST_CHECK(&mht.getEntry(mhk) == &entry);
+    BOOST_CHECK(mht.getEntry(mhk).mHash == mhk);
+    BOOST_CHECK(mht.getEntry(mhk).mImbalance == -42);
+    BOOST_CHECK(mht.getEntry(mhk).mEndgame == MaterialHashTable::DrawishEndgame);
+
+    mht.clear();
+    BOOST_CHECK(mht.getEntry(mhk).mHash != mhk);
+}
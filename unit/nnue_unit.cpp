@@ -0,0 +1,106 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "..\src\nnue.hpp"
+#include "..\src\position.hpp"
+#include <boost\test\unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    template <class T>
+    void writeRandom(std::ofstream& file, std::mt19937& rng, size_t count, int lowerBound, int upperBound)
+    {
+        std::uniform_int_distribution<int> distribution(lowerBound, upperBound);
+        std::vector<T> values(count);
+        for (auto& value : values)
+        {
+            value = static_cast<T>(distribution(rng));
+        }
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void writeRandomNetwork(const std::string& fileName)
+    {
+        const uint32_t header[8] = { 0, 1, Nnue::featureCount, Nnue::halfDimensions, 32, 0, 0, 0 };
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        std::mt19937 rng(12345);
+
+        file.write("HKNN", 4);
+        file.write(reinterpret_cast<const char*>(header + 1), sizeof(header) - 4);
+        writeRandom<int16_t>(file, rng, Nnue::halfDimensions, -20, 60);
+        writeRandom<int16_t>(file, rng, static_cast<size_t>(Nnue::featureCount) * Nnue::halfDimensions, -8, 8);
+        writeRandom<int32_t>(file, rng, 32, -500, 500);
+        writeRandom<int8_t>(file, rng, 32 * 2 * Nnue::halfDimensions, -20, 20);
+        writeRandom<int32_t>(file, rng, 32, -500, 500);
+        writeRandom<int8_t>(file, rng, 32 * 32, -40, 40);
+        writeRandom<int32_t>(file, rng, 1, -500, 500);
+        writeRandom<int8_t>(file, rng, 32, -60, 60);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(AllCasesNnue)
+{
+    const std::string fileName = "nnue_unit.bin";
+
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file << "definitely not a network";
+    }
+    BOOST_CHECK_THROW(Nnue::load(fileName), std::runtime_error);
+    BOOST_CHECK(!Nnue::isLoaded());
+
+    writeRandomNetwork(fileName);
+    Nnue::load(fileName);
+    BOOST_CHECK(Nnue::isLoaded());
+    BOOST_CHECK(Nnue::getFileName() == fileName);
+    Nnue::setActive(true);
+
+    // Both sides see the board the same way, so a position and its color-flipped version must get the same score.
+    const Position pos("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    const Position flipped("r3k2r/pppbbppp/2n2q1P/1P2p3/3pn3/BN2PNP1/P1PPQPB1/R3K2R b KQkq -");
+    BOOST_CHECK(Nnue::evaluate(pos) == Nnue::evaluate(flipped));
+
+    // Making moves must give the same result as setting up the resulting position from scratch.
+    // Covers castling, captures and king moves.
+    Position played(pos);
+    for (auto& move : { Move(Square::E1, Square::G1, Piece::King), Move(Square::E7, Square::C5, Piece::Empty),
+                        Move(Square::E5, Square::F7, Piece::Empty), Move(Square::E8, Square::F7, Piece::Empty) })
+    {
+        played.makeMove(move);
+    }
+    const Position reference("r6r/p1pp1kb1/bn2pnp1/2qP4/1p2P3/2N2Q1p/PPPBBPPP/R4RK1 w - - 0 3");
+    BOOST_CHECK(Nnue::evaluate(played) == Nnue::evaluate(reference));
+
+    Nnue::Accumulator accumulator;
+    Nnue::refreshAccumulator(pos, accumulator, Color::White);
+    Nnue::refreshAccumulator(pos, accumulator, Color::Black);
+    BOOST_CHECK(Nnue::evaluate(accumulator, Color::White, false) == Nnue::evaluate(pos));
+    if (Bitboards::avx2Supported())
+    {
+        BOOST_CHECK(Nnue::evaluate(accumulator, Color::White, true) == Nnue::evaluate(accumulator, Color::White, false));
+    }
+
+    Nnue::unload();
+    BOOST_CHECK(!Nnue::isLoaded());
+    BOOST_CHECK(!Nnue::isActive());
+    std::remove(fileName.c_str());
+}
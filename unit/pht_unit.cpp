@@ -21,17 +21,32 @@
 BOOST_AUTO_TEST_CASE(AllCasesPHT)
 {
     PawnHashTable pht;
-    int scoreOp, scoreEd;
-
-    pht.save(5270488176186631498, 15, 20);
-
-    BOOST_CHECK(pht.probe(5270488176186631498, scoreOp, scoreEd));
-    BOOST_CHECK(scoreOp == 15);
-    BOOST_CHECK(scoreEd == 20);
+    const HashKey phk = 5270488176186631498;
+
+    auto& entry = pht.getEntry(phk);
+    BOOST_CHECK(entry.mHash != phk);
+    BOOST_CHECK(pht.getEntry(0).mHash != 0);
+
+    entry.mHash = phk;
+    entry.mScoreOp = 15;
+    entry.mScoreEd = -20;
+    entry.mPawnFiles[0] = 0x18;
+    entry.mShelterPenalty[1][6] = 12;
+
+    BOOST_CHECK(&pht.getEntry(phk) == &entry);
+    BOOST_CHECK(pht.getEntry(phk).mHash == phk);
+    BOOST_CHECK(pht.getEntry(phk).mScoreOp == 15);
+    BOOST_CHECK(pht.getEntry(phk).mScoreEd == -20);
+    BOOST_CHECK(pht.getEntry(phk).mPawnFiles[0] == 0x18);
+    BOOST_CHECK(pht.getEntry(phk).mShelterPenalty[1][6] == 12);
+    BOOST_CHECK(pht.getProbes() == 8);
+    BOOST_CHECK(pht.getHits() == 6);
+
+    pht.resetStatistics();
+    BOOST_CHECK(pht.getProbes() == 0);
+    BOOST_CHECK(pht.getHits() == 0);
 
     pht.clear();
-    BOOST_CHECK(!pht.probe(5270488176186631498, scoreOp, scoreEd));
+    BOOST_CHECK(pht.getEntry(phk).mHash != phk);
+    BOOST_CHECK(pht.getEntry(0).mHash != 0);
 }
-
-
-
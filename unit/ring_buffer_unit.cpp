@@ -0,0 +1,75 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "..\src\utils\ring_buffer.hpp"
+#include <boost\test\unit_test.hpp>
+#include <thread>
+
+BOOST_AUTO_TEST_CASE(AllCasesRingBuffer)
+{
+    RingBuffer<int> buffer(4);
+    int element;
+
+    BOOST_CHECK(buffer.capacity() == 4);
+    BOOST_CHECK(buffer.empty());
+    BOOST_CHECK(!buffer.pop(element));
+
+    for (auto i = 0; i < 4; ++i)
+    {
+        BOOST_CHECK(buffer.push(i));
+    }
+    BOOST_CHECK(!buffer.push(4));
+    BOOST_CHECK(buffer.pop(element) && element == 0);
+    BOOST_CHECK(buffer.push(4));
+
+    // Elements come out in the order they went in, also after wrapping around.
+    for (auto i = 1; i <= 4; ++i)
+    {
+        BOOST_CHECK(buffer.pop(element) && element == i);
+    }
+    BOOST_CHECK(buffer.empty());
+
+    // One producer and one consumer running at the same time, nothing may get lost, duplicated or reordered.
+    RingBuffer<int> sharedBuffer(1024);
+    const auto count = 1000000;
+    auto ordered = true;
+    std::thread consumer([&]()
+    {
+        for (auto expected = 0; expected < count;)
+        {
+            if (sharedBuffer.pop(element))
+            {
+                ordered = ordered && element == expected;
+                ++expected;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (auto i = 0; i < count; ++i)
+    {
+        while (!sharedBuffer.push(i))
+        {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    BOOST_CHECK(ordered);
+    BOOST_CHECK(sharedBuffer.empty());
+}
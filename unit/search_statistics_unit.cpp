@@ -0,0 +1,52 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "..\src\search_statistics.hpp"
+#include <boost\test\unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(AllCasesSearchStatistics)
+{
+    SearchStatistics statistics, other;
+
+    for (auto i = 0; i < SearchStatistics::CounterCount; ++i)
+    {
+        BOOST_CHECK(statistics.mCounters[i] == 0);
+    }
+    BOOST_CHECK(statistics.toJson().find("\"first_move_cutoff_rate\": 0") != std::string::npos);
+
+    statistics.mCounters[SearchStatistics::BetaCutoffs] = 3;
+    statistics.mCounters[SearchStatistics::FirstMoveBetaCutoffs] = 2;
+    other.mCounters[SearchStatistics::BetaCutoffs] = 1;
+    other.mCounters[SearchStatistics::FirstMoveBetaCutoffs] = 1;
+    statistics.add(other);
+    BOOST_CHECK(statistics.mCounters[SearchStatistics::BetaCutoffs] == 4);
+    BOOST_CHECK(statistics.mCounters[SearchStatistics::FirstMoveBetaCutoffs] == 3);
+
+    const auto json = statistics.toJson();
+    BOOST_CHECK(json.find("\"beta_cutoffs\": 4") != std::string::npos);
+    BOOST_CHECK(json.find("\"first_move_cutoff_rate\": 0.75") != std::string::npos);
+
+    // Every counter has a name of its own.
+    for (auto i = 0; i < SearchStatistics::CounterCount; ++i)
+    {
+        for (auto j = i + 1; j < SearchStatistics::CounterCount; ++j)
+        {
+            BOOST_CHECK(std::string(SearchStatistics::getName(static_cast<SearchStatistics::Counter>(i)))
+                     != SearchStatistics::getName(static_cast<SearchStatistics::Counter>(j)));
+        }
+    }
+}
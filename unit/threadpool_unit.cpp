@@ -0,0 +1,68 @@
+/*
+    Hakkapeliitta - A UCI chess engine. Copyright (C) 2013-2015 Mikko Aarnos.
+
+    Hakkapeliitta is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Hakkapeliitta is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Hakkapeliitta. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "..\src\utils\threadpool.hpp"
+#include <boost\test\unit_test.hpp>
+#include <atomic>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(ParallelForThreadPool)
+{
+    ThreadPool tp(4);
+    std::vector<std::atomic<int>> calls(10000);
+
+    for (auto& c : calls)
+    {
+        c = 0;
+    }
+    tp.parallelFor(0, static_cast<int>(calls.size()), [&calls](int i) { calls[i].fetch_add(1); }, 16);
+    for (auto& c : calls)
+    {
+        BOOST_CHECK(c == 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HandlesThreadPool)
+{
+    ThreadPool tp(2);
+    std::atomic<int> counter(0);
+    std::vector<ThreadPool::Handle> handles;
+
+    // More jobs than there are job slots, the extra ones run inline.
+    for (auto i = 0; i < 5000; ++i)
+    {
+        handles.push_back(tp.submit([&counter]() { counter.fetch_add(1); }));
+    }
+    for (auto& handle : handles)
+    {
+        handle.wait();
+        BOOST_CHECK(handle.done());
+    }
+    BOOST_CHECK(counter == 5000);
+}
+
+BOOST_AUTO_TEST_CASE(NestedThreadPool)
+{
+    ThreadPool tp(3);
+    std::atomic<int> sum(0);
+
+    tp.parallelFor(0, 64, [&tp, &sum](int i)
+    {
+        tp.parallelFor(0, 64, [&sum, i](int j) { sum.fetch_add(i * j); });
+    });
+    BOOST_CHECK(sum == 2016 * 2016);
+}
@@ -17,24 +17,89 @@
 
 #include "..\src\tt.hpp"
 #include <boost\test\unit_test.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE(AllCasesTT)
 {
     TranspositionTable tt;
     Move m(Square::H4, Square::F5, Piece::Empty);
 
-    tt.save(5770153743293125963, m, -23, 7, TranspositionTable::Flags::ExactScore);
+    tt.save(5770153743293125963, m, -23, 45, 7, TranspositionTable::Flags::ExactScore);
 
-    auto ttEntry = tt.probe(5770153743293125963);
-    BOOST_CHECK(ttEntry);
-    BOOST_CHECK(ttEntry->getBestMove() == m);
-    BOOST_CHECK(ttEntry->getScore() == -23);
-    BOOST_CHECK(ttEntry->getDepth() == 7);
-    BOOST_CHECK(ttEntry->getFlags() == TranspositionTable::Flags::ExactScore);
+    TranspositionTable::TranspositionTableEntry ttEntry;
+    BOOST_CHECK(tt.probe(5770153743293125963, ttEntry));
+    BOOST_CHECK(ttEntry.getBestMove() == m);
+    BOOST_CHECK(ttEntry.getScore() == -23);
+    BOOST_CHECK(ttEntry.getStaticEval() == 45);
+    BOOST_CHECK(ttEntry.getDepth() == 7);
+    BOOST_CHECK(ttEntry.getFlags() == TranspositionTable::Flags::ExactScore);
+
+    // Saving without a static evaluation keeps the old one.
+    tt.save(5770153743293125963, m, 12, TranspositionTable::noStaticEval, 8, TranspositionTable::Flags::LowerBoundScore);
+    BOOST_CHECK(tt.probe(5770153743293125963, ttEntry));
+    BOOST_CHECK(ttEntry.getScore() == 12);
+    BOOST_CHECK(ttEntry.getStaticEval() == 45);
+    BOOST_CHECK(ttEntry.getFlags() == TranspositionTable::Flags::LowerBoundScore);
+
+    tt.clear();
+    tt.save(5770153743293125963, m, -23, TranspositionTable::noStaticEval, 7, TranspositionTable::Flags::UpperBoundScore);
+    BOOST_CHECK(tt.probe(5770153743293125963, ttEntry));
+    BOOST_CHECK(ttEntry.getStaticEval() == TranspositionTable::noStaticEval);
 
     tt.clear();
-    ttEntry = tt.probe(5770153743293125963);
-    BOOST_CHECK(!ttEntry);
+    BOOST_CHECK(!tt.probe(5770153743293125963, ttEntry));
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentStressTT)
+{
+    // Every thread writes entries whose contents are derived from the hash key.
+    // All threads use the same small set of keys which map to only eight clusters, so that they constantly overwrite each others entries.
+    // A succesful probe must never return an entry which doesn't belong to the key probed.
+    TranspositionTable tt;
+    tt.setSize(1);
+    const auto threadCount = std::max(4u, std::thread::hardware_concurrency());
+    std::atomic<int> corrupted(0);
+    std::vector<std::thread> threads;
+
+    for (auto t = 0u; t < threadCount; ++t)
+    {
+        threads.emplace_back([&tt, &corrupted, t]()
+        {
+            auto rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+            for (auto i = 0; i < 1000000; ++i)
+            {
+                rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27;
+                const auto index = rng & 4095;
+                const auto hk = ((index * 2685821657736338717ULL) & ~0xffffULL) | (index & 7);
+                const auto score = static_cast<int>(hk >> 48) & 0x3fff;
+                const auto depth = static_cast<int>(hk >> 32) & 0x3f;
+                const Move move(static_cast<uint16_t>(hk >> 16));
+                TranspositionTable::TranspositionTableEntry ttEntry;
+
+                if (i & 1)
+                {
+                    tt.save(hk, move, score, -score, depth, TranspositionTable::Flags::LowerBoundScore);
+                }
+                else if (tt.probe(hk, ttEntry))
+                {
+                    if (ttEntry.getScore() != score || ttEntry.getStaticEval() != -score || ttEntry.getDepth() != depth 
+                     || ttEntry.getFlags() != TranspositionTable::Flags::LowerBoundScore)
+                    {
+                        ++corrupted;
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    BOOST_CHECK(corrupted == 0);
 }
 
 